@@ -0,0 +1,292 @@
+/*
+ * A microbenchmark of the search in a B+tree nonleaf node. It compares
+ * BTNonLeafNode::locateChildPtr(), which searches the summary line and
+ * one cache line of keys, with a search over all keys of a node laid out
+ * in one flat array (the layout before the summary was added).
+ *
+ * The nodes are full, and each lookup goes to a random node with a
+ * random key. With many nodes, most lookups miss the CPU caches, and the
+ * # cache lines touched per node decides the time. Random lookups in
+ * full compressed leaf nodes (BTLeafNode::locate()) are timed the same way.
+ *
+ * It then builds a BTreeIndex from random keys, one insert() at a time
+ * and by insertBatch(), checks that every key is found in order, and
+ * times the lookups. Last, it appends keys in ascending order, one at a
+ * time, with a late key now and then, and in small batches, and checks
+ * that the leaf nodes are about APPEND_SPLIT percent full.
+ *
+ * usage: btreebench [# nodes] [# lookups] [# tree keys]
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <unistd.h>
+#include <vector>
+#include <algorithm>
+#include "BTreeIndex.h"
+#include "BTreeNode.h"
+
+using std::vector;
+
+// # keys of a node in the flat layout, which has no summary line
+static const int FLAT_KEYS = (PageFile::PAGE_SIZE - sizeof(int) - sizeof(PageId))/(sizeof(PageId)+sizeof(int));
+
+// how much less full than APPEND_SPLIT percent the leaf nodes of ascending
+// keys may be, in percent. the widths of the compressed entries vary, so
+// the nodes do not split at exactly the same # entries
+static const int FILL_SLACK = 5;
+
+// a node in the flat layout: [# keys][keys][pids]
+struct FlatNode {
+  int    count;
+  int    keys[FLAT_KEYS];
+  PageId pids[FLAT_KEYS+1];
+} __attribute__((aligned(BTNonLeafNode::CACHE_LINE)));
+
+static PageId flatLocate(const FlatNode& node, int searchKey)
+{
+  return node.pids[countKeysBelow(node.keys, node.count, searchKey+1)];
+}
+
+static double seconds(clock_t begin)
+{
+  return (double)(clock() - begin) / CLOCKS_PER_SEC;
+}
+
+/*
+ * fill the leaf nodes with ascending keys 1 to 40 apart, and time the
+ * lookups of random keys by BTLeafNode::locate(). return false if an
+ * entry number differs from that of a search over the plain keys
+ */
+static bool benchLeaves(int nodes, int lookups)
+{
+  vector<BTLeafNode> leaves(nodes);
+  vector<vector<int> > keys(nodes);
+  for (int i = 0, key = 0; i < nodes; i++) {
+    vector<RecordId> rids(BTLeafNode::MAXKEY_NUM);
+    keys[i].resize(BTLeafNode::MAXKEY_NUM);
+    for (int j = 0; j < BTLeafNode::MAXKEY_NUM; j++) {
+      keys[i][j] = key += 1 + rand() % 40;
+      rids[j].pid = i;
+      rids[j].sid = j;
+    }
+    keys[i].resize(leaves[i].fill(&keys[i][0], &rids[0], BTLeafNode::MAXKEY_NUM));
+  }
+
+  vector<int> node(lookups), key(lookups);
+  for (int i = 0; i < lookups; i++) {
+    node[i] = rand() % nodes;
+    key[i] = keys[node[i]].front() + rand() % (keys[node[i]].back() - keys[node[i]].front() + 1);
+  }
+
+  long sum = 0;
+  clock_t begin = clock();
+  for (int i = 0; i < lookups; i++) {
+    int eid;
+    leaves[node[i]].locate(key[i], eid);
+    sum += eid;
+  }
+  double leafTime = seconds(begin);
+
+  for (int i = 0; i < lookups; i++) {
+    const vector<int>& k = keys[node[i]];
+    sum -= std::lower_bound(k.begin(), k.end(), key[i]) - k.begin();
+  }
+  printf("compressed leaf (%d entries per node): %.1f ns per lookup\n",
+         (int)keys[0].size(), leafTime * 1e9 / lookups);
+  return sum == 0;
+}
+
+/*
+ * index the keys with their # as the pid of the RecordId, by insert() or
+ * by insertBatch(), read them back in order, and look each up. return
+ * false if the index gives a wrong answer
+ */
+static bool benchIndex(bool batch, const vector<int>& values)
+{
+  const char* filename = "btreebench.idx";
+  BTreeIndex index;
+  int n = values.size();
+  bool ok = true;
+
+  unlink(filename);
+  if (index.open(filename, 'w') < 0) return false;
+  clock_t begin = clock();
+  if (batch) {
+    vector<IndexEntry> entries(n);
+    for (int i = 0; i < n; i++) {
+      entries[i].first = values[i];
+      entries[i].second.pid = i;
+      entries[i].second.sid = 0;
+    }
+    ok = (index.insertBatch(entries) == 0);
+  } else {
+    for (int i = 0; i < n && ok; i++) {
+      RecordId rid;
+      rid.pid = i;
+      rid.sid = 0;
+      ok = (index.insert(values[i], rid) == 0);
+    }
+  }
+  double insertTime = seconds(begin);
+
+  // the keys come back sorted
+  vector<int> sorted(values);
+  std::sort(sorted.begin(), sorted.end());
+  IndexCursor cursor;
+  RecordId rid;
+  int key;
+  if (ok) index.locate(sorted[0], cursor);
+  for (int i = 0; i < n && ok; i++) {
+    ok = (index.readForward(cursor, key, rid) == 0 && key == sorted[i] && values[rid.pid] == key);
+  }
+
+  // every key is found
+  begin = clock();
+  for (int i = 0; i < n && ok; i++) {
+    ok = (index.locate(values[i], cursor) == 0 && index.readForward(cursor, key, rid) == 0 &&
+          key == values[i]);
+  }
+  double lookupTime = seconds(begin);
+
+  int height, pages, leaves, entries;
+  index.getStats(height, pages, leaves, entries);
+  printf("BTreeIndex by %s, height %d, %d pages: %.0f ns per insert, %.0f ns per lookup%s\n",
+         batch ? "insertBatch()" : "insert()", height, pages,
+         insertTime * 1e9 / n, lookupTime * 1e9 / n, ok ? "" : ": WRONG");
+  index.close();
+  unlink(filename);
+  return ok;
+}
+
+/*
+ * index the keys 0, 2, 4, ... in ascending order: by insert(), by insert()
+ * with every 7th key put 20 keys back, or by insertBatch() in batches
+ * of 10. return false if the leaf nodes are less than FILL_SLACK percent
+ * below APPEND_SPLIT percent full, on average
+ */
+static bool benchAppends(int how, int n)
+{
+  static const char* names[] = { "insert()", "insert() with late keys", "insertBatch() of 10" };
+  const char* filename = "btreebench.idx";
+  BTreeIndex index;
+  bool ok = true;
+
+  vector<int> keys(n);
+  vector<RecordId> rids(n);
+  for (int i = 0; i < n; i++) {
+    keys[i] = (how == 1 && i % 7 == 6) ? 2*i - 41 : 2*i;
+    rids[i].pid = i;
+    rids[i].sid = 0;
+  }
+
+  unlink(filename);
+  if (index.open(filename, 'w') < 0) return false;
+  if (how == 2) {
+    for (int i = 0; i < n && ok; i += 10) {
+      vector<IndexEntry> entries;
+      for (int j = i; j < n && j < i+10; j++) entries.push_back(IndexEntry(keys[j], rids[j]));
+      ok = (index.insertBatch(entries) == 0);
+    }
+  } else {
+    for (int i = 0; i < n && ok; i++) ok = (index.insert(keys[i], rids[i]) == 0);
+  }
+
+  // the fewest leaf nodes the keys fit in
+  std::sort(keys.begin(), keys.end());
+  int fewest = 0;
+  for (int done = 0; done < n; fewest++) {
+    BTLeafNode leaf;
+    done += leaf.fill(&keys[done], &rids[done], n-done);
+  }
+
+  int height, pages, leaves, entries;
+  if (ok) ok = (index.getStats(height, pages, leaves, entries) == 0 && entries == n);
+  if (ok) ok = (leaves <= fewest * 100 / (BTreeIndex::APPEND_SPLIT - FILL_SLACK) + 1);
+  printf("%d ascending keys by %s: %d leaf nodes, at least %d%s\n",
+         n, names[how], leaves, fewest, ok ? "" : ": TOO MANY");
+  index.close();
+  unlink(filename);
+  return ok;
+}
+
+int main(int argc, char* argv[])
+{
+  int nodes = (argc > 1) ? atoi(argv[1]) : 8192;
+  int lookups = (argc > 2) ? atoi(argv[2]) : 10000000;
+  int treeKeys = (argc > 3) ? atoi(argv[3]) : 100000;
+  const char* filename = "btreebench.idx";
+  PageFile pf;
+  long sum = 0;
+
+  if (nodes <= 0 || lookups <= 0 || treeKeys <= 0) {
+    fprintf(stderr, "usage: %s [# nodes] [# lookups] [# tree keys]\n", argv[0]);
+    return 1;
+  }
+
+  // the keys of node i are i*STEP, i*STEP+10, ..., the same in both layouts.
+  // the nodes are written to a page file and read back, so that write()
+  // builds their summary
+  const int STEP = 10 * (FLAT_KEYS+1);
+  vector<FlatNode> flat(nodes);
+  BTNonLeafNode* blocked = new BTNonLeafNode[nodes];
+  unlink(filename);
+  if (pf.open(filename, 'w') < 0) {
+    fprintf(stderr, "Error: cannot create %s\n", filename);
+    return 1;
+  }
+  for (int i = 0; i < nodes; i++) {
+    BTNonLeafNode node;
+    node.initializeRoot(0, i*STEP, 1);
+    for (int j = 1; j < BTNonLeafNode::MAXKEY_NUM; j++) node.insert(i*STEP + j*10, j+1);
+    node.write(i, pf);
+    blocked[i].read(i, pf);
+
+    flat[i].count = FLAT_KEYS;
+    flat[i].pids[0] = 0;
+    for (int j = 0; j < FLAT_KEYS; j++) {
+      flat[i].keys[j] = i*STEP + j*10;
+      flat[i].pids[j+1] = j+1;
+    }
+  }
+  pf.close();
+  unlink(filename);
+
+  // the same random lookups for both layouts
+  vector<int> node(lookups), key(lookups);
+  srand(1);
+  for (int i = 0; i < lookups; i++) {
+    node[i] = rand() % nodes;
+    key[i] = node[i]*STEP + rand() % (10*BTNonLeafNode::MAXKEY_NUM);
+  }
+
+  clock_t begin = clock();
+  for (int i = 0; i < lookups; i++) sum += flatLocate(flat[node[i]], key[i]);
+  double flatTime = seconds(begin);
+
+  begin = clock();
+  for (int i = 0; i < lookups; i++) {
+    PageId pid;
+    blocked[node[i]].locateChildPtr(key[i], pid);
+    sum -= pid;
+  }
+  double blockedTime = seconds(begin);
+
+  printf("%d nodes, %d lookups\n", nodes, lookups);
+  printf("flat keys (%d per node):    %.1f ns per lookup\n", FLAT_KEYS, flatTime * 1e9 / lookups);
+  printf("summary + block (%d per node): %.1f ns per lookup\n", BTNonLeafNode::MAXKEY_NUM, blockedTime * 1e9 / lookups);
+
+  delete [] blocked;
+  bool ok = benchLeaves(nodes, lookups);
+
+  // random keys, about half of them duplicates
+  vector<int> values(treeKeys);
+  for (int i = 0; i < treeKeys; i++) values[i] = rand() % treeKeys;
+  ok = benchIndex(false, values) && ok;
+  ok = benchIndex(true, values) && ok;
+  for (int how = 0; how < 3; how++) ok = benchAppends(how, treeKeys) && ok;
+
+  // the two layouts must find the same children
+  return (sum == 0 && ok) ? 0 : 1;
+}
@@ -1,3 +1,6 @@
+#include <algorithm>
+#include <climits>
+#include <cstring>
 #include "BTreeIndex.h"
 #include "BTreeNode.h"
 
@@ -9,6 +12,12 @@ using namespace std;
 BTreeIndex::BTreeIndex()
 {
   rootPid = -1;
+  freePid = -1;
+  newPages = 0;
+  endPid = 0;
+  linkPid = -1;
+  rightKey = INT_MIN;
+  rightDirty = false;
 }
 
 /*
@@ -30,6 +39,8 @@ RC BTreeIndex::open(const string& indexname, char mode)
     rootPid = -1;
     *(int *)buffer = treeHeight;
     *(PageId *)(buffer+sizeof(int)) = rootPid;
+    *(int *)(buffer+2*sizeof(int)) = FREE_LIST_MAGIC;
+    *(PageId *)(buffer+3*sizeof(int)) = -1;
     if(pf.write(pf.endPid(), buffer)){
       fprintf(stderr, "Error: cannot write to the index file\n");
       return RC_FILE_WRITE_FAILED;
@@ -41,6 +52,10 @@ RC BTreeIndex::open(const string& indexname, char mode)
   }
   treeHeight = *(int *)buffer;
   rootPid = *(PageId *)(buffer+sizeof(int));
+  freePid = (*(int *)(buffer+2*sizeof(int)) == FREE_LIST_MAGIC) ? *(PageId *)(buffer+3*sizeof(int)) : -1;
+  endPid = pf.endPid();
+  rightPath.clear();
+  rightDirty = false;
   write = false;
   if(mode == 'w'){
     write = true;
@@ -54,10 +69,16 @@ RC BTreeIndex::open(const string& indexname, char mode)
  */
 RC BTreeIndex::close()
 {
+  if(flushRight()){
+    fprintf(stderr, "Error: cannot write to the index file\n");
+    return RC_FILE_WRITE_FAILED;
+  }
   if(write){                          //write into index file before close
     char buffer[PageFile::PAGE_SIZE];
     *(int *)buffer = treeHeight;
     *(PageId *)(buffer+sizeof(int)) = rootPid;
+    *(int *)(buffer+2*sizeof(int)) = FREE_LIST_MAGIC;
+    *(PageId *)(buffer+3*sizeof(int)) = freePid;
     if(pf.write(0, buffer)){
       fprintf(stderr, "Error: cannot write to the index file\n");
       return RC_FILE_WRITE_FAILED;      
@@ -80,25 +101,481 @@ RC BTreeIndex::insert(int key, const RecordId& rid)
   if(rootPid == -1){
     BTLeafNode node;
     node.insert(key, rid);
-    rootPid = pf.endPid();
+    rootPid = newPage();
     treeHeight = 1;
-    node.write(pf.endPid(),pf);
+    node.write(rootPid, pf);
     return 0;
   }
+
+  //an append goes straight to the rightmost leaf
+  RC rc;
+  if(rightPath.empty() && (rc = findRightPath()) < 0) return rc;
+  if(key >= rightKey) return insertRight(key, rid);
+  if((rc = flushRight()) < 0) return rc;
+
   int level = 1;
-  PageId pid = rootPid;
   PageId newPid;
   int midKey;
+  int pages = newPages;
+  int height = treeHeight;
   if(subInsert(rootPid, key, rid, level, midKey, newPid)){
     BTNonLeafNode node;
     node.initializeRoot(rootPid, midKey, newPid);
-    rootPid = pf.endPid();
+    rootPid = newPage();
     treeHeight++;
-    node.write(pf.endPid(), pf);
+    node.write(rootPid, pf);
   }
+
+  //a split of a leaf alone adds one page and leaves the right edge as it
+  //is. a split of a nonleaf node may have moved it
+  if(treeHeight != height || newPages > pages+1) rightPath.clear();
   return 0;
 }
 
+/*
+ * find the right edge of the tree and read its leaf node
+ */
+RC BTreeIndex::findRightPath()
+{
+  PageId pid = rootPid;
+
+  rightPath.clear();
+  rightKey = INT_MIN;
+  for(int level = 1; level < treeHeight; level++){
+    BTNonLeafNode node;
+    rightPath.push_back(pid);
+    if(node.read(pid, pf)){
+      rightPath.clear();
+      return RC_FILE_READ_FAILED;
+    }
+
+    //the keys >= the last key of every node on the path go to the
+    //last child
+    int n = node.getKeyCount();
+    if(n > 0 && node.getKey(n-1) > rightKey) rightKey = node.getKey(n-1);
+    PageId child;
+    node.locateChildPtr(INT_MAX, child);
+    pid = child;
+  }
+  rightPath.push_back(pid);
+  if(rightLeaf.read(pid, pf)){
+    rightPath.clear();
+    return RC_FILE_READ_FAILED;
+  }
+  rightDirty = false;
+  return 0;
+}
+
+/*
+ * insert an entry into the rightmost leaf node. the separators that
+ * the splits make are larger than the keys of the nodes on the right
+ * edge, so they are appended to them, too
+ */
+RC BTreeIndex::insertRight(int key, const RecordId& rid)
+{
+  RC rc = insertLeaf(rightLeaf, key, rid);
+  if(rc != RC_NODE_FULL){
+    if(rc == 0) rightDirty = true;
+    return rc;
+  }
+
+  //a key in front of the last keys of the leaf splits it where it goes
+  BTLeafNode sibling;
+  int midKey;
+  rightLeaf.insertAndSplit(key, rid, sibling, midKey, APPEND_SPLIT);
+  PageId newPid = newPage();
+  rightLeaf.setNextNodePtr(newPid);
+  sibling.setPrevNodePtr(rightPath.back());
+  if(rightLeaf.write(rightPath.back(), pf) || sibling.write(newPid, pf)){
+    rightPath.clear();
+    return RC_FILE_WRITE_FAILED;
+  }
+  rightLeaf = sibling;
+  rightPath.back() = newPid;
+  rightKey = midKey;
+  rightDirty = false;
+
+  //the new node goes behind the last key of its parent
+  for(int level = treeHeight-1; level >= 1; level--){
+    BTNonLeafNode node;
+    PageId pid = rightPath[level-1];
+    if(node.read(pid, pf)){
+      rightPath.clear();
+      return RC_FILE_READ_FAILED;
+    }
+    int n = node.getKeyCount();
+    if(n < BTNonLeafNode::MAXKEY_NUM){
+      node.insert(n, midKey, newPid);
+      return node.write(pid, pf);
+    }
+    BTNonLeafNode newNode;
+    node.insertAndSplit(n, midKey, newPid, newNode, midKey, APPEND_SPLIT);
+    newPid = newPage();
+    if(node.write(pid, pf) || newNode.write(newPid, pf)){
+      rightPath.clear();
+      return RC_FILE_WRITE_FAILED;
+    }
+    rightPath[level-1] = newPid;
+  }
+
+  //the root split
+  BTNonLeafNode root;
+  root.initializeRoot(rootPid, midKey, newPid);
+  rootPid = newPage();
+  treeHeight++;
+  rightPath.insert(rightPath.begin(), rootPid);
+  return root.write(rootPid, pf);
+}
+
+/*
+ * write the rightmost leaf node if it changed
+ */
+RC BTreeIndex::flushRight()
+{
+  if(!rightDirty) return 0;
+  if(rightLeaf.write(rightPath.back(), pf)) return RC_FILE_WRITE_FAILED;
+  rightDirty = false;
+  return 0;
+}
+
+/*
+ * write the rightmost leaf node and forget the right edge
+ */
+RC BTreeIndex::dropRight()
+{
+  RC rc = flushRight();
+  rightPath.clear();
+  return rc;
+}
+
+/*
+ * the page for a new node. a free page has the next free page in front
+ */
+PageId BTreeIndex::newPage()
+{
+  char buffer[PageFile::PAGE_SIZE];
+
+  newPages++;
+  if(endPid < pf.endPid()) endPid = pf.endPid();
+  if(freePid == -1) return endPid++;
+  if(pf.read(freePid, buffer)){
+    //the rest of the free page list is lost
+    freePid = -1;
+    return endPid++;
+  }
+  PageId pid = freePid;
+  freePid = *(PageId *)buffer;
+  return pid;
+}
+
+/*
+ * put a page in front of the free page list
+ */
+RC BTreeIndex::freePage(PageId pid)
+{
+  char buffer[PageFile::PAGE_SIZE];
+
+  memset(buffer, 0, sizeof(buffer));
+  *(PageId *)buffer = freePid;
+  if(pf.write(pid, buffer)){
+    fprintf(stderr, "Error: cannot write to the index file\n");
+    return RC_FILE_WRITE_FAILED;
+  }
+  freePid = pid;
+  return 0;
+}
+
+/*
+ * set the previous sibling pointer of the leaf node pid, if there is one.
+ * the rightmost leaf node kept in memory (written before any other leaf
+ * node changes) is changed, too
+ */
+RC BTreeIndex::linkLeaf(PageId pid, PageId prev)
+{
+  BTLeafNode node;
+
+  if(pid == -1) return 0;
+  if(node.read(pid, pf)) return RC_FILE_READ_FAILED;
+  node.setPrevNodePtr(prev);
+  if(!rightPath.empty() && pid == rightPath.back()) rightLeaf.setPrevNodePtr(prev);
+  return node.write(pid, pf);
+}
+
+/*
+ * set the previous page pointer of the overflow page pid, if there is one
+ */
+RC BTreeIndex::linkOverflow(PageId pid, PageId prev)
+{
+  BTOverflowNode page;
+
+  if(pid == -1) return 0;
+  if(page.read(pid, pf)) return RC_FILE_READ_FAILED;
+  page.setPrevNodePtr(prev);
+  return page.write(pid, pf);
+}
+
+/*
+ * insert an entry into a leaf node, or into the overflow pages of its key
+ */
+RC BTreeIndex::insertLeaf(BTLeafNode& node, int key, const RecordId& rid)
+{
+  int eid, k, run = 0;
+  RecordId r;
+  RC rc;
+
+  //a key with overflow pages takes the RecordId there
+  node.locate(key, eid);
+  for(; eid < node.getKeyCount(); eid++, run++){
+    node.readEntry(eid, k, r);
+    if(k != key) break;
+    if(r.sid == BTLeafNode::OVERFLOW_SID) return insertOverflow(r.pid, rid);
+  }
+
+  //a key with too many entries moves to overflow pages
+  if(run >= OVERFLOW_RUN){
+    RecordId rids[BTLeafNode::MAXKEY_NUM+1];
+    int n;
+    PageId pid = newPage();
+    if(node.moveToOverflow(key, pid, rids, n) == 0){
+      int i = n;
+      for(; i > 0 && rid < rids[i-1]; i--) rids[i] = rids[i-1];
+      rids[i] = rid;
+      return writeOverflow(pid, key, rids, n+1);
+    }
+    if((rc = freePage(pid)) < 0) return rc;
+  }
+  return node.insert(key, rid);
+}
+
+/*
+ * create the overflow pages of key from pid on
+ */
+RC BTreeIndex::writeOverflow(PageId pid, int key, const RecordId* rids, int n)
+{
+  BTOverflowNode first;
+  PageId last = pid;
+
+  int done = first.fill(key, rids, n);
+  PageId next = (done < n) ? newPage() : -1;
+  first.setNextNodePtr(next);
+  while(next != -1){
+    BTOverflowNode page;
+    PageId cur = next;
+    done += page.fill(key, rids+done, n-done);
+    next = (done < n) ? newPage() : -1;
+    page.setNextNodePtr(next);
+    page.setPrevNodePtr(last);
+    if(page.write(cur, pf)) return RC_FILE_WRITE_FAILED;
+    last = cur;
+  }
+  first.setLastNodePtr(last);
+  return first.write(pid, pf);
+}
+
+/*
+ * insert a RecordId into the overflow pages at pid
+ */
+RC BTreeIndex::insertOverflow(PageId pid, const RecordId& rid)
+{
+  BTOverflowNode first, node, next;
+  RecordId r;
+
+  if(first.read(pid, pf)) return RC_FILE_READ_FAILED;
+
+  //the RecordId goes to the last page whose first RecordId is not
+  //larger. that is usually the last page of the chain
+  PageId cur = first.getLastNodePtr();
+  if(node.read(cur, pf)) return RC_FILE_READ_FAILED;
+  if(cur != pid && (node.readEntry(0, r), rid < r)){
+    cur = pid;
+    node = first;
+    while(node.getNextNodePtr() != -1){
+      if(next.read(node.getNextNodePtr(), pf)) return RC_FILE_READ_FAILED;
+      next.readEntry(0, r);
+      if(rid < r) break;
+      cur = node.getNextNodePtr();
+      node = next;
+    }
+  }
+  if(node.insert(rid) == 0) return node.write(cur, pf);
+
+  //a full page splits, and the new page follows it
+  BTOverflowNode sibling;
+  PageId newPid = newPage();
+  node.insertAndSplit(rid, sibling);
+  node.setNextNodePtr(newPid);
+  sibling.setPrevNodePtr(cur);
+  if(sibling.getNextNodePtr() == -1){
+    if(cur == pid) node.setLastNodePtr(newPid);
+    else{
+      first.setLastNodePtr(newPid);
+      if(first.write(pid, pf)) return RC_FILE_WRITE_FAILED;
+    }
+  }
+  else if(linkOverflow(sibling.getNextNodePtr(), newPid)) return RC_FILE_WRITE_FAILED;
+  if(sibling.write(newPid, pf)) return RC_FILE_WRITE_FAILED;
+  return node.write(cur, pf);
+}
+
+/*
+ * insert RecordIds, in order, into the overflow pages at pid. those
+ * behind the last RecordId of the chain fill its last page and new pages
+ * behind it, and every page is written once. any others go in one by one
+ */
+RC BTreeIndex::appendOverflow(PageId pid, const RecordId* rids, int n)
+{
+  BTOverflowNode first, node;
+  RecordId buf[BTOverflowNode::MAX_RIDS];
+  RecordId r;
+  RC rc;
+
+  if(first.read(pid, pf)) return RC_FILE_READ_FAILED;
+  PageId last = first.getLastNodePtr();
+  if(last == pid) node = first;
+  else if(node.read(last, pf)) return RC_FILE_READ_FAILED;
+  node.readEntry(node.getRidCount()-1, r);
+  if(!(r < rids[0])){
+    for(int i = 0; i < n; i++){
+      if((rc = insertOverflow(pid, rids[i])) < 0) return rc;
+    }
+    return 0;
+  }
+
+  vector<RecordId> all(buf, buf+node.readAll(buf));
+  all.insert(all.end(), rids, rids+n);
+  int key = first.getKey();
+  int done = node.fill(key, &all[0], all.size());
+  PageId cur = last;
+  while(done < (int)all.size()){
+    BTOverflowNode sibling;
+    PageId newPid = newPage();
+    done += sibling.fill(key, &all[done], all.size()-done);
+    sibling.setPrevNodePtr(cur);
+    node.setNextNodePtr(newPid);
+    if(cur == pid) first = node;
+    else if(node.write(cur, pf)) return RC_FILE_WRITE_FAILED;
+    node = sibling;
+    cur = newPid;
+  }
+  if(cur == pid) first = node;
+  else if(node.write(cur, pf)) return RC_FILE_WRITE_FAILED;
+
+  //the first page changes only if it was the last one, or has a new one
+  if(cur == last && last != pid) return 0;
+  first.setLastNodePtr(cur);
+  return first.write(pid, pf);
+}
+
+/*
+ * remove a RecordId from the overflow pages at pid
+ */
+RC BTreeIndex::removeOverflow(PageId pid, const RecordId& rid, bool& empty)
+{
+  BTOverflowNode first, node, prevNode;
+  PageId cur = pid, prev = -1;
+  int eid;
+
+  empty = false;
+  if(first.read(pid, pf)) return RC_FILE_READ_FAILED;
+  node = first;
+  while(node.locate(rid, eid)){
+    //a larger RecordId in the page, or the end of the chain
+    if(eid < node.getRidCount() || node.getNextNodePtr() == -1) return RC_NO_SUCH_RECORD;
+    prev = cur;
+    prevNode = node;
+    cur = node.getNextNodePtr();
+    if(node.read(cur, pf)) return RC_FILE_READ_FAILED;
+  }
+  node.remove(eid);
+
+  //a page less than half full takes in the next page, or goes into the
+  //page in front of it, if they fit in one page
+  PageId nextPid = node.getNextNodePtr();
+  if(node.getRidCount() > 0 && node.isUnderfull() && nextPid != -1){
+    BTOverflowNode next;
+    if(next.read(nextPid, pf)) return RC_FILE_READ_FAILED;
+    if(node.merge(next) == 0){
+      if(first.getLastNodePtr() == nextPid){
+        if(cur == pid) node.setLastNodePtr(pid);
+        else{
+          first.setLastNodePtr(cur);
+          if(first.write(pid, pf)) return RC_FILE_WRITE_FAILED;
+        }
+      }
+      if(node.write(cur, pf)) return RC_FILE_WRITE_FAILED;
+      if(linkOverflow(node.getNextNodePtr(), cur)) return RC_FILE_WRITE_FAILED;
+      return freePage(nextPid);
+    }
+  }
+  if(node.getRidCount() > 0 && (prev == -1 || !node.isUnderfull() || prevNode.merge(node))){
+    return node.write(cur, pf);
+  }
+
+  //an empty first page is replaced by the second one
+  if(cur == pid){
+    PageId second = node.getNextNodePtr();
+    if(second == -1){
+      empty = true;
+      return freePage(pid);
+    }
+    if(node.read(second, pf)) return RC_FILE_READ_FAILED;
+    node.setLastNodePtr(first.getLastNodePtr() == second ? pid : first.getLastNodePtr());
+    node.setPrevNodePtr(-1);
+    if(node.write(pid, pf)) return RC_FILE_WRITE_FAILED;
+    if(linkOverflow(node.getNextNodePtr(), pid)) return RC_FILE_WRITE_FAILED;
+    return freePage(second);
+  }
+
+  //any other empty (or merged) page is unlinked
+  prevNode.setNextNodePtr(node.getNextNodePtr());
+  if(first.getLastNodePtr() == cur){
+    if(prev == pid) prevNode.setLastNodePtr(prev);
+    else{
+      first.setLastNodePtr(prev);
+      if(first.write(pid, pf)) return RC_FILE_WRITE_FAILED;
+    }
+  }
+  if(prevNode.write(prev, pf)) return RC_FILE_WRITE_FAILED;
+  if(linkOverflow(node.getNextNodePtr(), prev)) return RC_FILE_WRITE_FAILED;
+  return freePage(cur);
+}
+
+/*
+ * replace the RecordIds in the overflow pages at pid that are in moved.
+ * the RecordIds are sorted again, and the pages are written again if
+ * any of them changed
+ */
+RC BTreeIndex::remapOverflow(PageId pid, const RecordIdMap& moved)
+{
+  BTOverflowNode node;
+  RecordId buf[BTOverflowNode::MAX_RIDS];
+  vector<RecordId> rids;
+  vector<PageId> pages;
+  bool changed = false;
+  RC rc;
+
+  for(PageId cur = pid; cur != -1; cur = node.getNextNodePtr()){
+    if(node.read(cur, pf)) return RC_FILE_READ_FAILED;
+    pages.push_back(cur);
+    int n = node.readAll(buf);
+    for(int i = 0; i < n; i++){
+      RecordIdMap::const_iterator it = lower_bound(moved.begin(), moved.end(), buf[i], lessOldRid);
+      if(it != moved.end() && it->first == buf[i]){
+        buf[i] = it->second;
+        changed = true;
+      }
+    }
+    rids.insert(rids.end(), buf, buf+n);
+  }
+  if(!changed) return 0;
+
+  sort(rids.begin(), rids.end());
+  for(unsigned i = 1; i < pages.size(); i++){
+    if((rc = freePage(pages[i])) < 0) return rc;
+  }
+  return writeOverflow(pid, node.getKey(), &rids[0], rids.size());
+}
+
 
 /*
  *return true, if overflow
@@ -111,20 +588,21 @@ bool BTreeIndex::subInsert(PageId pid, int key, const RecordId& rid, int level,
       fprintf(stderr, "Error: cannot read from PageFile \n");
       return true;
     }
-    PageId child;
-    node.locateChildPtr(key, child);
-    if(subInsert(child, key, rid, level+1, midKey, newPid)){
+    //the new node goes right behind the child that split, even if
+    //midKey equals other keys of the node
+    int eid = node.locateChild(key);
+    if(subInsert(node.getChildPtr(eid), key, rid, level+1, midKey, newPid)){
       if(node.getKeyCount() < BTNonLeafNode::MAXKEY_NUM){
-        node.insert(midKey, newPid);
+        node.insert(eid, midKey, newPid);
         node.write(pid, pf);
         return false;
       }
       else{
         BTNonLeafNode newNode;
-        node.insertAndSplit(midKey, newPid, newNode, midKey);
+        node.insertAndSplit(eid, midKey, newPid, newNode, midKey);
         node.write(pid, pf);
-        newPid = pf.endPid();
-        newNode.write(pf.endPid(), pf);
+        newPid = newPage();
+        newNode.write(newPid, pf);
         return true;
       }
     }
@@ -136,24 +614,238 @@ bool BTreeIndex::subInsert(PageId pid, int key, const RecordId& rid, int level,
       fprintf(stderr, "Error: cannot read from PageFile \n");
       return RC_FILE_READ_FAILED;       
     }
-    if(node.getKeyCount() < BTLeafNode::MAXKEY_NUM){
-      node.insert(key, rid);
+    //a compressed leaf node is full when the entries no longer fit
+    if(insertLeaf(node, key, rid) != RC_NODE_FULL){
       node.write(pid, pf);
       return false;
     }
     else{
       BTLeafNode newNode;
       node.insertAndSplit(key, rid, newNode, midKey);
-      node.setNextNodePtr(pf.endPid());
+      newPid = newPage();
+      node.setNextNodePtr(newPid);
+      newNode.setPrevNodePtr(pid);
       node.write(pid, pf);
-      newPid = pf.endPid();
-      newNode.write(pf.endPid(), pf);
+      newNode.write(newPid, pf);
+      linkLeaf(newNode.getNextNodePtr(), newPid);
       return true;
     }
   }
 }
 
 
+/*
+ * insert the entries, sorted, in one descent of the tree. the root
+ * splits into new levels until one node holds what it split into
+ */
+RC BTreeIndex::insertBatch(const vector<IndexEntry>& entries)
+{
+  RC rc;
+
+  if(entries.empty()) return 0;
+  if((rc = dropRight()) < 0) return rc;
+  vector<IndexEntry> sorted(entries);
+  sort(sorted.begin(), sorted.end());
+
+  if(rootPid == -1){
+    BTLeafNode node;
+    rootPid = newPage();
+    treeHeight = 1;
+    if(node.write(rootPid, pf)) return RC_FILE_WRITE_FAILED;
+  }
+
+  vector<pair<int, PageId> > splits;
+  linkPid = -1;
+  if((rc = insertRun(rootPid, 1, true, &sorted[0], sorted.size(), splits)) < 0) return rc;
+  if((rc = linkLeaf(linkPid, linkPrev)) < 0) return rc;
+  while(!splits.empty()){
+    vector<int> keys;
+    vector<PageId> children(1, rootPid);
+    for(unsigned i = 0; i < splits.size(); i++){
+      keys.push_back(splits[i].first);
+      children.push_back(splits[i].second);
+    }
+    splits.clear();
+    rootPid = newPage();
+    treeHeight++;
+    if((rc = writeNonLeaf(rootPid, true, keys, children, splits)) < 0) return rc;
+  }
+  return 0;
+}
+
+/*
+ * insert the sorted entries into the subtree at pid. a child takes the
+ * entries in front of its key, as locateChild() tells, and the nodes
+ * that it split into go behind it. the last child of a node on the right
+ * edge is on it, too. the node is written only if a child split
+ */
+RC BTreeIndex::insertRun(PageId pid, int level, bool right, const IndexEntry* entries, int n,
+                         vector<pair<int, PageId> >& splits)
+{
+  if(level == treeHeight) return insertLeafRun(pid, entries, n, splits);
+
+  BTNonLeafNode node;
+  if(node.read(pid, pf)) return RC_FILE_READ_FAILED;
+  int count = node.getKeyCount();
+  vector<int> keys;
+  vector<PageId> children;
+  bool split = false;
+  RC rc;
+
+  for(int c = 0, i = 0; c <= count; c++){
+    children.push_back(node.getChildPtr(c));
+    int j = i;
+    if(c == count) j = n;
+    else while(j < n && entries[j].first < node.getKey(c)) j++;
+    if(j > i){
+      vector<pair<int, PageId> > childSplits;
+      if((rc = insertRun(node.getChildPtr(c), level+1, right && c == count, entries+i, j-i,
+                         childSplits)) < 0) return rc;
+      for(unsigned k = 0; k < childSplits.size(); k++){
+        keys.push_back(childSplits[k].first);
+        children.push_back(childSplits[k].second);
+        split = true;
+      }
+      i = j;
+    }
+    if(c < count) keys.push_back(node.getKey(c));
+  }
+  if(!split) return 0;
+  return writeNonLeaf(pid, right, keys, children, splits);
+}
+
+/*
+ * merge the sorted entries into the leaf node at pid. the RecordIds of a
+ * key with overflow pages go there, and a key with more than
+ * OVERFLOW_RUN entries afterwards moves to new overflow pages. the
+ * entries are spread evenly over the fewest nodes that are at most
+ * APPEND_SPLIT percent full, pid and new nodes behind it. the rightmost
+ * leaf node splits as insertRight() splits it: each node but the last
+ * takes APPEND_SPLIT percent, and the last one the rest, so that later
+ * appends fill it before it splits again
+ */
+RC BTreeIndex::insertLeafRun(PageId pid, const IndexEntry* entries, int n,
+                             vector<pair<int, PageId> >& splits)
+{
+  BTLeafNode node;
+  RC rc;
+
+  //the node behind the last one that split is usually the next one, so
+  //its previous sibling pointer is set when it is written
+  if(node.read(pid, pf)) return RC_FILE_READ_FAILED;
+  bool relinked = (linkPid == pid);
+  if(relinked) node.setPrevNodePtr(linkPrev);
+  else if((rc = linkLeaf(linkPid, linkPrev)) < 0) return rc;
+  linkPid = -1;
+  vector<IndexEntry> old(node.getKeyCount());
+  for(unsigned i = 0; i < old.size(); i++) node.readEntry(i, old[i].first, old[i].second);
+
+  vector<IndexEntry> run;
+  for(int i = 0, j; i < n; i = j){
+    int key = entries[i].first;
+    for(j = i; j < n && entries[j].first == key; j++);
+    PageId overflow = -1;
+    vector<IndexEntry>::iterator it = lower_bound(old.begin(), old.end(), IndexEntry(key, RecordId()),
+                                                  lessKey<RecordId>);
+    for(; it != old.end() && it->first == key; it++){
+      if(it->second.sid == BTLeafNode::OVERFLOW_SID) overflow = it->second.pid;
+    }
+    if(overflow == -1){
+      run.insert(run.end(), entries+i, entries+j);
+      continue;
+    }
+    vector<RecordId> rids;
+    for(int k = i; k < j; k++) rids.push_back(entries[k].second);
+    if((rc = appendOverflow(overflow, &rids[0], rids.size())) < 0) return rc;
+  }
+  if(run.empty()) return relinked ? node.write(pid, pf) : 0;
+
+  vector<IndexEntry> all(old.size() + run.size());
+  merge(old.begin(), old.end(), run.begin(), run.end(), all.begin());
+  vector<int> keys;
+  vector<RecordId> rids;
+  for(unsigned i = 0, j; i < all.size(); i = j){
+    bool overflow = false;
+    for(j = i; j < all.size() && all[j].first == all[i].first; j++){
+      if(all[j].second.sid == BTLeafNode::OVERFLOW_SID) overflow = true;
+    }
+    if(overflow || j-i <= (unsigned)OVERFLOW_RUN){
+      for(unsigned k = i; k < j; k++){
+        keys.push_back(all[k].first);
+        rids.push_back(all[k].second);
+      }
+      continue;
+    }
+    vector<RecordId> group;
+    for(unsigned k = i; k < j; k++) group.push_back(all[k].second);
+    RecordId r;
+    r.pid = newPage();
+    r.sid = BTLeafNode::OVERFLOW_SID;
+    if((rc = writeOverflow(r.pid, all[i].first, &group[0], group.size())) < 0) return rc;
+    keys.push_back(all[i].first);
+    rids.push_back(r);
+  }
+
+  int m = keys.size(), done = 0;
+  PageId cur = pid, prev = node.getPrevNodePtr(), next = node.getNextNodePtr();
+  for(;;){
+    BTLeafNode leaf;
+    int left = m-done;
+    int fit = leaf.fill(&keys[done], &rids[done], left);
+    if(fit < left){
+      int most = fit*APPEND_SPLIT/100;
+      if(most < 1) most = 1;
+      int nodes = (left+most-1)/most;
+      fit = leaf.fill(&keys[done], &rids[done], (next == -1) ? most : (left+nodes-1)/nodes);
+    }
+    done += fit;
+    PageId newPid = (done < m) ? newPage() : next;
+    leaf.setPrevNodePtr(prev);
+    leaf.setNextNodePtr(newPid);
+    if(leaf.write(cur, pf)) return RC_FILE_WRITE_FAILED;
+    if(done == m) break;
+    splits.push_back(make_pair(keys[done], newPid));
+    prev = cur;
+    cur = newPid;
+  }
+  if(cur != pid){
+    linkPid = next;
+    linkPrev = cur;
+  }
+  return 0;
+}
+
+/*
+ * write a nonleaf node of keys and children to pid. if they do not fit
+ * in one node, the children are spread evenly over the fewest nodes that
+ * are at most APPEND_SPLIT percent full, and the keys between the nodes
+ * go to splits. on the right edge, each node but the last is APPEND_SPLIT
+ * percent full, and the last one takes the rest
+ */
+RC BTreeIndex::writeNonLeaf(PageId pid, bool right, const vector<int>& keys,
+                            const vector<PageId>& children, vector<pair<int, PageId> >& splits)
+{
+  int total = children.size();
+  int most = (total <= BTNonLeafNode::MAXKEY_NUM+1) ? total : BTNonLeafNode::MAXKEY_NUM*APPEND_SPLIT/100 + 1;
+  int nodes = (total+most-1)/most;
+  PageId cur = pid;
+
+  for(int k = 0, a = 0; k < nodes; k++){
+    int b = a + (total-a + nodes-k-1)/(nodes-k);
+    if(right) b = (total-a <= BTNonLeafNode::MAXKEY_NUM+1) ? total : a+most;
+    BTNonLeafNode node;
+    node.initializeRoot(children[a], keys[a], children[a+1]);
+    for(int c = a+1; c < b-1; c++) node.insert(c-a, keys[c], children[c+1]);
+    if(node.write(cur, pf)) return RC_FILE_WRITE_FAILED;
+    if(b == total) break;
+    cur = newPage();
+    splits.push_back(make_pair(keys[b-1], cur));
+    a = b;
+  }
+  return 0;
+}
+
+
 /**
  * Run the standard B+Tree key search algorithm and identify the
  * leaf node where searchKey may exist. If an index entry with
@@ -174,20 +866,39 @@ bool BTreeIndex::subInsert(PageId pid, int key, const RecordId& rid, int level,
  */
 RC BTreeIndex::locate(int searchKey, IndexCursor& cursor)
 {
-  if(rootPid == -1) return RC_NO_SUCH_RECORD;
+  if(flushRight()) return RC_FILE_WRITE_FAILED;
+  cursor.opid = -1;
+  cursor.oeid = 0;
+  if(rootPid == -1){
+    cursor.pid = -1;
+    cursor.eid = 0;
+    return RC_NO_SUCH_RECORD;
+  }
+
+  //entries with the same key may be split over two nodes, and the
+  //separator between them equals the key. searching for searchKey-1 leads
+  //to the leftmost node that may have the key
   PageId pid = rootPid;
   for(int i = 1; i < treeHeight; i++){
     BTNonLeafNode node;
     node.read(pid, pf);
-    node.locateChildPtr(searchKey, pid);
+    pid = node.getChildPtr(searchKey == INT_MIN ? 0 : node.locateChild(searchKey-1));
   }
   BTLeafNode node;
   node.read(pid, pf);
+  cursor.pid = pid;
   if(node.locate(searchKey, cursor.eid)){
-    return RC_NO_SUCH_RECORD;
+    //every key in this leaf is smaller, so the next entry is the first of the next leaf
+    cursor.pid = node.getNextNodePtr();
+    cursor.eid = 0;
+    if(cursor.pid == -1 || node.read(cursor.pid, pf)) return RC_NO_SUCH_RECORD;
   }
-  cursor.pid = pid;
-  return 0;
+
+  int key;
+  RecordId rid;
+  if(cursor.eid >= node.getKeyCount()) return RC_NO_SUCH_RECORD;
+  node.readEntry(cursor.eid, key, rid);
+  return (key == searchKey) ? 0 : RC_NO_SUCH_RECORD;
 }
 
 /*
@@ -201,10 +912,44 @@ RC BTreeIndex::locate(int searchKey, IndexCursor& cursor)
 RC BTreeIndex::readForward(IndexCursor& cursor, int& key, RecordId& rid)
 {
   BTLeafNode node;
+  if(cursor.pid == -1) return RC_END_OF_TREE;
+  if(flushRight()) return RC_FILE_WRITE_FAILED;
+
+  //a cursor in the overflow pages of a key reads them to the end and
+  //then goes on behind the overflow entry
+  if(cursor.opid != -1){
+    BTOverflowNode page;
+    if(page.read(cursor.opid, pf)){
+      return RC_FILE_READ_FAILED;
+    }
+    key = page.getKey();
+    page.readEntry(cursor.oeid, rid);
+    if(++cursor.oeid >= page.getRidCount()){
+      cursor.opid = page.getNextNodePtr();
+      cursor.oeid = 0;
+      if(cursor.opid == -1) cursor.eid++;
+    }
+    return 0;
+  }
+
   if(node.read(cursor.pid, pf)){
     return RC_FILE_READ_FAILED;
   }
+  //a leaf node may run out of entries after remove()
+  while(cursor.eid >= node.getKeyCount()){
+    cursor.pid = node.getNextNodePtr();
+    cursor.eid = 0;
+    if(cursor.pid == -1) return RC_END_OF_TREE;
+    if(node.read(cursor.pid, pf)){
+      return RC_FILE_READ_FAILED;
+    }
+  }
   node.readEntry(cursor.eid, key, rid);
+  if(rid.sid == BTLeafNode::OVERFLOW_SID){
+    cursor.opid = rid.pid;
+    cursor.oeid = 0;
+    return readForward(cursor, key, rid);
+  }
   if(cursor.eid < node.getKeyCount()-1)
     cursor.eid++;
   else{
@@ -213,3 +958,324 @@ RC BTreeIndex::readForward(IndexCursor& cursor, int& key, RecordId& rid)
   }
   return 0;
 }
+
+/*
+ * Set the cursor to the last entry whose key is not larger than
+ * searchKey, for readBackward().
+ * @param searchKey[IN] the largest key to read
+ * @param cursor[OUT] the cursor pointing to the last index entry with a
+ *                    key not larger than searchKey
+ * @return error code. 0 if no error
+ */
+RC BTreeIndex::locateBackward(int searchKey, IndexCursor& cursor)
+{
+  if(flushRight()) return RC_FILE_WRITE_FAILED;
+  cursor.opid = -1;
+  cursor.oeid = 0;
+  if(rootPid == -1){
+    cursor.pid = -1;
+    cursor.eid = 0;
+    return 0;
+  }
+
+  //the entry is in the rightmost node that searchKey may lead to, or
+  //at the end of the node in front of it
+  PageId pid = rootPid;
+  for(int i = 1; i < treeHeight; i++){
+    BTNonLeafNode node;
+    if(node.read(pid, pf)) return RC_FILE_READ_FAILED;
+    pid = node.getChildPtr(node.locateChild(searchKey));
+  }
+  BTLeafNode node;
+  if(node.read(pid, pf)) return RC_FILE_READ_FAILED;
+  cursor.pid = pid;
+  if(searchKey == INT_MAX) cursor.eid = node.getKeyCount();
+  else node.locate(searchKey+1, cursor.eid);
+
+  //eid -1 makes readBackward() go on in the node in front
+  cursor.eid--;
+  return 0;
+}
+
+/*
+ * Read the (key, rid) pair at the location specified by the index cursor,
+ * and move the cursor back to the previous entry.
+ * @param cursor[IN/OUT] the cursor pointing to an leaf-node index entry in the b+tree
+ * @param key[OUT] the key stored at the index cursor location.
+ * @param rid[OUT] the RecordId stored at the index cursor location.
+ * @return error code. 0 if no error
+ */
+RC BTreeIndex::readBackward(IndexCursor& cursor, int& key, RecordId& rid)
+{
+  BTLeafNode node;
+  if(cursor.pid == -1) return RC_END_OF_TREE;
+  if(flushRight()) return RC_FILE_WRITE_FAILED;
+
+  //a cursor in the overflow pages of a key reads them back to the first
+  //one and then goes on in front of the overflow entry. oeid -1 is the
+  //last RecordId of a page
+  if(cursor.opid != -1){
+    BTOverflowNode page;
+    if(page.read(cursor.opid, pf)){
+      return RC_FILE_READ_FAILED;
+    }
+    if(cursor.oeid < 0 || cursor.oeid >= page.getRidCount()) cursor.oeid = page.getRidCount()-1;
+    key = page.getKey();
+    page.readEntry(cursor.oeid, rid);
+    if(--cursor.oeid < 0){
+      cursor.opid = page.getPrevNodePtr();
+      if(cursor.opid == -1) cursor.eid--;
+    }
+    return 0;
+  }
+
+  if(node.read(cursor.pid, pf)){
+    return RC_FILE_READ_FAILED;
+  }
+  //a leaf node may have lost entries after remove()
+  if(cursor.eid >= node.getKeyCount()) cursor.eid = node.getKeyCount()-1;
+  while(cursor.eid < 0){
+    cursor.pid = node.getPrevNodePtr();
+    if(cursor.pid == -1) return RC_END_OF_TREE;
+    if(node.read(cursor.pid, pf)){
+      return RC_FILE_READ_FAILED;
+    }
+    cursor.eid = node.getKeyCount()-1;
+  }
+  node.readEntry(cursor.eid, key, rid);
+  if(rid.sid == BTLeafNode::OVERFLOW_SID){
+    BTOverflowNode first;
+    if(first.read(rid.pid, pf)){
+      return RC_FILE_READ_FAILED;
+    }
+    cursor.opid = first.getLastNodePtr();
+    cursor.oeid = -1;
+    return readBackward(cursor, key, rid);
+  }
+  cursor.eid--;
+  return 0;
+}
+
+/*
+ * Remove the (key, rid) pair from the index.
+ * @param key[IN] the key of the entry to remove
+ * @param rid[IN] the RecordId of the entry to remove
+ * @return error code. RC_NO_SUCH_RECORD if the entry is not in the index
+ */
+RC BTreeIndex::remove(int key, const RecordId& rid)
+{
+  RC rc;
+  bool underfull;
+
+  //the nodes are changed in place
+  if(dropRight()) return RC_FILE_WRITE_FAILED;
+  if(rootPid == -1) return RC_NO_SUCH_RECORD;
+  if((rc = subRemove(rootPid, key, rid, 1, underfull)) < 0) return rc;
+
+  //a root left with one child is replaced by the child
+  if(underfull && treeHeight > 1){
+    BTNonLeafNode root;
+    if(root.read(rootPid, pf)) return RC_FILE_READ_FAILED;
+    if(root.getKeyCount() == 0){
+      PageId pid = rootPid;
+      rootPid = root.getChildPtr(0);
+      treeHeight--;
+      return freePage(pid);
+    }
+  }
+  return 0;
+}
+
+/*
+ * remove the (key, rid) pair from the subtree at pid.
+ * underfull is set if the node at pid is less than half full afterwards
+ */
+RC BTreeIndex::subRemove(PageId pid, int key, const RecordId& rid, int level, bool& underfull)
+{
+  RC rc;
+
+  underfull = false;
+  if(level < treeHeight){
+    BTNonLeafNode node;
+    bool childUnderfull;
+    if(node.read(pid, pf)){
+      return RC_FILE_READ_FAILED;
+    }
+
+    //entries with the same key may be split over two children, and the
+    //separator between them equals the key. searching for key-1 leads to
+    //the leftmost child that may have the key
+    int eid = (key == INT_MIN) ? 0 : node.locateChild(key-1);
+    while((rc = subRemove(node.getChildPtr(eid), key, rid, level+1, childUnderfull)) == RC_NO_SUCH_RECORD){
+      if(eid == node.getKeyCount() || node.getKey(eid) != key) return rc;
+      eid++;
+    }
+    if(rc < 0) return rc;
+    if(!childUnderfull || node.getKeyCount() == 0) return 0;
+
+    if((rc = rebalance(node, eid, level)) < 0) return rc;
+    underfull = node.isUnderfull();
+    return node.write(pid, pf);
+  }
+  else{
+    BTLeafNode node;
+    int eid, k;
+    RecordId r;
+    if(node.read(pid, pf)){
+      return RC_FILE_READ_FAILED;
+    }
+    node.locate(key, eid);
+    for(; eid < node.getKeyCount(); eid++){
+      node.readEntry(eid, k, r);
+      if(k > key) return RC_NO_SUCH_RECORD;
+
+      //the overflow entry goes when its pages have no RecordId left
+      if(r.sid == BTLeafNode::OVERFLOW_SID){
+        bool empty;
+        if((rc = removeOverflow(r.pid, rid, empty)) == RC_NO_SUCH_RECORD) continue;
+        if(rc < 0 || !empty) return rc;
+      }
+      else if(r != rid) continue;
+      node.remove(eid);
+      underfull = node.isUnderfull();
+      return node.write(pid, pf);
+    }
+    return RC_NO_SUCH_RECORD;
+  }
+}
+
+/*
+ * the child eid of node is underfull. it is merged with its left
+ * sibling, or with its right one if it is the first child. if the two
+ * do not fit in one node, their entries are split half and half
+ */
+RC BTreeIndex::rebalance(BTNonLeafNode& node, int eid, int level)
+{
+  int left = (eid > 0) ? eid-1 : eid;
+  PageId leftPid = node.getChildPtr(left);
+  PageId rightPid = node.getChildPtr(left+1);
+  int midKey = node.getKey(left);
+
+  if(level+1 == treeHeight){
+    BTLeafNode l, r;
+    if(l.read(leftPid, pf) || r.read(rightPid, pf)){
+      return RC_FILE_READ_FAILED;
+    }
+    if(l.merge(r) == 0){
+      node.remove(left);
+      if(l.write(leftPid, pf)) return RC_FILE_WRITE_FAILED;
+      if(linkLeaf(l.getNextNodePtr(), leftPid)) return RC_FILE_WRITE_FAILED;
+      return freePage(rightPid);
+    }
+    l.redistribute(r, midKey);
+    if(l.write(leftPid, pf) || r.write(rightPid, pf)) return RC_FILE_WRITE_FAILED;
+  }
+  else{
+    BTNonLeafNode l, r;
+    if(l.read(leftPid, pf) || r.read(rightPid, pf)){
+      return RC_FILE_READ_FAILED;
+    }
+    if(l.merge(midKey, r) == 0){
+      node.remove(left);
+      if(l.write(leftPid, pf)) return RC_FILE_WRITE_FAILED;
+      return freePage(rightPid);
+    }
+    l.redistribute(midKey, r);
+    if(l.write(leftPid, pf) || r.write(rightPid, pf)) return RC_FILE_WRITE_FAILED;
+  }
+  node.setKey(left, midKey);
+  return 0;
+}
+
+/*
+ * Replace the RecordIds of the records moved by RecordFile::vacuum().
+ * @param moved[IN] the old and new RecordIds, sorted by the old RecordId
+ * @return error code. 0 if no error
+ */
+RC BTreeIndex::remapRids(const RecordIdMap& moved)
+{
+  IndexCursor cursor;
+  BTLeafNode node;
+  int key;
+  RecordId rid;
+  vector<pair<int, RecordId> > reinserted;
+  RC rc;
+
+  if(moved.empty()) return 0;
+  if(dropRight()) return RC_FILE_WRITE_FAILED;
+
+  //walk the leaves from the leftmost one
+  locate(INT_MIN, cursor);
+  while(cursor.pid != -1){
+    bool changed = false;
+    if(node.read(cursor.pid, pf)){
+      return RC_FILE_READ_FAILED;
+    }
+    for(int eid = 0; eid < node.getKeyCount(); eid++){
+      node.readEntry(eid, key, rid);
+      if(rid.sid == BTLeafNode::OVERFLOW_SID){
+        if((rc = remapOverflow(rid.pid, moved)) < 0) return rc;
+        continue;
+      }
+      RecordIdMap::const_iterator it = lower_bound(moved.begin(), moved.end(), rid, lessOldRid);
+      if(it != moved.end() && it->first == rid){
+        //the new RecordId may not fit in the compressed leaf node. the
+        //entry is then taken out and inserted again after the walk
+        if(node.writeEntry(eid, key, it->second) == RC_NODE_FULL){
+          node.remove(eid--);
+          reinserted.push_back(make_pair(key, it->second));
+        }
+        changed = true;
+      }
+    }
+    if(changed && node.write(cursor.pid, pf)){
+      return RC_FILE_WRITE_FAILED;
+    }
+    cursor.pid = node.getNextNodePtr();
+  }
+  for(unsigned i = 0; i < reinserted.size(); i++){
+    if((rc = insert(reinserted[i].first, reinserted[i].second)) < 0) return rc;
+  }
+  return 0;
+}
+
+RC BTreeIndex::getStats(int& height, int& pages, int& leaves, int& entries)
+{
+  IndexCursor cursor;
+  BTLeafNode node;
+
+  if(flushRight()) return RC_FILE_WRITE_FAILED;
+  height = treeHeight;
+  pages = pf.endPid();
+  leaves = entries = 0;
+  if(treeHeight == 0) return 0;
+
+  //walk the leaves from the leftmost one
+  locate(INT_MIN, cursor);
+  while(cursor.pid != -1){
+    if(node.read(cursor.pid, pf)){
+      return RC_FILE_READ_FAILED;
+    }
+    leaves++;
+    for(int eid = 0; eid < node.getKeyCount(); eid++){
+      int key;
+      RecordId rid;
+      node.readEntry(eid, key, rid);
+      if(rid.sid != BTLeafNode::OVERFLOW_SID){
+        entries++;
+        continue;
+      }
+
+      //the RecordIds in the overflow pages count as entries
+      BTOverflowNode page;
+      for(PageId pid = rid.pid; pid != -1; pid = page.getNextNodePtr()){
+        if(page.read(pid, pf)){
+          return RC_FILE_READ_FAILED;
+        }
+        entries += page.getRidCount();
+      }
+    }
+    cursor.pid = node.getNextNodePtr();
+  }
+  return 0;
+}
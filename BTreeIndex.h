@@ -10,14 +10,19 @@
 #ifndef BTREEINDEX_H
 #define BTREEINDEX_H
 
+#include <utility>
+#include <vector>
 #include "Bruinbase.h"
 #include "PageFile.h"
 #include "RecordFile.h"
+#include "BTreeNode.h"
              
 /**
  * The data structure to point to a particular entry at a b+tree leaf node.
  * An IndexCursor consists of pid (PageId of the leaf node) and 
  * eid (the location of the index entry inside the node).
+ * At an overflow entry of a leaf node, opid and oeid point to the
+ * RecordId in the overflow pages of the key (see BTOverflowNode).
  * IndexCursor is used for index lookup and traversal.
  */
 typedef struct {
@@ -25,14 +30,68 @@ typedef struct {
   PageId  pid;  
   // The entry number inside the node
   int     eid;  
+  // PageId of the overflow page, -1 if the cursor is not in one
+  PageId  opid;
+  // The entry number inside the overflow page
+  int     oeid;
 } IndexCursor;
 
+/**
+ * A (key, RecordId) pair to insert into the index (see insertBatch()).
+ */
+typedef std::pair<int, RecordId> IndexEntry;
+
+/**
+ * order (key, ...) pairs by their keys alone: the IndexEntries of
+ * insertBatch() and the (key, value) tuples of a table.
+ */
+template <class T>
+inline bool lessKey(const std::pair<int, T>& a, const std::pair<int, T>& b)
+{
+  return a.first < b.first;
+}
+
 /**
  * Implements a B-Tree index for bruinbase.
- * 
+ *
+ * The index keeps the path from the root to the rightmost leaf node, and
+ * that leaf node itself, in memory. A key that belongs to the rightmost
+ * leaf node (an append of a key not smaller than the separators on the
+ * path) is inserted there without a descent. The leaf node is written
+ * when it splits or before the index is read or changed in another way.
+ * A node on the right edge that splits on an append keeps APPEND_SPLIT
+ * percent of its entries, so loads in key order build dense nodes; a key
+ * in front of the last keys of the rightmost leaf node splits it where
+ * the key goes, so an occasional late key does not leave it half empty.
+ * insertBatch() splits the nodes on the right edge the same way.
+ *
+ * A key with more than OVERFLOW_RUN entries in a leaf node has its
+ * RecordIds moved to a chain of overflow pages, and one leaf entry that
+ * points to them. An equality lookup on a key with many duplicates reads
+ * the chain instead of many leaf nodes.
+ *
+ * The leaf nodes are linked both ways, and so are the overflow pages of a
+ * key, so that locateBackward() and readBackward() read the entries in
+ * descending key order from any key: the last N entries take a descent
+ * of the right edge and the leaf nodes that hold them.
+ *
+ * A node that is less than half full after remove() borrows entries from
+ * a sibling node, or is merged with it. The pages of merged nodes go to
+ * a list of free pages, which new nodes are taken from first. Page 0 has
+ * the tree height, the root, FREE_LIST_MAGIC and the first free page.
  */
 class BTreeIndex {
  public:
+  // the percentage of the entries kept in a node split by an append
+  static const int APPEND_SPLIT = 90;
+
+  // the most entries of a key in a leaf node before they are moved to
+  // overflow pages. fewer would leave the overflow pages mostly empty
+  static const int OVERFLOW_RUN = BTLeafNode::MAXKEY_NUM/2;
+
+  // tells that page 0 has the free page list. older index files lack it
+  static const int FREE_LIST_MAGIC = 0x314c5246;  // "FRL1"
+
   BTreeIndex();
 
   /**
@@ -59,9 +118,22 @@ class BTreeIndex {
   RC insert(int key, const RecordId& rid);
   bool subInsert(PageId pid, int key, const RecordId& rid, int level, int& midKey, PageId& newPid);
 
+  /**
+   * Insert many (key, RecordId) pairs to the index at once. The pairs are
+   * sorted, and the run of them that goes to a child node is passed down
+   * in one descent, so a node is read and written once however many
+   * pairs it takes. A leaf node takes its run in one merge and splits
+   * into as many nodes as it needs, each at most APPEND_SPLIT percent full.
+   * A node on the right edge fills its new nodes to APPEND_SPLIT percent
+   * but the last one, as an append of the pairs one by one would.
+   * @param entries[IN] the (key, RecordId) pairs, in any order
+   * @return error code. 0 if no error
+   */
+  RC insertBatch(const std::vector<IndexEntry>& entries);
+
   /**
    * Run the standard B+Tree key search algorithm and identify the
-   * leaf node where searchKey may exist. If an index entry with
+   * leftmost leaf node where searchKey may exist. If an index entry with
    * searchKey exists in the leaf node, set IndexCursor to its location 
    * (i.e., IndexCursor.pid = PageId of the leaf node, and
    * IndexCursor.eid = the searchKey index entry number.) and return 0. 
@@ -88,6 +160,62 @@ class BTreeIndex {
    * @return error code. 0 if no error
    */
   RC readForward(IndexCursor& cursor, int& key, RecordId& rid);
+
+  /**
+   * Set the cursor to the last index entry whose key is not larger than
+   * searchKey, so that readBackward() reads the entries from there in
+   * descending key order. With searchKey INT_MAX, it is the last entry
+   * of the index, found by going down the right edge of the tree.
+   * @param searchKey[IN] the largest key to read
+   * @param cursor[OUT] the cursor pointing to the last index entry with a
+   *                    key not larger than searchKey
+   * @return error code. 0 if no error
+   */
+  RC locateBackward(int searchKey, IndexCursor& cursor);
+
+  /**
+   * Read the (key, rid) pair at the location specified by the index cursor,
+   * and move the cursor back to the previous entry. The entries with the
+   * same key come in descending RecordId order.
+   * @param cursor[IN/OUT] the cursor pointing to an leaf-node index entry in the b+tree
+   * @param key[OUT] the key stored at the index cursor location
+   * @param rid[OUT] the RecordId stored at the index cursor location
+   * @return error code. RC_END_OF_TREE after the first entry
+   */
+  RC readBackward(IndexCursor& cursor, int& key, RecordId& rid);
+
+  /**
+   * Remove the (key, rid) pair from the index.
+   * A node that becomes less than half full borrows entries from a
+   * sibling, or is merged with it. A root with one child is replaced by
+   * the child, so the tree gets lower. A leaf root may become empty.
+   * @param key[IN] the key of the entry to remove
+   * @param rid[IN] the RecordId of the entry to remove
+   * @return error code. RC_NO_SUCH_RECORD if the entry is not in the index
+   */
+  RC remove(int key, const RecordId& rid);
+  RC subRemove(PageId pid, int key, const RecordId& rid, int level, bool& underfull);
+
+  /**
+   * Replace the RecordIds of the records moved by RecordFile::vacuum().
+   * Every leaf node is visited once and written only if it changed. An
+   * entry whose new RecordId does not fit in its compressed leaf node is
+   * removed and inserted again.
+   * @param moved[IN] the old and new RecordIds, sorted by the old RecordId
+   * @return error code. 0 if no error
+   */
+  RC remapRids(const RecordIdMap& moved);
+
+  /**
+   * Count the nodes and the entries of the tree, for ANALYZE.
+   * The leaf nodes are visited from the leftmost one.
+   * @param height[OUT] the height of the tree
+   * @param pages[OUT] # pages of the index file
+   * @param leaves[OUT] # leaf nodes
+   * @param entries[OUT] # entries in the leaf nodes
+   * @return error code. 0 if no error
+   */
+  RC getStats(int& height, int& pages, int& leaves, int& entries);
   
  private:
   PageFile pf;         /// the PageFile used to store the actual b+tree in disk
@@ -98,6 +226,81 @@ class BTreeIndex {
   /// this class is destructed. Make sure to store the values of the two 
   /// variables in disk, so that they can be reconstructed when the index
   /// is opened again later.
+  PageId   freePid;    /// the first page of the free page list. -1 if none
+  int      newPages;   /// # pages taken by newPage() so far
+  PageId   endPid;     /// the first page behind those taken by newPage(),
+                       /// which may be taken before they are written
+
+  std::vector<PageId> rightPath; /// the nodes from the root to the rightmost
+                                 /// leaf node. empty if not known
+  int        rightKey;           /// the keys >= rightKey go to the rightmost leaf
+  BTLeafNode rightLeaf;          /// the rightmost leaf node
+  bool       rightDirty;         /// has rightLeaf changed since it was written?
+  PageId     linkPid;            /// the leaf node whose previous sibling pointer
+  PageId     linkPrev;           /// insertLeafRun() has yet to set to linkPrev,
+                                 /// when it writes the node. -1 if none
+
+  // find the right edge of the tree and read its leaf node
+  RC findRightPath();
+
+  // insert an entry into the rightmost leaf node, splitting the
+  // nodes on the right edge as needed
+  RC insertRight(int key, const RecordId& rid);
+
+  // write the rightmost leaf node if it changed
+  RC flushRight();
+
+  // write the rightmost leaf node and forget the right edge, before
+  // the nodes are changed in place
+  RC dropRight();
+
+  // the page for a new node: a free page, or a page behind the last one
+  PageId newPage();
+
+  // put a page on the free page list
+  RC freePage(PageId pid);
+
+  // set the previous sibling pointer of the leaf node, or of the
+  // overflow page, at pid to prev. nothing if pid is -1
+  RC linkLeaf(PageId pid, PageId prev);
+  RC linkOverflow(PageId pid, PageId prev);
+
+  // insert an entry into a leaf node that has been read, or into the
+  // overflow pages of its key. RC_NODE_FULL if the node must split
+  RC insertLeaf(BTLeafNode& node, int key, const RecordId& rid);
+
+  // insert the n sorted entries into the subtree at pid on level, or
+  // into the leaf node at pid. right tells if pid is on the right edge.
+  // the nodes that pid split into are added to splits, with the keys in
+  // front of them
+  RC insertRun(PageId pid, int level, bool right, const IndexEntry* entries, int n,
+               std::vector<std::pair<int, PageId> >& splits);
+  RC insertLeafRun(PageId pid, const IndexEntry* entries, int n,
+                   std::vector<std::pair<int, PageId> >& splits);
+
+  // write a nonleaf node of keys and children to pid, split into more
+  // nodes (added to splits) if they do not fit in one. right tells if pid
+  // is on the right edge
+  RC writeNonLeaf(PageId pid, bool right, const std::vector<int>& keys,
+                  const std::vector<PageId>& children, std::vector<std::pair<int, PageId> >& splits);
+
+  // create the overflow pages of key from pid on, with n RecordIds in order
+  RC writeOverflow(PageId pid, int key, const RecordId* rids, int n);
+
+  // insert a RecordId into, or remove it from, the overflow pages at pid.
+  // empty is set if the pages (then freed) had no other RecordId
+  RC insertOverflow(PageId pid, const RecordId& rid);
+  RC removeOverflow(PageId pid, const RecordId& rid, bool& empty);
+
+  // insert n RecordIds, in order, into the overflow pages at pid
+  RC appendOverflow(PageId pid, const RecordId* rids, int n);
+
+  // replace the RecordIds in the overflow pages at pid that are in moved
+  RC remapOverflow(PageId pid, const RecordIdMap& moved);
+
+  // borrow entries for, or merge, the underfull child eid of the
+  // nonleaf node at level with its sibling
+  RC rebalance(BTNonLeafNode& node, int eid, int level);
 };
 
 #endif /* BTREEINDEX_H */
@@ -1,11 +1,307 @@
+#include <climits>
+#include <cstdlib>
+#include <cstring>
 #include "BTreeNode.h"
 
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define BTREE_SIMD
+#endif
+
 using namespace std;
 
+/*
+ * The search kernels: # keys smaller than key in a sorted array.
+ * The keys are halved by a binary search whose step is a conditional
+ * move instead of a branch, until SEARCH_WINDOW keys are left. The
+ * SIMD kernels compare the keys left in groups of 8 (AVX2) or 4 (SSE2).
+ */
+static const int SEARCH_WINDOW = 16;
+
+static const int* narrowKeys(const int* base, int& n, int key, int window)
+{
+  while(n > window){
+    int half = n/2;
+    base = (base[half] < key) ? base+half : base;
+    n -= half;
+  }
+  return base;
+}
+
+static int countBelowScalar(const int* keys, int n, int key)
+{
+  if(n == 0) return 0;
+  const int* base = narrowKeys(keys, n, key, 1);
+  return (base-keys) + (*base < key);
+}
+
+#ifdef BTREE_SIMD
+__attribute__((target("sse2")))
+static int countBelowSse2(const int* keys, int n, int key)
+{
+  const int* base = narrowKeys(keys, n, key, SEARCH_WINDOW);
+  __m128i k = _mm_set1_epi32(key);
+  int count = base-keys, i = 0;
+  for(; i + 4 <= n; i += 4){
+    __m128i v = _mm_loadu_si128((const __m128i *)(base+i));
+    count += __builtin_popcount(_mm_movemask_ps(_mm_castsi128_ps(_mm_cmplt_epi32(v, k))));
+  }
+  for(; i < n; i++) count += (base[i] < key);
+  return count;
+}
+
+__attribute__((target("avx2")))
+static int countBelowAvx2(const int* keys, int n, int key)
+{
+  const int* base = narrowKeys(keys, n, key, SEARCH_WINDOW);
+  __m256i k = _mm256_set1_epi32(key);
+  int count = base-keys, i = 0;
+  for(; i + 8 <= n; i += 8){
+    __m256i v = _mm256_loadu_si256((const __m256i *)(base+i));
+    count += __builtin_popcount(_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(k, v))));
+  }
+  for(; i < n; i++) count += (base[i] < key);
+  return count;
+}
+#endif
+
+/*
+ * pick the kernel for the CPU once
+ */
+static int (*pickKernel())(const int*, int, int)
+{
+  const char* env = getenv("BRUINBASE_SIMD");
+  if(env != NULL && atoi(env) == 0) return countBelowScalar;
+#ifdef BTREE_SIMD
+  __builtin_cpu_init();
+  if(__builtin_cpu_supports("avx2")) return countBelowAvx2;
+  if(__builtin_cpu_supports("sse2")) return countBelowSse2;
+#endif
+  return countBelowScalar;
+}
+
+static int (*const countBelow)(const int*, int, int) = pickKernel();
+
+/*
+ * The search of a nonleaf node with a summary (see BTNonLeafNode): the
+ * # keys smaller than key, from the summary keys and the one block of
+ * keys that they point to. The SIMD kernels compare all summary keys at
+ * once, and then the whole block, masking off the keys behind the last
+ * one, so there is no search loop left.
+ */
+static const int SUMMARY_KEYS = BTNonLeafNode::SUMMARY_KEYS;
+static const int BLOCK_KEYS = BTNonLeafNode::BLOCK_KEYS;
+
+static int locateScalar(const int* summary, const int* keys, int n, int key)
+{
+  int b = countBelowScalar(summary, SUMMARY_KEYS, key);
+  int len = (n - b*BLOCK_KEYS < BLOCK_KEYS) ? n - b*BLOCK_KEYS : BLOCK_KEYS;
+  return b*BLOCK_KEYS + countBelowScalar(keys + b*BLOCK_KEYS, len, key);
+}
+
+// # keys below key, given the block b and its compare mask
+static int blockCount(int n, int b, unsigned mask)
+{
+  int len = n - b*BLOCK_KEYS;
+  if(len < BLOCK_KEYS) mask &= (1u << len) - 1;
+  return b*BLOCK_KEYS + __builtin_popcount(mask);
+}
+
+#ifdef BTREE_SIMD
+__attribute__((target("sse2")))
+static int locateSse2(const int* summary, const int* keys, int n, int key)
+{
+  __m128i k = _mm_set1_epi32(key);
+  int b = 0;
+  for(int i = 0; i < SUMMARY_KEYS; i += 4){
+    __m128i v = _mm_loadu_si128((const __m128i *)(summary+i));
+    b += __builtin_popcount(_mm_movemask_ps(_mm_castsi128_ps(_mm_cmplt_epi32(v, k))));
+  }
+  const int* block = keys + b*BLOCK_KEYS;
+  unsigned mask = 0;
+  for(int i = 0; i < BLOCK_KEYS; i += 4){
+    __m128i v = _mm_loadu_si128((const __m128i *)(block+i));
+    mask |= _mm_movemask_ps(_mm_castsi128_ps(_mm_cmplt_epi32(v, k))) << i;
+  }
+  return blockCount(n, b, mask);
+}
+
+__attribute__((target("avx2")))
+static int locateAvx2(const int* summary, const int* keys, int n, int key)
+{
+  __m256i k = _mm256_set1_epi32(key);
+  __m256i s = _mm256_loadu_si256((const __m256i *)summary);
+  int b = __builtin_popcount(_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(k, s))));
+  const int* block = keys + b*BLOCK_KEYS;
+  __m256i v0 = _mm256_loadu_si256((const __m256i *)block);
+  __m256i v1 = _mm256_loadu_si256((const __m256i *)(block+8));
+  unsigned mask = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(k, v0))) |
+                  _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(k, v1))) << 8;
+  return blockCount(n, b, mask);
+}
+#endif
+
+static int (*const locateBelow)(const int*, const int*, int, int) =
+#ifdef BTREE_SIMD
+  (countBelow == countBelowAvx2) ? locateAvx2 : (countBelow == countBelowSse2) ? locateSse2 :
+#endif
+  locateScalar;
+
+int countKeysBelow(const int* keys, int n, int key)
+{
+  return countBelow(keys, n, key);
+}
+
+/*
+ * The entries of a leaf node are little-endian numbers of 1 to 8 bytes.
+ * A number is loaded with one 8-byte read, which may go past it, and
+ * the bytes that are not its own are masked off.
+ */
+static int byteWidth(unsigned long long v)
+{
+  int width = 1;
+  while(v >>= 8) width++;
+  return width;
+}
+
+static unsigned long long loadBytes(const char* p, int width)
+{
+  unsigned long long v;
+  memcpy(&v, p, sizeof(v));
+  return (width == 8) ? v : v & ((1ULL << (8*width)) - 1);
+}
+
+static void storeBytes(char* p, unsigned long long v, int width)
+{
+  memcpy(p, &v, width);
+}
+
+/*
+ * The search of the compressed keys of a leaf node: # of the n stored
+ * key differences at keys, width bytes each, that are smaller than
+ * delta. The differences are halved by a binary search as in
+ * narrowKeys(), down to one in the scalar kernel. The AVX2 kernel stops
+ * at SEARCH_WINDOW and compares those at their stored width, with the
+ * sign bit flipped so that they compare as signed, in one or two
+ * compares. Its loads may go past the window into the RecordIds or the
+ * unused part of the page, and the lanes behind the window are masked
+ * off. 3-byte differences have no lanes, and take the scalar kernel.
+ */
+static const char* narrowDeltas(const char* keys, int width, int& n, unsigned delta, int window)
+{
+  while(n > window){
+    int half = n/2;
+    keys = (loadBytes(keys + half*width, width) < delta) ? keys + half*width : keys;
+    n -= half;
+  }
+  return keys;
+}
+
+static int countDeltasScalar(const char* keys, int width, int n, unsigned delta)
+{
+  const char* base = narrowDeltas(keys, width, n, delta, 1);
+  return (base-keys)/width + (loadBytes(base, width) < delta);
+}
+
+#ifdef BTREE_SIMD
+__attribute__((target("avx2")))
+static int countDeltasAvx2(const char* keys, int width, int n, unsigned delta)
+{
+  if(width == 3) return countDeltasScalar(keys, width, n, delta);
+  if(delta > (unsigned)(~0ULL >> (64 - 8*width))) return n;
+  const char* base = narrowDeltas(keys, width, n, delta, SEARCH_WINDOW);
+  int count = (base-keys)/width;
+
+  if(width == 1){
+    __m128i flip = _mm_set1_epi8((char)0x80);
+    __m128i k = _mm_xor_si128(_mm_set1_epi8((char)delta), flip);
+    __m128i v = _mm_xor_si128(_mm_loadu_si128((const __m128i *)base), flip);
+    unsigned mask = _mm_movemask_epi8(_mm_cmpgt_epi8(k, v));
+    return count + __builtin_popcount(mask & ((1u << n) - 1));
+  }
+  if(width == 2){
+    __m256i flip = _mm256_set1_epi16((short)0x8000);
+    __m256i k = _mm256_xor_si256(_mm256_set1_epi16((short)delta), flip);
+    __m256i v = _mm256_xor_si256(_mm256_loadu_si256((const __m256i *)base), flip);
+    unsigned long long mask = (unsigned)_mm256_movemask_epi8(_mm256_cmpgt_epi16(k, v));
+    return count + __builtin_popcountll(mask & ((1ULL << (2*n)) - 1))/2;
+  }
+  __m256i flip = _mm256_set1_epi32((int)0x80000000u);
+  __m256i k = _mm256_xor_si256(_mm256_set1_epi32((int)delta), flip);
+  __m256i v0 = _mm256_xor_si256(_mm256_loadu_si256((const __m256i *)base), flip);
+  __m256i v1 = _mm256_xor_si256(_mm256_loadu_si256((const __m256i *)(base+32)), flip);
+  unsigned mask = _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(k, v0))) |
+                  _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(k, v1))) << 8;
+  return count + __builtin_popcount(mask & ((1u << n) - 1));
+}
+#endif
+
+static int (*const countDeltasBelow)(const char*, int, int, unsigned) =
+#ifdef BTREE_SIMD
+  (countBelow == countBelowAvx2) ? countDeltasAvx2 :
+#endif
+  countDeltasScalar;
+
+/*
+ * The bits of a leaf node. # set bits in bits 0 to i, and the position
+ * of set bit j (from 0), counted 64 bits at a time. The bits are read a
+ * word at a time, and the bits behind the last one are masked off.
+ */
+static unsigned long long loadWord(const unsigned char* bits, int w)
+{
+  unsigned long long v;
+  memcpy(&v, bits + 8*w, sizeof(v));
+  return v;
+}
+
+static int rankBit(const unsigned char* bits, int i)
+{
+  int rank = 0, w = 0;
+  for(; 64*(w+1) <= i; w++) rank += __builtin_popcountll(loadWord(bits, w));
+  int rest = i - 64*w + 1;
+  unsigned long long mask = (rest == 64) ? ~0ULL : (1ULL << rest) - 1;
+  return rank + __builtin_popcountll(loadWord(bits, w) & mask);
+}
+
+static int selectBit(const unsigned char* bits, int j)
+{
+  for(int w = 0; ; w++){
+    unsigned long long v = loadWord(bits, w);
+    int c = __builtin_popcountll(v);
+    if(j < c){
+      for(; j > 0; j--) v &= v-1;
+      return 64*w + __builtin_ctzll(v);
+    }
+    j -= c;
+  }
+}
+
+static bool testBit(const unsigned char* bits, int i)
+{
+  return (bits[i/8] >> (i%8)) & 1;
+}
+
+static void setBit(unsigned char* bits, int i)
+{
+  bits[i/8] |= 1 << (i%8);
+}
+
+/*
+ * the position of (key, rid) among n entries sorted by key and RecordId
+ */
+static int entryPosition(const int* keys, const RecordId* rids, int n, int key, const RecordId& rid)
+{
+  int eid = countKeysBelow(keys, n, key);
+  while(eid < n && keys[eid] == key && rids[eid] < rid) eid++;
+  return eid;
+}
+
 BTLeafNode::BTLeafNode()
 {
-  *(int *)buffer = 0;
+  memset(buffer, 0, sizeof(buffer));
+  keyBytes() = ridBytes() = 1;
   setNextNodePtr(-1);
+  setPrevNodePtr(-1);
 }
 /*
  * Read the content of the node from the page pid in the PageFile pf.
@@ -43,7 +339,97 @@ RC BTLeafNode::write(PageId pid, PageFile& pf)
  */
 int BTLeafNode::getKeyCount()
 { 
-  return *((int *)buffer); 
+  return count(); 
+}
+
+int BTLeafNode::keyAt(int eid)
+{
+  int kb = keyBytes();
+  const char* p = keyArea() + (rankBit(newKeyBits(), eid)-1)*kb;
+  return (int)((unsigned)firstKey() + (unsigned)loadBytes(p, kb));
+}
+
+RecordId BTLeafNode::ridAt(int eid)
+{
+  const char* p = ridArea() + eid*ridBytes();
+  unsigned long long v = loadBytes(p, ridBytes());
+  RecordId rid;
+  rid.pid = firstPid() + (PageId)(v / SID_RANGE);
+  rid.sid = (int)(v % SID_RANGE);
+  if(overflowCount() && testBit(overflowBits(), eid)) rid.sid = OVERFLOW_SID;
+  return rid;
+}
+
+void BTLeafNode::decode(int* keys, RecordId* rids)
+{
+  int n = count();
+  int kb = keyBytes(), rb = ridBytes();
+  unsigned base = firstKey();
+  PageId basePid = firstPid();
+  unsigned long long keyMask = (1ULL << (8*kb)) - 1;
+  unsigned long long ridMask = (1ULL << (8*rb)) - 1;
+  const unsigned char* newKey = newKeyBits();
+  const unsigned char* overflow = overflowCount() ? overflowBits() : NULL;
+  const char* kp = keyArea();
+  const char* rp = ridArea();
+
+  int key = 0;
+  for(int i = 0, j = 0; i < n; i++){
+    unsigned long long k, r;
+    if(testBit(newKey, i)){
+      memcpy(&k, kp + (j++)*kb, sizeof(k));
+      key = (int)(base + (unsigned)(k & keyMask));
+    }
+    memcpy(&r, rp + i*rb, sizeof(r));
+    keys[i] = key;
+    r &= ridMask;
+    rids[i].pid = basePid + (PageId)(r / SID_RANGE);
+    rids[i].sid = (overflow && testBit(overflow, i)) ? OVERFLOW_SID : (int)(r % SID_RANGE);
+  }
+}
+
+RC BTLeafNode::encode(const int* keys, const RecordId* rids, int n)
+{
+  if(n > MAXKEY_NUM) return RC_NODE_FULL;
+
+  // the keys are sorted, so the first is the smallest
+  int base = (n > 0) ? keys[0] : 0;
+  PageId minPid = (n > 0) ? rids[0].pid : 0, maxPid = minPid;
+  int keyCnt = (n > 0), overflowCnt = 0;
+  for(int i = 0; i < n; i++){
+    if(rids[i].pid < minPid) minPid = rids[i].pid;
+    if(rids[i].pid > maxPid) maxPid = rids[i].pid;
+    if(i > 0 && keys[i] != keys[i-1]) keyCnt++;
+    if(rids[i].sid == OVERFLOW_SID) overflowCnt++;
+  }
+  int kb = (n > 0) ? byteWidth((unsigned)keys[n-1] - (unsigned)base) : 1;
+  int rb = byteWidth((unsigned long long)(maxPid - minPid) * SID_RANGE + SID_RANGE - 1);
+  int bitBytes = (n+7)/8 * (overflowCnt ? 2 : 1);
+  if(HEADER_SIZE + bitBytes + keyCnt*kb + n*rb > PageFile::PAGE_SIZE) return RC_NODE_FULL;
+
+  count() = n;
+  firstKey() = base;
+  firstPid() = minPid;
+  keyBytes() = kb;
+  ridBytes() = rb;
+  keyCount() = keyCnt;
+  overflowCount() = overflowCnt;
+  memset(newKeyBits(), 0, bitBytes);
+  char* kp = keyArea();
+  char* rp = ridArea();
+  for(int i = 0, j = 0; i < n; i++){
+    if(i == 0 || keys[i] != keys[i-1]){
+      setBit(newKeyBits(), i);
+      storeBytes(kp + (j++)*kb, (unsigned)keys[i] - (unsigned)base, kb);
+    }
+    int sid = rids[i].sid;
+    if(sid == OVERFLOW_SID){
+      setBit(overflowBits(), i);
+      sid = 0;
+    }
+    storeBytes(rp + i*rb, (unsigned long long)(rids[i].pid - minPid) * SID_RANGE + sid, rb);
+  }
+  return 0;
 }
 
 /*
@@ -56,19 +442,16 @@ RC BTLeafNode::insert(int key, const RecordId& rid)
 { 
   int n = getKeyCount();
   if (n >= MAXKEY_NUM) return RC_NODE_FULL;
-  int eid;
-  locate(key, eid);
-  PageId pid = getNextNodePtr();
+  int keys[MAXKEY_NUM];
+  RecordId rids[MAXKEY_NUM];
+  decode(keys, rids);
 
-  for(int i = n; i > eid; i--){
-    memcpy(buffer+sizeof(int)+i*ENTRY_SIZE, buffer+sizeof(int)+(i-1)*ENTRY_SIZE, ENTRY_SIZE);
-  }
-
-  *(RecordId *)(buffer+sizeof(int)+eid*ENTRY_SIZE) = rid;
-  *(int *)(buffer+sizeof(int)+eid*ENTRY_SIZE+sizeof(RecordId)) = key;
-  (*(int *)(buffer))++;
-  setNextNodePtr(pid);
-  return 0; 
+  int eid = entryPosition(keys, rids, n, key, rid);
+  memmove(keys+eid+1, keys+eid, (n-eid)*sizeof(int));
+  memmove(rids+eid+1, rids+eid, (n-eid)*sizeof(RecordId));
+  keys[eid] = key;
+  rids[eid] = rid;
+  return encode(keys, rids, n+1);
 }
 
 /*
@@ -82,32 +465,59 @@ RC BTLeafNode::insert(int key, const RecordId& rid)
  * @return 0 if successful. Return an error code if there is an error.
  */
 RC BTLeafNode::insertAndSplit(int key, const RecordId& rid, 
-                              BTLeafNode& sibling, int& siblingKey)
+                              BTLeafNode& sibling, int& siblingKey, int leftPercent)
 { 
   int n = getKeyCount();
-  int eid;
-  locate(key, eid);
-
-  PageId pid = getNextNodePtr();
-  for(int i = n; i > eid; i--){
-    memcpy(buffer+sizeof(int)+i*ENTRY_SIZE, buffer+sizeof(int)+(i-1)*ENTRY_SIZE, ENTRY_SIZE);
-  }
-
-  *(RecordId *)(buffer+sizeof(int)+eid*ENTRY_SIZE) = rid;
-  *(int *) (buffer+sizeof(int)+eid*ENTRY_SIZE+sizeof(RecordId)) = key;
 
-  int left = (MAXKEY_NUM+1)/2;
-  int right = MAXKEY_NUM+1-left;
+  // the n+1 entries do not fit in the page, so they are put together aside
+  int allKeys[MAXKEY_NUM+1];
+  RecordId allRids[MAXKEY_NUM+1];
+  decode(allKeys, allRids);
+  int eid = entryPosition(allKeys, allRids, n, key, rid);
+  memmove(allKeys+eid+1, allKeys+eid, (n-eid)*sizeof(int));
+  memmove(allRids+eid+1, allRids+eid, (n-eid)*sizeof(RecordId));
+  allKeys[eid] = key;
+  allRids[eid] = rid;
 
-  *(int *)buffer = left;
-  *(int *)sibling.buffer = right;
+  // an uneven split keeps the entries in front of the new one, at least
+  // half. it may leave more entries on one side than fit in a page. each
+  // half fits however wide its entries are (see MAXKEY_NUM)
+  int left = (n+1)*leftPercent/100;
+  if(left > (n+1)/2 && eid < left) left = (eid > (n+1)/2) ? eid : (n+1)/2;
+  if(left < 1) left = 1;
+  if(left > n) left = n;
+  if(encode(allKeys, allRids, left) || sibling.encode(allKeys+left, allRids+left, n+1-left)){
+    left = (n+1)/2;
+    encode(allKeys, allRids, left);
+    sibling.encode(allKeys+left, allRids+left, n+1-left);
+  }
 
-  memcpy(sibling.buffer+sizeof(int), buffer+sizeof(int)+left*ENTRY_SIZE, right*ENTRY_SIZE);
-    sibling.setNextNodePtr(pid);
-    siblingKey = *(int *)(sibling.buffer+sizeof(int)+sizeof(RecordId));
+  sibling.setNextNodePtr(getNextNodePtr());
+  siblingKey = allKeys[left];
   return 0; 
 }
 
+/*
+ * Replace the entries of the node with the first entries of keys and
+ * rids, as many as fit.
+ * @param keys[IN] the keys, in order
+ * @param rids[IN] the RecordIds, in order for the same key
+ * @param n[IN] # entries in keys and rids. at least 1
+ * @return # entries put in the node
+ */
+int BTLeafNode::fill(const int* keys, const RecordId* rids, int n)
+{
+  // more entries are never narrower (see BTOverflowNode::fill())
+  int left = 1, right = (n < MAXKEY_NUM) ? n : MAXKEY_NUM;
+  while(left < right){
+    int mid = (left+right+1)/2;
+    if(encode(keys, rids, mid) == 0) left = mid;
+    else right = mid-1;
+  }
+  encode(keys, rids, left);
+  return left;
+}
+
 /**
  * If searchKey exists in the node, set eid to the index entry
  * with searchKey and return 0. If not, set eid to the index entry
@@ -121,12 +531,18 @@ RC BTLeafNode::insertAndSplit(int key, const RecordId& rid,
  */
 RC BTLeafNode::locate(int searchKey, int& eid)
 { 
-  int offset = sizeof(int)+sizeof(RecordId);
-  for(eid = 0; eid < getKeyCount(); eid++){
-    if(*(int *)(buffer+offset+eid*ENTRY_SIZE) >= searchKey)
-      break;
+  int n = getKeyCount();
+
+  // the stored differences of the keys are compared with the difference
+  // of searchKey. the first entry with the key found is the one that
+  // follows, which is the key itself if every entry has its own key
+  eid = 0;
+  if(n > 0 && searchKey > firstKey()){
+    int d = keyCount();
+    int j = countDeltasBelow(keyArea(), keyBytes(), d, (unsigned)searchKey - (unsigned)firstKey());
+    eid = (j == d) ? n : (d == n) ? j : selectBit(newKeyBits(), j);
   }
-  if(eid == getKeyCount())	return RC_NO_SUCH_RECORD;
+  if(eid == n)	return RC_NO_SUCH_RECORD;
   return 0; 
 }
 
@@ -139,18 +555,145 @@ RC BTLeafNode::locate(int searchKey, int& eid)
  */
 RC BTLeafNode::readEntry(int eid, int& key, RecordId& rid)
 { 
-  int offset = sizeof(int)+eid*ENTRY_SIZE;
-  rid = *(RecordId *)(buffer+offset);
-  key = *(int *)(buffer+offset+sizeof(RecordId));
+  rid = ridAt(eid);
+  key = keyAt(eid);
   return 0; 
 }
 
+/*
+ * Overwrite the (key, rid) pair in the eid entry.
+ * @param eid[IN] the entry number to write the (key, rid) pair to
+ * @param key[IN] the new key of the entry
+ * @param rid[IN] the new RecordId of the entry
+ * @return 0 if successful. RC_NODE_FULL if the entries no longer fit.
+ */
+RC BTLeafNode::writeEntry(int eid, int key, const RecordId& rid)
+{
+  int n = getKeyCount();
+  if (eid < 0 || eid >= n) return RC_INVALID_CURSOR;
+  int keys[MAXKEY_NUM];
+  RecordId rids[MAXKEY_NUM];
+  decode(keys, rids);
+  keys[eid] = key;
+  rids[eid] = rid;
+  return encode(keys, rids, n);
+}
+
+/*
+ * Remove the eid entry from the node.
+ * @param eid[IN] the entry number to remove
+ * @return 0 if successful. Return an error code if there is an error.
+ */
+RC BTLeafNode::remove(int eid)
+{
+  int n = getKeyCount();
+  if (eid < 0 || eid >= n) return RC_INVALID_CURSOR;
+  int keys[MAXKEY_NUM];
+  RecordId rids[MAXKEY_NUM];
+  decode(keys, rids);
+
+  memmove(keys+eid, keys+eid+1, (n-eid-1)*sizeof(int));
+  memmove(rids+eid, rids+eid+1, (n-eid-1)*sizeof(RecordId));
+  return encode(keys, rids, n-1);
+}
+
+/*
+ * Replace the entries with key by one overflow entry for the page pid.
+ * @param key[IN] the key of the entries
+ * @param pid[IN] the first overflow page of the key
+ * @param rids[OUT] the RecordIds of the entries, in order
+ * @param n[OUT] # RecordIds in rids
+ * @return 0 if successful. RC_NODE_FULL if the entries do not fit.
+ */
+RC BTLeafNode::moveToOverflow(int key, PageId pid, RecordId* rids, int& n)
+{
+  int total = getKeyCount();
+  int keys[MAXKEY_NUM];
+  RecordId all[MAXKEY_NUM];
+  decode(keys, all);
+
+  int first = countBelow(keys, total, key);
+  for(n = 0; first+n < total && keys[first+n] == key; n++) rids[n] = all[first+n];
+  if(n == 0) return RC_NO_SUCH_RECORD;
+  all[first].pid = pid;
+  all[first].sid = OVERFLOW_SID;
+  memmove(keys+first+1, keys+first+n, (total-first-n)*sizeof(int));
+  memmove(all+first+1, all+first+n, (total-first-n)*sizeof(RecordId));
+  return encode(keys, all, total-n+1);
+}
+
+/*
+ * Move all entries of the next sibling node to the end of this node.
+ * @param sibling[IN] the node behind this one
+ * @return 0 if successful. RC_NODE_FULL if the entries do not fit.
+ */
+RC BTLeafNode::merge(BTLeafNode& sibling)
+{
+  int n = getKeyCount(), m = sibling.getKeyCount();
+  if (n + m > MAXKEY_NUM) return RC_NODE_FULL;
+  int keys[MAXKEY_NUM];
+  RecordId rids[MAXKEY_NUM];
+  decode(keys, rids);
+  sibling.decode(keys+n, rids+n);
+
+  // encode() leaves the node as it is if the entries do not fit
+  if (encode(keys, rids, n+m)) return RC_NODE_FULL;
+  setNextNodePtr(sibling.getNextNodePtr());
+  return 0;
+}
+
+/*
+ * Split the entries of this node and its next sibling half and half.
+ * @param sibling[IN] the node behind this one
+ * @param siblingKey[OUT] the first key in the sibling node afterwards
+ * @return 0 if successful. Return an error code if there is an error.
+ */
+RC BTLeafNode::redistribute(BTLeafNode& sibling, int& siblingKey)
+{
+  int n = getKeyCount(), m = sibling.getKeyCount();
+  int allKeys[2*MAXKEY_NUM];
+  RecordId allRids[2*MAXKEY_NUM];
+  decode(allKeys, allRids);
+  sibling.decode(allKeys+n, allRids+n);
+
+  // the entries that move may widen the entries of the node they move
+  // to, so the split closest to half and half that fits is taken
+  int total = n+m, half = total/2;
+  int step = (n < half) ? -1 : 1;
+  for(int left = half; left != n; left += step){
+    BTLeafNode l, r;
+    if(left < 1 || total-left < 1) continue;
+    if(l.encode(allKeys, allRids, left) || r.encode(allKeys+left, allRids+left, total-left))
+      continue;
+    l.setNextNodePtr(getNextNodePtr());
+    l.setPrevNodePtr(getPrevNodePtr());
+    r.setNextNodePtr(sibling.getNextNodePtr());
+    r.setPrevNodePtr(sibling.getPrevNodePtr());
+    *this = l;
+    sibling = r;
+    break;
+  }
+  siblingKey = sibling.keyAt(0);
+  return 0;
+}
+
+/*
+ * Is the node less than half full, by its bytes and by its # entries?
+ * @return true if the node should be merged with or borrow from a sibling
+ */
+bool BTLeafNode::isUnderfull()
+{
+  int n = getKeyCount();
+  return (ridArea() + n*ridBytes()) - buffer < PageFile::PAGE_SIZE/2 &&
+         n < MAXKEY_NUM/2;
+}
+
 /*
  * Return the pid of the next slibling node.
  * @return the PageId of the next sibling node 
  */
 PageId BTLeafNode::getNextNodePtr()
-{ return *(PageId *)(buffer+sizeof(int)+getKeyCount()*ENTRY_SIZE); }
+{ return next(); }
 
 /*
  * Set the pid of the next slibling node.
@@ -159,10 +702,34 @@ PageId BTLeafNode::getNextNodePtr()
  */
 RC BTLeafNode::setNextNodePtr(PageId pid)
 { 
-  *(PageId *)(buffer+sizeof(int)+getKeyCount()*ENTRY_SIZE) = pid;
+  next() = pid;
+  return 0; 
+}
+
+/*
+ * Return the pid of the previous slibling node.
+ * @return the PageId of the previous sibling node 
+ */
+PageId BTLeafNode::getPrevNodePtr()
+{ return prev(); }
+
+/*
+ * Set the pid of the previous slibling node.
+ * @param pid[IN] the PageId of the previous sibling node 
+ * @return 0 if successful. Return an error code if there is an error.
+ */
+RC BTLeafNode::setPrevNodePtr(PageId pid)
+{ 
+  prev() = pid;
   return 0; 
 }
 
+BTNonLeafNode::BTNonLeafNode()
+{
+  *(int *)buffer = 0;
+  summaryBuilt() = 0;
+}
+
 /*
  * Read the content of the node from the page pid in the PageFile pf.
  * @param pid[IN] the PageId to read
@@ -186,6 +753,7 @@ RC BTNonLeafNode::read(PageId pid, const PageFile& pf)
  */
 RC BTNonLeafNode::write(PageId pid, PageFile& pf)
 { 
+  buildSummary();
   if(pf.write(pid, buffer)){
     fprintf(stderr, "cannot write into PageFile");
     return RC_FILE_WRITE_FAILED;
@@ -200,6 +768,106 @@ RC BTNonLeafNode::write(PageId pid, PageFile& pf)
 int BTNonLeafNode::getKeyCount()
 {	return *((int *)buffer); }
 
+/*
+ * Return the key in the eid entry.
+ * @param eid[IN] the entry number
+ * @return the key of the entry
+ */
+int BTNonLeafNode::getKey(int eid)
+{	return keys()[eid]; }
+
+/*
+ * Overwrite the key in the eid entry.
+ * @param eid[IN] the entry number
+ * @param key[IN] the new key of the entry
+ */
+void BTNonLeafNode::setKey(int eid, int key)
+{
+  keys()[eid] = key;
+  summaryBuilt() = 0;
+}
+
+/*
+ * Return the child-node pointer in the eid entry.
+ * @param eid[IN] the entry number
+ * @return the PageId of the child node
+ */
+PageId BTNonLeafNode::getChildPtr(int eid)
+{	return pids()[eid]; }
+
+/*
+ * Remove the key in the eid entry and the child-node pointer behind it.
+ * @param eid[IN] the entry number of the key to remove
+ * @return 0 if successful. Return an error code if there is an error.
+ */
+RC BTNonLeafNode::remove(int eid)
+{
+  int n = getKeyCount();
+  if (eid < 0 || eid >= n) return RC_INVALID_CURSOR;
+  memmove(keys()+eid, keys()+eid+1, (n-eid-1)*sizeof(int));
+  memmove(pids()+eid+1, pids()+eid+2, (n-eid-1)*sizeof(PageId));
+  (*(int *)(buffer))--;
+  summaryBuilt() = 0;
+  return 0;
+}
+
+/*
+ * Move midKey and all entries of the next sibling node to this node.
+ * @param midKey[IN] the key between the two nodes in their parent
+ * @param sibling[IN] the node behind this one
+ * @return 0 if successful. RC_NODE_FULL if the keys do not fit.
+ */
+RC BTNonLeafNode::merge(int midKey, BTNonLeafNode& sibling)
+{
+  int n = getKeyCount(), m = sibling.getKeyCount();
+  if (n+1+m > MAXKEY_NUM) return RC_NODE_FULL;
+  keys()[n] = midKey;
+  memcpy(keys()+n+1, sibling.keys(), m*sizeof(int));
+  memcpy(pids()+n+1, sibling.pids(), (m+1)*sizeof(PageId));
+  *(int *)buffer = n+1+m;
+  summaryBuilt() = 0;
+  return 0;
+}
+
+/*
+ * Split the keys of this node, midKey and the keys of the next sibling
+ * node half and half between the two nodes.
+ * @param midKey[IN/OUT] the key between the two nodes in their parent
+ * @param sibling[IN] the node behind this one
+ * @return 0 if successful. Return an error code if there is an error.
+ */
+RC BTNonLeafNode::redistribute(int& midKey, BTNonLeafNode& sibling)
+{
+  int n = getKeyCount(), m = sibling.getKeyCount();
+  int allKeys[2*MAXKEY_NUM+1];
+  PageId allPids[2*MAXKEY_NUM+2];
+  memcpy(allKeys, keys(), n*sizeof(int));
+  memcpy(allPids, pids(), (n+1)*sizeof(PageId));
+  allKeys[n] = midKey;
+  memcpy(allKeys+n+1, sibling.keys(), m*sizeof(int));
+  memcpy(allPids+n+1, sibling.pids(), (m+1)*sizeof(PageId));
+
+  // the middle key moves up to the parent, as in insertAndSplit()
+  int total = n+1+m;
+  int left = total/2, right = total-left-1;
+  *(int *)buffer = left;
+  *(int *)sibling.buffer = right;
+  summaryBuilt() = sibling.summaryBuilt() = 0;
+  memcpy(keys(), allKeys, left*sizeof(int));
+  memcpy(pids(), allPids, (left+1)*sizeof(PageId));
+  memcpy(sibling.keys(), allKeys+left+1, right*sizeof(int));
+  memcpy(sibling.pids(), allPids+left+1, (right+1)*sizeof(PageId));
+  midKey = allKeys[left];
+  return 0;
+}
+
+/*
+ * Is the node less than half full?
+ * @return true if the node should be merged with or borrow from a sibling
+ */
+bool BTNonLeafNode::isUnderfull()
+{	return getKeyCount() < MAXKEY_NUM/2; }
+
 
 /*
  * Insert a (key, pid) pair to the node.
@@ -209,21 +877,30 @@ int BTNonLeafNode::getKeyCount()
  */
 RC BTNonLeafNode::insert(int key, PageId pid)
 { 
+  //find out where to insert the (key, pid) pair: behind the keys <= key
+  int n = getKeyCount();
+  return insert((key == INT_MAX) ? n : countBelow(keys(), n, key+1), key, pid);
+}
+
+/*
+ * Insert a (key, pid) pair behind the child-node pointer in entry child.
+ * @param child[IN] the entry number of the child-node pointer that split
+ * @param key[IN] the key to insert
+ * @param pid[IN] the PageId to insert
+ * @return 0 if successful. Return an error code if the node is full.
+ */
+RC BTNonLeafNode::insert(int child, int key, PageId pid)
+{
   int n = getKeyCount();
   if (n >= MAXKEY_NUM) return RC_NODE_FULL;
-  //find out where to insert the (key, pid) pair
-  int eid = 0;
-  for (eid = 0; eid < n; eid++){
-    if ((*(int *)(buffer+sizeof(int)+sizeof(PageId)+eid*ENTRY_SIZE)) > key)
-      break;
-  }
+  int eid = child;
 
-  for(int i = n; i > eid; i--){
-    memcpy(buffer+sizeof(int)+sizeof(PageId)+i*ENTRY_SIZE, buffer+sizeof(int)+sizeof(PageId)+(i-1)*ENTRY_SIZE, ENTRY_SIZE);
-  }
-  *(PageId *)(buffer+sizeof(int)+sizeof(PageId)+sizeof(int)+eid*ENTRY_SIZE) = pid;
-  *(int *)(buffer+sizeof(int)+sizeof(PageId)+eid*ENTRY_SIZE) = key;
+  memmove(keys()+eid+1, keys()+eid, (n-eid)*sizeof(int));
+  memmove(pids()+eid+2, pids()+eid+1, (n-eid)*sizeof(PageId));
+  keys()[eid] = key;
+  pids()[eid+1] = pid;
   (*(int *)(buffer))++;
+  summaryBuilt() = 0;
   return 0; 
 }
 
@@ -237,28 +914,48 @@ RC BTNonLeafNode::insert(int key, PageId pid)
  * @param midKey[OUT] the key in the middle after the split. This key should be inserted to the parent node.
  * @return 0 if successful. Return an error code if there is an error.
  */
-RC BTNonLeafNode::insertAndSplit(int key, PageId pid, BTNonLeafNode& sibling, int& midKey)
+RC BTNonLeafNode::insertAndSplit(int key, PageId pid, BTNonLeafNode& sibling, int& midKey,
+                                 int leftPercent)
 { 
   int n = getKeyCount();
-  int eid = 0;
-  for (eid = 0; eid < n; eid++){
-    if ((*(int *)(buffer+sizeof(int)+sizeof(PageId)+eid*ENTRY_SIZE)) > key)
-      break;
-  }
-  for(int i = n; i > eid; i--){
-    memcpy(buffer+sizeof(int)+sizeof(PageId)+i*ENTRY_SIZE, buffer+sizeof(int)+sizeof(PageId)+(i-1)*ENTRY_SIZE, ENTRY_SIZE);
-  }
-  *(PageId *)(buffer+sizeof(int)+sizeof(PageId)+sizeof(int)+eid*ENTRY_SIZE) = pid;
-  *(int *) (buffer+sizeof(int)+sizeof(PageId)+eid*ENTRY_SIZE) = key;
+  return insertAndSplit((key == INT_MAX) ? n : countBelow(keys(), n, key+1),
+                        key, pid, sibling, midKey, leftPercent);
+}
+
+/*
+ * Insert the (key, pid) pair behind the child-node pointer in entry
+ * child, and split the node with sibling.
+ */
+RC BTNonLeafNode::insertAndSplit(int child, int key, PageId pid, BTNonLeafNode& sibling,
+                                 int& midKey, int leftPercent)
+{
+  int n = getKeyCount();
+  int eid = child;
 
-  int left = (MAXKEY_NUM+1)/2;
-  int right = MAXKEY_NUM-left;
+  // the n+1 keys do not fit in the page, so they are put together aside
+  int allKeys[MAXKEY_NUM+1];
+  PageId allPids[MAXKEY_NUM+2];
+  memcpy(allKeys, keys(), eid*sizeof(int));
+  memcpy(allPids, pids(), (eid+1)*sizeof(PageId));
+  allKeys[eid] = key;
+  allPids[eid+1] = pid;
+  memcpy(allKeys+eid+1, keys()+eid, (n-eid)*sizeof(int));
+  memcpy(allPids+eid+2, pids()+eid+1, (n-eid)*sizeof(PageId));
+
+  // the middle key moves up to the parent. the keys before it stay,
+  // and the keys behind it go to the sibling with their pointers
+  int left = (n+1)*leftPercent/100;
+  if(left > n) left = n;
+  int right = n-left;
 
   *(int *)buffer = left;
   *(int *)sibling.buffer = right;
-
-  memcpy(sibling.buffer+sizeof(int), buffer+sizeof(int)+(left+1)*ENTRY_SIZE, sizeof(PageId)+right*ENTRY_SIZE);
-  midKey = *(int *)(sibling.buffer+sizeof(int)+sizeof(PageId));
+  summaryBuilt() = sibling.summaryBuilt() = 0;
+  memcpy(keys(), allKeys, left*sizeof(int));
+  memcpy(pids(), allPids, (left+1)*sizeof(PageId));
+  memcpy(sibling.keys(), allKeys+left+1, right*sizeof(int));
+  memcpy(sibling.pids(), allPids+left+1, (right+1)*sizeof(PageId));
+  midKey = allKeys[left];
 
   return 0; 
 }
@@ -272,17 +969,27 @@ RC BTNonLeafNode::insertAndSplit(int key, PageId pid, BTNonLeafNode& sibling, in
  */
 RC BTNonLeafNode::locateChildPtr(int searchKey, PageId& pid)
 { 
-  int offset = sizeof(int) + sizeof(PageId);
-  int eid;
-  for (eid = 0; eid < getKeyCount(); eid++){
-    if ((*(int *)(buffer+offset+eid*ENTRY_SIZE)) > searchKey)
-      break;
-  }
-  pid = *(PageId *)(buffer+offset+eid*ENTRY_SIZE-sizeof(PageId));
-
+  pid = pids()[locateChild(searchKey)];
   return 0; 
 }
 
+/*
+ * Given the searchKey, find the entry number of the child-node pointer
+ * to follow.
+ * @param searchKey[IN] the searchKey that is being looked up.
+ * @return the entry number of the child-node pointer
+ */
+int BTNonLeafNode::locateChild(int searchKey)
+{
+  // follow the pointer behind the keys <= searchKey
+  int n = getKeyCount();
+  int eid;
+  if(searchKey == INT_MAX) eid = n;
+  else if(summaryBuilt() == 0) eid = countBelow(keys(), n, searchKey+1);
+  else eid = locateBelow(summary(), keys(), n, searchKey+1);
+  return eid;
+}
+
 /*
  * Initialize the root node with (pid1, key, pid2).
  * @param pid1[IN] the first PageId to insert
@@ -293,8 +1000,242 @@ RC BTNonLeafNode::locateChildPtr(int searchKey, PageId& pid)
 RC BTNonLeafNode::initializeRoot(PageId pid1, int key, PageId pid2)
 { 
   *(int *)buffer = 1;
-  *(PageId *)(buffer+sizeof(int)) = pid1;
-  *(int *)(buffer+sizeof(int)+sizeof(PageId)) = key;
-  *(PageId *)(buffer+sizeof(int)+ENTRY_SIZE) = pid2;
+  summaryBuilt() = 0;
+  pids()[0] = pid1;
+  keys()[0] = key;
+  pids()[1] = pid2;
   return 0; 
 }
+
+/*
+ * Build the summary of the keys: the first key of every block of
+ * BLOCK_KEYS keys but the first, and INT_MAX for the missing blocks.
+ */
+void BTNonLeafNode::buildSummary()
+{
+  int n = getKeyCount();
+  for(int b = 0; b < SUMMARY_KEYS; b++){
+    int i = (b+1)*BLOCK_KEYS;
+    summary()[b] = (i < n) ? keys()[i] : INT_MAX;
+  }
+  summaryBuilt() = 1;
+}
+
+BTOverflowNode::BTOverflowNode()
+{
+  memset(buffer, 0, sizeof(buffer));
+  ridBytes() = 1;
+  next() = prev() = last() = -1;
+}
+
+RC BTOverflowNode::read(PageId pid, const PageFile& pf)
+{
+  if(pf.read(pid, buffer)){
+    fprintf(stderr, "cannot read from PageFile\n");
+    return RC_FILE_READ_FAILED;
+  }
+  return 0;
+}
+
+RC BTOverflowNode::write(PageId pid, PageFile& pf)
+{
+  if(pf.write(pid, buffer)){
+    fprintf(stderr, "cannot write into PageFile");
+    return RC_FILE_WRITE_FAILED;
+  }
+  return 0;
+}
+
+int BTOverflowNode::getRidCount()
+{	return count(); }
+
+int BTOverflowNode::getKey()
+{	return key(); }
+
+PageId BTOverflowNode::getNextNodePtr()
+{	return next(); }
+
+void BTOverflowNode::setNextNodePtr(PageId pid)
+{	next() = pid; }
+
+PageId BTOverflowNode::getPrevNodePtr()
+{	return prev(); }
+
+void BTOverflowNode::setPrevNodePtr(PageId pid)
+{	prev() = pid; }
+
+PageId BTOverflowNode::getLastNodePtr()
+{	return last(); }
+
+void BTOverflowNode::setLastNodePtr(PageId pid)
+{	last() = pid; }
+
+RC BTOverflowNode::encode(const RecordId* rids, int n)
+{
+  // the RecordIds are sorted, so the pids of the first and the last
+  // are the smallest and the largest
+  PageId minPid = (n > 0) ? rids[0].pid : 0;
+  PageId maxPid = (n > 0) ? rids[n-1].pid : 0;
+  int rb = byteWidth((unsigned long long)(maxPid - minPid) * BTLeafNode::SID_RANGE + BTLeafNode::SID_RANGE - 1);
+  if(HEADER_SIZE + n*rb > PageFile::PAGE_SIZE) return RC_NODE_FULL;
+
+  count() = n;
+  firstPid() = minPid;
+  ridBytes() = rb;
+  char* p = buffer + HEADER_SIZE;
+  for(int i = 0; i < n; i++){
+    storeBytes(p + i*rb, (unsigned long long)(rids[i].pid - minPid) * BTLeafNode::SID_RANGE + rids[i].sid, rb);
+  }
+  return 0;
+}
+
+/*
+ * Decode all RecordIds of the page.
+ * @param rids[OUT] the RecordIds
+ * @return # RecordIds
+ */
+int BTOverflowNode::readAll(RecordId* rids)
+{
+  for(int i = 0; i < count(); i++) readEntry(i, rids[i]);
+  return count();
+}
+
+/*
+ * Read the RecordId in the eid entry.
+ * @param eid[IN] the entry number
+ * @param rid[OUT] the RecordId of the entry
+ * @return 0 if successful. Return an error code if there is an error.
+ */
+RC BTOverflowNode::readEntry(int eid, RecordId& rid)
+{
+  if(eid < 0 || eid >= count()) return RC_INVALID_CURSOR;
+  unsigned long long v = loadBytes(buffer + HEADER_SIZE + eid*ridBytes(), ridBytes());
+  rid.pid = firstPid() + (PageId)(v / BTLeafNode::SID_RANGE);
+  rid.sid = (int)(v % BTLeafNode::SID_RANGE);
+  return 0;
+}
+
+/*
+ * Find the first RecordId that is not smaller than rid.
+ * @param rid[IN] the RecordId to search for
+ * @param eid[OUT] the entry number of the RecordId
+ * @return 0 if rid is in the page. If not, RC_NO_SUCH_RECORD.
+ */
+RC BTOverflowNode::locate(const RecordId& rid, int& eid)
+{
+  RecordId r;
+  int left = 0, right = count();
+  while(left < right){
+    int mid = (left+right)/2;
+    readEntry(mid, r);
+    if(r < rid) left = mid+1;
+    else right = mid;
+  }
+  eid = left;
+  if(eid < count() && (readEntry(eid, r), r == rid)) return 0;
+  return RC_NO_SUCH_RECORD;
+}
+
+/*
+ * Insert a RecordId to the page, in order.
+ * @param rid[IN] the RecordId to insert
+ * @return 0 if successful. RC_NODE_FULL if the RecordIds do not fit.
+ */
+RC BTOverflowNode::insert(const RecordId& rid)
+{
+  int n = count(), eid;
+  if(n >= MAX_RIDS) return RC_NODE_FULL;
+  RecordId rids[MAX_RIDS];
+  readAll(rids);
+  locate(rid, eid);
+  memmove(rids+eid+1, rids+eid, (n-eid)*sizeof(RecordId));
+  rids[eid] = rid;
+  return encode(rids, n+1);
+}
+
+/*
+ * Insert a RecordId to the page and split the page with sibling.
+ * @param rid[IN] the RecordId to insert
+ * @param sibling[IN] the page behind this one. it MUST be empty
+ * @return 0 if successful. Return an error code if there is an error.
+ */
+RC BTOverflowNode::insertAndSplit(const RecordId& rid, BTOverflowNode& sibling)
+{
+  int n = count(), eid;
+  RecordId rids[MAX_RIDS+1];
+  readAll(rids);
+  locate(rid, eid);
+  memmove(rids+eid+1, rids+eid, (n-eid)*sizeof(RecordId));
+  rids[eid] = rid;
+
+  // only a RecordId in front of or behind all others makes the pids of a
+  // half wider, so it goes to a page alone. any other half fits
+  int left = (eid == n) ? n : (eid == 0) ? 1 : (n+1)/2;
+  encode(rids, left);
+  sibling.encode(rids+left, n+1-left);
+  sibling.key() = key();
+  sibling.next() = next();
+  sibling.last() = -1;
+  return 0;
+}
+
+/*
+ * Fill the page with the first RecordIds of rids, as many as fit.
+ * @param key[IN] the key of the RecordIds
+ * @param rids[IN] the RecordIds, in order
+ * @param n[IN] # RecordIds in rids
+ * @return # RecordIds put in the page
+ */
+int BTOverflowNode::fill(int key, const RecordId* rids, int n)
+{
+  // more RecordIds are never narrower, so the most that fit are found by
+  // a binary search
+  int left = 1, right = (n < MAX_RIDS) ? n : MAX_RIDS;
+  while(left < right){
+    int mid = (left+right+1)/2;
+    if(encode(rids, mid) == 0) left = mid;
+    else right = mid-1;
+  }
+  encode(rids, left);
+  this->key() = key;
+  return left;
+}
+
+/*
+ * Remove the eid entry from the page.
+ * @param eid[IN] the entry number to remove
+ * @return 0 if successful. Return an error code if there is an error.
+ */
+RC BTOverflowNode::remove(int eid)
+{
+  int n = count();
+  if(eid < 0 || eid >= n) return RC_INVALID_CURSOR;
+  RecordId rids[MAX_RIDS];
+  readAll(rids);
+  memmove(rids+eid, rids+eid+1, (n-eid-1)*sizeof(RecordId));
+  return encode(rids, n-1);
+}
+
+/*
+ * Move all RecordIds of the next page of the chain to this page.
+ * @param sibling[IN] the page behind this one
+ * @return 0 if successful. RC_NODE_FULL if the RecordIds do not fit.
+ */
+RC BTOverflowNode::merge(BTOverflowNode& sibling)
+{
+  int n = count(), m = sibling.count();
+  if(n + m > MAX_RIDS) return RC_NODE_FULL;
+  RecordId rids[MAX_RIDS];
+  readAll(rids);
+  sibling.readAll(rids+n);
+  if(encode(rids, n+m)) return RC_NODE_FULL;
+  next() = sibling.next();
+  return 0;
+}
+
+/*
+ * Is the page less than half full?
+ * @return true if the page should be merged with another one
+ */
+bool BTOverflowNode::isUnderfull()
+{	return HEADER_SIZE + count()*ridBytes() < PageFile::PAGE_SIZE/2; }
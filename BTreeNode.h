@@ -16,6 +16,30 @@
 
 /**
  * BTLeafNode: The class representing a B+tree leaf node.
+ * The entries of a leaf node are compressed posting lists: every key of
+ * the node is stored once, and the entries with the key follow in
+ * RecordId order. A key is stored as its difference from the first key
+ * of the node, and a RecordId as one number, (pid - the smallest pid of
+ * the node) * SID_RANGE + sid. All keys of a node take the same # bytes,
+ * the fewest that hold the largest difference, and so do all RecordIds,
+ * so entry i is found without decoding the entries before it, and
+ * locate() compares the stored differences of the keys as they are, with
+ * SIMD if the CPU has it:
+ *
+ *   [# entries][next pid][prev pid][first key][smallest pid][key bytes]
+ *   [rid bytes][# keys][# overflow entries]
+ *   [bit i: entry i has a new key][bit i: entry i is an overflow entry]
+ *   [key 0 ... key # keys-1][rid 0 ... rid n-1]
+ *
+ * The bits of the overflow entries are there only if the node has one.
+ * The RecordIds of a key with many entries are kept in BTOverflowNode
+ * pages instead, and the key has one overflow entry whose RecordId is
+ * (the first of those pages, OVERFLOW_SID).
+ *
+ * A node is full when its entries do not fit in the page, or when it has
+ * MAXKEY_NUM entries. The keys of a node are usually close to each other
+ * and so are the pids of their records, so a node holds two to three
+ * times the entries of an uncompressed one.
  */
 class BTLeafNode {
   public:
@@ -31,16 +55,32 @@ class BTLeafNode {
 
    /**
     * Insert the (key, rid) pair to the node
-    * and split the node half and half with sibling.
+    * and split the node with sibling, half and half by default.
     * The first key of the sibling node is returned in siblingKey.
     * Remember that all keys inside a B+tree node should be kept sorted.
     * @param key[IN] the key to insert.
     * @param rid[IN] the RecordId to insert.
     * @param sibling[IN] the sibling node to split with. This node MUST be EMPTY when this function is called.
     * @param siblingKey[OUT] the first key in the sibling node after split.
+    * @param leftPercent[IN] the most entries kept in this node, in percent.
+    *                        above half, the entries from the new one on go
+    *                        to the sibling, so a key inserted in the middle
+    *                        splits the node there. the node is split half
+    *                        and half if they do not fit
     * @return 0 if successful. Return an error code if there is an error.
     */
-    RC insertAndSplit(int key, const RecordId& rid, BTLeafNode& sibling, int& siblingKey);
+    RC insertAndSplit(int key, const RecordId& rid, BTLeafNode& sibling, int& siblingKey,
+                      int leftPercent = 50);
+
+   /**
+    * Replace the entries of the node with the first entries of keys and
+    * rids, as many as fit.
+    * @param keys[IN] the keys, in order
+    * @param rids[IN] the RecordIds, in order for the same key
+    * @param n[IN] # entries in keys and rids. at least 1
+    * @return # entries put in the node
+    */
+    int fill(const int* keys, const RecordId* rids, int n);
 
    /**
     * If searchKey exists in the node, set eid to the index entry
@@ -64,6 +104,64 @@ class BTLeafNode {
     */
     RC readEntry(int eid, int& key, RecordId& rid);
 
+   /**
+    * Overwrite the (key, rid) pair in the eid entry.
+    * The caller must keep the keys in the node sorted.
+    * @param eid[IN] the entry number to write the (key, rid) pair to
+    * @param key[IN] the new key of the entry
+    * @param rid[IN] the new RecordId of the entry
+    * @return 0 if successful. RC_NODE_FULL if the entries no longer fit
+    *         in the page; the node is not changed then.
+    */
+    RC writeEntry(int eid, int key, const RecordId& rid);
+
+   /**
+    * Remove the eid entry from the node.
+    * The entries behind it move one entry to the front.
+    * @param eid[IN] the entry number to remove
+    * @return 0 if successful. Return an error code if there is an error.
+    */
+    RC remove(int eid);
+
+   /**
+    * Replace the entries with key by one overflow entry, which points to
+    * the BTOverflowNode page pid.
+    * @param key[IN] the key of the entries
+    * @param pid[IN] the first overflow page of the key
+    * @param rids[OUT] the RecordIds of the entries, in order. there is
+    *                  room for MAXKEY_NUM of them
+    * @param n[OUT] # RecordIds in rids
+    * @return 0 if successful. RC_NODE_FULL if the entries no longer fit
+    *         in the page (the pid may be wider than the RecordIds); the
+    *         node is not changed then.
+    */
+    RC moveToOverflow(int key, PageId pid, RecordId* rids, int& n);
+
+   /**
+    * Move all entries of the next sibling node to the end of this node.
+    * The next node pointer of the sibling becomes that of this node.
+    * @param sibling[IN] the node behind this one
+    * @return 0 if successful. RC_NODE_FULL if the entries of both nodes
+    *         do not fit in one page; neither node is changed then.
+    */
+    RC merge(BTLeafNode& sibling);
+
+   /**
+    * Split the entries of this node and its next sibling node half and
+    * half between the two.
+    * @param sibling[IN] the node behind this one
+    * @param siblingKey[OUT] the first key in the sibling node afterwards
+    * @return 0 if successful. Return an error code if there is an error.
+    */
+    RC redistribute(BTLeafNode& sibling, int& siblingKey);
+
+   /**
+    * Is the node less than half full, both by its bytes and by its
+    * # entries?
+    * @return true if the node should be merged with or borrow from a sibling
+    */
+    bool isUnderfull();
+
    /**
     * Return the pid of the next slibling node.
     * @return the PageId of the next sibling node 
@@ -78,6 +176,19 @@ class BTLeafNode {
     */
     RC setNextNodePtr(PageId pid);
 
+   /**
+    * Return the pid of the previous sibling node.
+    * @return the PageId of the previous sibling node. -1 for the first node
+    */
+    PageId getPrevNodePtr();
+
+   /**
+    * Set the previous sibling node PageId.
+    * @param pid[IN] the PageId of the previous sibling node 
+    * @return 0 if successful. Return an error code if there is an error.
+    */
+    RC setPrevNodePtr(PageId pid);
+
    /**
     * Return the number of keys stored in the node.
     * @return the number of keys in the node
@@ -100,23 +211,81 @@ class BTLeafNode {
     */
     RC write(PageId pid, PageFile& pf);
 
-    static const int MAXKEY_NUM = (PageFile::PAGE_SIZE - sizeof(PageId))/(sizeof(RecordId)+sizeof(int)) - 1;
-    static const int ENTRY_SIZE = sizeof(RecordId)+sizeof(int);
+    // a RecordId is stored as (pid - smallest pid) * SID_RANGE + sid, so
+    // sid must be smaller than SID_RANGE
+    static const int SID_RANGE = 256;
+
+    // the sid that readEntry() returns for an overflow entry
+    static const int OVERFLOW_SID = -1;
+
+    // the most # bytes of a key and of a RecordId in a node
+    static const int MAX_KEY_BYTES = sizeof(int);
+    static const int MAX_RID_BYTES = sizeof(int) + 1;
+
+    static const int HEADER_SIZE = 5*sizeof(int) + 6;
+
+    // any half of MAXKEY_NUM+1 entries fits in a page, however wide and
+    // with both bits, so that a half and half insertAndSplit() always
+    // succeeds
+    static const int MAXKEY_NUM = 2*((PageFile::PAGE_SIZE - HEADER_SIZE - 2)*8/(8*(MAX_KEY_BYTES+MAX_RID_BYTES) + 2)) - 1;
 
   private:
    /**
     * The main memory buffer for loading the content of the disk page 
-    * that contains the node.
+    * that contains the node. The bytes behind the page let an entry be
+    * loaded with one 8-byte read.
     */
-    char buffer[PageFile::PAGE_SIZE];
+    char buffer[PageFile::PAGE_SIZE + sizeof(long long)];
+
+    int& count() { return *(int *)buffer; }
+    PageId& next() { return *(PageId *)(buffer+sizeof(int)); }
+    PageId& prev() { return *(PageId *)(buffer+2*sizeof(int)); }
+    int& firstKey() { return *(int *)(buffer+3*sizeof(int)); }
+    PageId& firstPid() { return *(PageId *)(buffer+4*sizeof(int)); }
+    unsigned char& keyBytes() { return *(unsigned char *)(buffer+5*sizeof(int)); }
+    unsigned char& ridBytes() { return *(unsigned char *)(buffer+5*sizeof(int)+1); }
+    unsigned short& keyCount() { return *(unsigned short *)(buffer+5*sizeof(int)+2); }
+    unsigned short& overflowCount() { return *(unsigned short *)(buffer+5*sizeof(int)+4); }
+
+    // the bits, the keys and the RecordIds in the page
+    unsigned char* newKeyBits() { return (unsigned char *)buffer + HEADER_SIZE; }
+    unsigned char* overflowBits() { return newKeyBits() + (count()+7)/8; }
+    char* keyArea() { return (char *)overflowBits() + (overflowCount() ? (count()+7)/8 : 0); }
+    char* ridArea() { return keyArea() + keyCount()*keyBytes(); }
+
+    // the stored key and RecordId of entry eid
+    int keyAt(int eid);
+    RecordId ridAt(int eid);
+
+    // decode all entries of the node into keys and rids
+    void decode(int* keys, RecordId* rids);
+
+    // replace the entries of the node with n entries. RC_NODE_FULL if
+    // they do not fit, and the node is not changed
+    RC encode(const int* keys, const RecordId* rids, int n);
 }; 
 
 
 /**
  * BTNonLeafNode: The class representing a B+tree nonleaf node.
+ * Like in a leaf node, the keys are kept apart from the child pointers.
+ * The keys start at a cache line, so every BLOCK_KEYS keys fill one
+ * cache line, and the first cache line of the page has the first key of
+ * every block after the first (the summary):
+ *
+ *   [# keys][# summary keys][summary keys]                  (one cache line)
+ *   [key 0 ... key MAXKEY_NUM-1][pid 0 ... pid MAXKEY_NUM]
+ *
+ * pid i points to the keys in [key i-1, key i). The summary is built by
+ * write(), and locateChildPtr() searches the summary line and then one
+ * block of keys: two cache lines per node, instead of one for every step
+ * of a binary search. With SIMD, each line takes one compare of all its
+ * keys, and there is no search loop.
  */
 class BTNonLeafNode {
   public:
+    BTNonLeafNode();
+
    /**
     * Insert a (key, pid) pair to the node.
     * Remember that all keys inside a B+tree node should be kept sorted.
@@ -126,9 +295,21 @@ class BTNonLeafNode {
     */
     RC insert(int key, PageId pid);
 
+   /**
+    * Insert a (key, pid) pair behind the child-node pointer in entry
+    * child, for the node that the split of that child made. Unlike
+    * insert(int, PageId), this keeps the nodes in order when key equals
+    * other keys of the node.
+    * @param child[IN] the entry number of the child-node pointer that split
+    * @param key[IN] the key to insert
+    * @param pid[IN] the PageId to insert
+    * @return 0 if successful. Return an error code if the node is full.
+    */
+    RC insert(int child, int key, PageId pid);
+
    /**
     * Insert the (key, pid) pair to the node
-    * and split the node half and half with sibling.
+    * and split the node with sibling, half and half by default.
     * The sibling node MUST be empty when this function is called.
     * The middle key after the split is returned in midKey.
     * Remember that all keys inside a B+tree node should be kept sorted.
@@ -136,9 +317,19 @@ class BTNonLeafNode {
     * @param pid[IN] the PageId to insert
     * @param sibling[IN] the sibling node to split with. This node MUST be empty when this function is called.
     * @param midKey[OUT] the key in the middle after the split. This key should be inserted to the parent node.
+    * @param leftPercent[IN] the percentage of the keys kept in this node
     * @return 0 if successful. Return an error code if there is an error.
     */
-    RC insertAndSplit(int key, PageId pid, BTNonLeafNode& sibling, int& midKey);
+    RC insertAndSplit(int key, PageId pid, BTNonLeafNode& sibling, int& midKey,
+                      int leftPercent = 50);
+
+   /**
+    * Insert the (key, pid) pair behind the child-node pointer in entry
+    * child, as insert(int, int, PageId) does, and split the node with
+    * sibling as insertAndSplit(int, PageId, ...) does.
+    */
+    RC insertAndSplit(int child, int key, PageId pid, BTNonLeafNode& sibling, int& midKey,
+                      int leftPercent = 50);
 
    /**
     * Given the searchKey, find the child-node pointer to follow and
@@ -150,6 +341,54 @@ class BTNonLeafNode {
     */
     RC locateChildPtr(int searchKey, PageId& pid);
 
+   /**
+    * Given the searchKey, find the entry number of the child-node
+    * pointer to follow, as locateChildPtr() does.
+    * @param searchKey[IN] the searchKey that is being looked up.
+    * @return the entry number of the child-node pointer, 0 to getKeyCount()
+    */
+    int locateChild(int searchKey);
+
+   /**
+    * Return the child-node pointer in the eid entry.
+    * @param eid[IN] the entry number, 0 to getKeyCount()
+    * @return the PageId of the child node
+    */
+    PageId getChildPtr(int eid);
+
+   /**
+    * Remove the key in the eid entry and the child-node pointer behind it.
+    * @param eid[IN] the entry number of the key to remove
+    * @return 0 if successful. Return an error code if there is an error.
+    */
+    RC remove(int eid);
+
+   /**
+    * Move midKey and all entries of the next sibling node to the end of
+    * this node.
+    * @param midKey[IN] the key between the two nodes in their parent
+    * @param sibling[IN] the node behind this one
+    * @return 0 if successful. RC_NODE_FULL if the keys do not fit in one
+    *         node; neither node is changed then.
+    */
+    RC merge(int midKey, BTNonLeafNode& sibling);
+
+   /**
+    * Split the keys of this node, midKey and the keys of the next
+    * sibling node half and half between the two nodes.
+    * @param midKey[IN/OUT] the key between the two nodes in their parent.
+    *                       the new key between them is returned
+    * @param sibling[IN] the node behind this one
+    * @return 0 if successful. Return an error code if there is an error.
+    */
+    RC redistribute(int& midKey, BTNonLeafNode& sibling);
+
+   /**
+    * Is the node less than half full?
+    * @return true if the node should be merged with or borrow from a sibling
+    */
+    bool isUnderfull();
+
    /**
     * Initialize the root node with (pid1, key, pid2).
     * @param pid1[IN] the first PageId to insert
@@ -165,6 +404,21 @@ class BTNonLeafNode {
     */
     int getKeyCount();
 
+   /**
+    * Return the key in the eid entry.
+    * @param eid[IN] the entry number, smaller than getKeyCount()
+    * @return the key of the entry
+    */
+    int getKey(int eid);
+
+   /**
+    * Overwrite the key in the eid entry.
+    * The caller must keep the keys in the node sorted.
+    * @param eid[IN] the entry number, smaller than getKeyCount()
+    * @param key[IN] the new key of the entry
+    */
+    void setKey(int eid, int key);
+
    /**
     * Read the content of the node from the page pid in the PageFile pf.
     * @param pid[IN] the PageId to read
@@ -181,15 +435,178 @@ class BTNonLeafNode {
     */
     RC write(PageId pid, PageFile& pf);
 
-    static const int MAXKEY_NUM = (PageFile::PAGE_SIZE - sizeof(PageId))/(sizeof(PageId)+sizeof(int)) - 1;
+    static const int CACHE_LINE = 64;
+    static const int BLOCK_KEYS = CACHE_LINE/sizeof(int);
+
+    // # summary keys searched. the unused ones are INT_MAX
+    static const int SUMMARY_KEYS = 8;
+
+    static const int MAXKEY_NUM = (PageFile::PAGE_SIZE - CACHE_LINE - sizeof(PageId))/(sizeof(PageId)+sizeof(int));
     static const int ENTRY_SIZE = sizeof(PageId)+sizeof(int);
 
+    // the offsets of the summary, the keys and the child pointers in the page
+    static const int SUMMARY_OFFSET = 2*sizeof(int);
+    static const int KEY_OFFSET = CACHE_LINE;
+    static const int PID_OFFSET = KEY_OFFSET + MAXKEY_NUM*sizeof(int);
+
   private:
    /**
     * The main memory buffer for loading the content of the disk page 
-    * that contains the node.
+    * that contains the node. It is aligned to a cache line.
     */
-    char buffer[PageFile::PAGE_SIZE];
+    char buffer[PageFile::PAGE_SIZE] __attribute__((aligned(CACHE_LINE)));
+
+    int* keys() { return (int *)(buffer+KEY_OFFSET); }
+    PageId* pids() { return (PageId *)(buffer+PID_OFFSET); }
+
+    // is the summary up to date? (0 if the keys changed since it was built)
+    int& summaryBuilt() { return *(int *)(buffer+sizeof(int)); }
+    int* summary() { return (int *)(buffer+SUMMARY_OFFSET); }
+
+    // build the summary of the keys
+    void buildSummary();
 }; 
 
+/**
+ * BTOverflowNode: a page of the RecordIds of one key that has too many
+ * entries for a leaf node (see BTLeafNode). The pages of a key are
+ * chained from the first one, and their RecordIds are in order over the
+ * chain. They are compressed like the RecordIds of a leaf node:
+ *
+ *   [# rids][next pid][prev pid][last pid][key][smallest pid][rid bytes]
+ *   [rid 0 ... rid n-1]
+ *
+ * The last pid, the last page of the chain, is kept up to date only in
+ * the first page. The prev pid lets the chain be read backward from it.
+ * RecordIds are usually added behind the last one, and they go straight
+ * to the last page.
+ */
+class BTOverflowNode {
+  public:
+    BTOverflowNode();
+
+   /**
+    * Insert a RecordId to the page, in order.
+    * @param rid[IN] the RecordId to insert
+    * @return 0 if successful. RC_NODE_FULL if the RecordIds do not fit.
+    */
+    RC insert(const RecordId& rid);
+
+   /**
+    * Insert a RecordId to the page and split the page with sibling. A
+    * RecordId behind all others goes to the sibling alone, so that
+    * RecordIds added in order fill the pages. Otherwise the page is split
+    * half and half.
+    * @param rid[IN] the RecordId to insert
+    * @param sibling[IN] the page behind this one. it MUST be empty
+    * @return 0 if successful. Return an error code if there is an error.
+    */
+    RC insertAndSplit(const RecordId& rid, BTOverflowNode& sibling);
+
+   /**
+    * Fill the page with the first RecordIds of rids, as many as fit.
+    * @param key[IN] the key of the RecordIds
+    * @param rids[IN] the RecordIds, in order
+    * @param n[IN] # RecordIds in rids
+    * @return # RecordIds put in the page
+    */
+    int fill(int key, const RecordId* rids, int n);
+
+   /**
+    * Find the first RecordId that is not smaller than rid.
+    * @param rid[IN] the RecordId to search for
+    * @param eid[OUT] the entry number of the RecordId
+    * @return 0 if rid is in the page. If not, RC_NO_SUCH_RECORD.
+    */
+    RC locate(const RecordId& rid, int& eid);
+
+   /**
+    * Read the RecordId in the eid entry.
+    * @param eid[IN] the entry number
+    * @param rid[OUT] the RecordId of the entry
+    * @return 0 if successful. Return an error code if there is an error.
+    */
+    RC readEntry(int eid, RecordId& rid);
+
+   /**
+    * Remove the eid entry from the page.
+    * @param eid[IN] the entry number to remove
+    * @return 0 if successful. Return an error code if there is an error.
+    */
+    RC remove(int eid);
+
+   /**
+    * Move all RecordIds of the next page of the chain to the end of this
+    * page. The next page of sibling becomes that of this page.
+    * @param sibling[IN] the page behind this one
+    * @return 0 if successful. RC_NODE_FULL if the RecordIds do not fit
+    *         in one page; neither page is changed then.
+    */
+    RC merge(BTOverflowNode& sibling);
+
+   /**
+    * Is the page less than half full?
+    * @return true if the page should be merged with another one
+    */
+    bool isUnderfull();
+
+   /**
+    * Decode all RecordIds of the page.
+    * @param rids[OUT] the RecordIds. there is room for MAX_RIDS of them
+    * @return # RecordIds
+    */
+    int readAll(RecordId* rids);
+
+    // # RecordIds in the page, and their key
+    int getRidCount();
+    int getKey();
+
+    // the next page of the chain, -1 for the last page
+    PageId getNextNodePtr();
+    void setNextNodePtr(PageId pid);
+
+    // the previous page of the chain, -1 for the first page
+    PageId getPrevNodePtr();
+    void setPrevNodePtr(PageId pid);
+
+    // the last page of the chain. up to date only in the first page
+    PageId getLastNodePtr();
+    void setLastNodePtr(PageId pid);
+
+    // read the page pid from, or write it to, pf
+    RC read(PageId pid, const PageFile& pf);
+    RC write(PageId pid, PageFile& pf);
+
+    static const int HEADER_SIZE = 6*sizeof(int) + 1;
+
+    // the most RecordIds in a page, one byte each
+    static const int MAX_RIDS = PageFile::PAGE_SIZE - HEADER_SIZE;
+
+  private:
+    // the page, and the bytes behind it for 8-byte reads (see BTLeafNode)
+    char buffer[PageFile::PAGE_SIZE + sizeof(long long)];
+
+    int& count() { return *(int *)buffer; }
+    PageId& next() { return *(PageId *)(buffer+sizeof(int)); }
+    PageId& prev() { return *(PageId *)(buffer+2*sizeof(int)); }
+    PageId& last() { return *(PageId *)(buffer+3*sizeof(int)); }
+    int& key() { return *(int *)(buffer+4*sizeof(int)); }
+    PageId& firstPid() { return *(PageId *)(buffer+5*sizeof(int)); }
+    unsigned char& ridBytes() { return *(unsigned char *)(buffer+6*sizeof(int)); }
+
+    // replace the RecordIds of the page with n RecordIds in order.
+    // RC_NODE_FULL if they do not fit, and the page is not changed
+    RC encode(const RecordId* rids, int n);
+};
+
+/**
+ * @param keys[IN] keys in increasing order
+ * @param n[IN] # keys
+ * @param key[IN] the key to compare with
+ * @return # keys smaller than key. the keys are compared with AVX2 or
+ *         SSE2 if the CPU has them, or with a branchless loop otherwise
+ *         (or if the environment variable BRUINBASE_SIMD is 0)
+ */
+int countKeysBelow(const int* keys, int n, int key);
+
 #endif /* BTREENODE_H */
@@ -0,0 +1,126 @@
+#include <cstring>
+#include "Bruinbase.h"
+#include "BloomFilter.h"
+
+using std::string;
+
+// # bytes of a filter
+static const int FILTER_SIZE = BloomFilter::FILTER_BITS / 8;
+
+BloomFilter::BloomFilter()
+{
+  dirty = false;
+}
+
+void BloomFilter::clear()
+{
+  // the filter file is cut down to the groups added again on save()
+  bits.clear();
+  changed.clear();
+  dirty = true;
+}
+
+void BloomFilter::add(PageId pid, const char* value, int len)
+{
+  unsigned h1, h2;
+  unsigned group = pid / GROUP_PAGES;
+
+  // make room for the filter of a new page group
+  if (group >= changed.size()) {
+    bits.resize((group + 1) * FILTER_SIZE, 0);
+    changed.resize(group + 1, true);
+  }
+
+  char* filter = &bits[group * FILTER_SIZE];
+  hash(value, len, h1, h2);
+  for (int i = 0; i < HASH_COUNT; i++) {
+    unsigned bit = (h1 + i * h2) % FILTER_BITS;
+    filter[bit / 8] |= (char)(1 << (bit % 8));
+  }
+  changed[group] = true;
+  dirty = true;
+}
+
+bool BloomFilter::mayContain(PageId pid, const string& value) const
+{
+  unsigned h1, h2;
+  unsigned group = pid / GROUP_PAGES;
+
+  // a page group without a filter has no values yet
+  if (group >= changed.size()) return false;
+
+  const char* filter = &bits[group * FILTER_SIZE];
+  hash(value.data(), value.size(), h1, h2);
+  for (int i = 0; i < HASH_COUNT; i++) {
+    unsigned bit = (h1 + i * h2) % FILTER_BITS;
+    if ((filter[bit / 8] & (1 << (bit % 8))) == 0) return false;
+  }
+  return true;
+}
+
+RC BloomFilter::load(const string& filename)
+{
+  RC       rc;
+  PageFile pf;
+
+  bits.clear();
+  changed.clear();
+  dirty = false;
+  if ((rc = pf.open(filename, 'r')) < 0) return rc;
+
+  // page g of the file is the filter of page group g
+  bits.resize(pf.endPid() * FILTER_SIZE);
+  changed.resize(pf.endPid(), false);
+  for (PageId pid = 0; pid < pf.endPid(); pid++) {
+    if ((rc = pf.read(pid, &bits[pid * FILTER_SIZE])) < 0) {
+      bits.clear();
+      changed.clear();
+      pf.close();
+      return rc;
+    }
+  }
+
+  return pf.close();
+}
+
+RC BloomFilter::save(const string& filename)
+{
+  RC       rc;
+  PageFile pf;
+
+  if ((rc = pf.open(filename, 'w')) < 0) return rc;
+
+  // write the changed filters, and drop the filters of page groups
+  // that no longer exist (after the table is vacuumed)
+  for (unsigned group = 0; group < changed.size(); group++) {
+    if (!changed[group]) continue;
+    if ((rc = pf.write(group, &bits[group * FILTER_SIZE])) < 0) {
+      pf.close();
+      return rc;
+    }
+    changed[group] = false;
+  }
+  if (pf.endPid() > (PageId)changed.size() && (rc = pf.truncate(changed.size())) < 0) {
+    pf.close();
+    return rc;
+  }
+
+  dirty = false;
+  return pf.close();
+}
+
+void BloomFilter::hash(const char* value, int len, unsigned& h1, unsigned& h2)
+{
+  unsigned h = 2166136261u;
+  for (int i = 0; i < len; i++) {
+    h ^= (unsigned char) value[i];
+    h *= 16777619u;
+  }
+  h1 = h;
+
+  // the second hash must be odd so that the HASH_COUNT bits differ
+  h ^= h >> 15;
+  h *= 0x2c1b3c6dU;
+  h ^= h >> 12;
+  h2 = h | 1;
+}
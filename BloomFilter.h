@@ -0,0 +1,90 @@
+#ifndef BLOOMFILTER_H
+#define BLOOMFILTER_H
+
+#include <string>
+#include <vector>
+#include "Bruinbase.h"
+#include "PageFile.h"
+
+/**
+ * Bloom filters of the values of a table, one for every group of
+ * GROUP_PAGES pages of the table. A filter tells for sure that a value
+ * is not in its page group, so a scan for "value = constant" can skip
+ * the group without reading it.
+ *
+ * The filter of a group is FILTER_BITS bits, exactly one page of the
+ * filter file: page g of the file is the filter of page group g.
+ * A value sets HASH_COUNT bits of the filter of its group, picked by
+ * double hashing.
+ */
+class BloomFilter {
+ public:
+
+  // # table pages covered by one filter
+  static const int GROUP_PAGES = 32;
+
+  // # bits of a filter (one page of the filter file)
+  static const int FILTER_BITS = PageFile::PAGE_SIZE * 8;
+
+  // # bits set by a value
+  static const int HASH_COUNT = 4;
+
+  BloomFilter();
+
+  /**
+   * remove all filters, to add the values of the table again.
+   */
+  void clear();
+
+  /**
+   * add a value of a record in page pid of the table.
+   * @param pid[IN] the page of the record
+   * @param value[IN] the first byte of the value
+   * @param len[IN] # bytes of the value
+   */
+  void add(PageId pid, const char* value, int len);
+
+  /**
+   * @param pid[IN] a page of the table
+   * @param value[IN] the value to look for
+   * @return false if no record in the page group of pid has the value.
+   *         true if some record may have it
+   */
+  bool mayContain(PageId pid, const std::string& value) const;
+
+  /**
+   * read the filters from a file.
+   * @param filename[IN] the name of the filter file
+   * @return error code. 0 if no error
+   */
+  RC load(const std::string& filename);
+
+  /**
+   * write the filters changed since the last load() or save() to a file.
+   * @param filename[IN] the name of the filter file
+   * @return error code. 0 if no error
+   */
+  RC save(const std::string& filename);
+
+  /**
+   * @return true if some filter was changed since the last load() or save()
+   */
+  bool isDirty() const { return dirty; }
+
+  /**
+   * the two hashes of a value (FNV-1a and a remix of it) that are
+   * combined into the HASH_COUNT bit positions.
+   * @param value[IN] the first byte of the value
+   * @param len[IN] # bytes of the value
+   * @param h1[OUT] the first hash
+   * @param h2[OUT] the second hash, always odd
+   */
+  static void hash(const char* value, int len, unsigned& h1, unsigned& h2);
+
+ private:
+  std::vector<char> bits;    // the filters, FILTER_BITS/8 bytes each
+  std::vector<bool> changed; // the filters changed since the last save
+  bool dirty;                // is any filter changed?
+};
+
+#endif // BLOOMFILTER_H
@@ -0,0 +1,161 @@
+#include <algorithm>
+#include <cstring>
+#include "Bruinbase.h"
+#include "Dictionary.h"
+
+using std::string;
+using std::vector;
+
+//
+// The dictionary file consists of a header page followed by data pages.
+// The header page stores # values in the dictionary. A data page stores
+// # entries in the page followed by the entries. Each entry is
+//   (length of the prefix shared with the previous value: 1 byte,
+//    length of the suffix: 1 byte, the suffix).
+// Front coding restarts at every page, so a page can be decoded alone.
+//
+
+// the size of the fixed part of an entry
+static const int ENTRY_HEADER_SIZE = 2;
+
+// the length of the common prefix of two strings (at most 255)
+static int commonPrefix(const string& s1, const string& s2);
+
+Dictionary::Dictionary()
+{
+}
+
+void Dictionary::build(const vector<string>& v)
+{
+  values = v;
+  std::sort(values.begin(), values.end());
+  values.erase(std::unique(values.begin(), values.end()), values.end());
+}
+
+RC Dictionary::load(const string& filename)
+{
+  RC       rc;
+  PageFile pf;
+  char     page[PageFile::PAGE_SIZE];
+  int      total, n;
+
+  values.clear();
+  if ((rc = pf.open(filename, 'r')) < 0) return rc;
+
+  // the header page contains # values in the dictionary
+  if ((rc = pf.read(0, page)) < 0) {
+    pf.close();
+    return rc;
+  }
+  memcpy(&total, page, sizeof(int));
+  values.reserve(total);
+
+  // decode the data pages until all values are read
+  for (PageId pid = 1; (int)values.size() < total; pid++) {
+    if ((rc = pf.read(pid, page)) < 0) {
+      values.clear();
+      pf.close();
+      return rc;
+    }
+    memcpy(&n, page, sizeof(int));
+
+    char* ptr = page + sizeof(int);
+    string prev;
+    for (int i = 0; i < n; i++) {
+      unsigned char prefix = ptr[0];
+      unsigned char suffix = ptr[1];
+      prev.erase(prefix);
+      prev.append(ptr + ENTRY_HEADER_SIZE, suffix);
+      values.push_back(prev);
+      ptr += ENTRY_HEADER_SIZE + suffix;
+    }
+  }
+
+  pf.close();
+  return 0;
+}
+
+RC Dictionary::save(const string& filename) const
+{
+  RC       rc;
+  PageFile pf;
+  char     page[PageFile::PAGE_SIZE];
+  PageId   pid = 1;
+  int      n = 0;
+  char*    ptr = page + sizeof(int);
+
+  if ((rc = pf.open(filename, 'w')) < 0) return rc;
+
+  // write the header page
+  int total = values.size();
+  memset(page, 0, PageFile::PAGE_SIZE);
+  memcpy(page, &total, sizeof(int));
+  if ((rc = pf.write(0, page)) < 0) {
+    pf.close();
+    return rc;
+  }
+
+  memset(page, 0, PageFile::PAGE_SIZE);
+  for (unsigned i = 0; i < values.size(); i++) {
+    // the first entry of a page shares nothing with the previous value
+    int prefix = (n == 0) ? 0 : commonPrefix(values[i-1], values[i]);
+    int suffix = values[i].size() - prefix;
+
+    if (ptr + ENTRY_HEADER_SIZE + suffix > page + PageFile::PAGE_SIZE) {
+      // the page is full. write it and start over with the full value
+      memcpy(page, &n, sizeof(int));
+      if ((rc = pf.write(pid++, page)) < 0) {
+        pf.close();
+        return rc;
+      }
+      memset(page, 0, PageFile::PAGE_SIZE);
+      ptr = page + sizeof(int);
+      n = 0;
+      prefix = 0;
+      suffix = values[i].size();
+    }
+
+    ptr[0] = (unsigned char) prefix;
+    ptr[1] = (unsigned char) suffix;
+    memcpy(ptr + ENTRY_HEADER_SIZE, values[i].data() + prefix, suffix);
+    ptr += ENTRY_HEADER_SIZE + suffix;
+    n++;
+  }
+
+  // write the last page
+  if (n > 0) {
+    memcpy(page, &n, sizeof(int));
+    if ((rc = pf.write(pid, page)) < 0) {
+      pf.close();
+      return rc;
+    }
+  }
+
+  return pf.close();
+}
+
+int Dictionary::encode(const string& value) const
+{
+  int code = lowerBound(value);
+  if (code < size() && values[code] == value) return code;
+  return -1;
+}
+
+int Dictionary::lowerBound(const string& value) const
+{
+  return std::lower_bound(values.begin(), values.end(), value) - values.begin();
+}
+
+int Dictionary::upperBound(const string& value) const
+{
+  return std::upper_bound(values.begin(), values.end(), value) - values.begin();
+}
+
+static int commonPrefix(const string& s1, const string& s2)
+{
+  int n = 0;
+  while (n < 255 && n < (int)s1.size() && n < (int)s2.size() && s1[n] == s2[n]) {
+    n++;
+  }
+  return n;
+}
@@ -0,0 +1,76 @@
+#ifndef DICTIONARY_H
+#define DICTIONARY_H
+
+#include <string>
+#include <vector>
+#include "Bruinbase.h"
+#include "PageFile.h"
+
+/**
+ * An order-preserving dictionary of the values of a table.
+ * The distinct values are kept sorted and the code of a value is its
+ * rank, so comparing two codes gives the same answer as comparing the
+ * two values with strcmp().
+ *
+ * On disk, the values are front-coded page by page: every entry stores
+ * the length of the prefix it shares with the previous value and the
+ * remaining suffix. The first entry of a page is stored in full.
+ */
+class Dictionary {
+ public:
+
+  Dictionary();
+
+  /**
+   * build the dictionary from a list of values.
+   * duplicates are removed and the values are sorted.
+   * @param values[IN] the values to put in the dictionary
+   */
+  void build(const std::vector<std::string>& values);
+
+  /**
+   * read the dictionary from a file.
+   * @param filename[IN] the name of the dictionary file
+   * @return error code. 0 if no error
+   */
+  RC load(const std::string& filename);
+
+  /**
+   * write the dictionary to a file.
+   * @param filename[IN] the name of the dictionary file
+   * @return error code. 0 if no error
+   */
+  RC save(const std::string& filename) const;
+
+  /**
+   * @return # values in the dictionary
+   */
+  int size() const { return (int)values.size(); }
+
+  /**
+   * @param value[IN] the value to look up
+   * @return the code of the value. -1 if the value is not in the dictionary
+   */
+  int encode(const std::string& value) const;
+
+  /**
+   * @param code[IN] the code to look up (0 <= code < size())
+   * @return the value with the code
+   */
+  const std::string& decode(int code) const { return values[code]; }
+
+  /**
+   * @return the smallest code whose value is >= value (size() if none)
+   */
+  int lowerBound(const std::string& value) const;
+
+  /**
+   * @return the smallest code whose value is > value (size() if none)
+   */
+  int upperBound(const std::string& value) const;
+
+ private:
+  std::vector<std::string> values;  // the distinct values, sorted
+};
+
+#endif // DICTIONARY_H
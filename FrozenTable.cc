@@ -0,0 +1,238 @@
+#include <algorithm>
+#include <cstdio>
+#include "Bruinbase.h"
+#include "BloomFilter.h"
+#include "FrozenTable.h"
+
+using std::pair;
+using std::string;
+using std::vector;
+
+// # ints in the header of a frozen file
+static const int HEADER_INTS = 5;
+
+int FrozenTable::blockReadCount = 0;
+pthread_mutex_t FrozenTable::lock = PTHREAD_MUTEX_INITIALIZER;
+
+// append a variable-length integer: 7 bits a byte, the lowest first,
+// with the high bit set on all bytes but the last
+static void putVarint(string& out, unsigned v)
+{
+  while (v >= 0x80) {
+    out += (char)(v | 0x80);
+    v >>= 7;
+  }
+  out += (char)v;
+}
+
+// read a variable-length integer written by putVarint()
+static bool getVarint(const char*& p, const char* end, unsigned& v)
+{
+  v = 0;
+  for (int shift = 0; p < end && shift < 32; shift += 7) {
+    unsigned char c = *p++;
+    v |= (unsigned)(c & 0x7f) << shift;
+    if ((c & 0x80) == 0) return true;
+  }
+  return false;
+}
+
+FrozenTable::FrozenTable()
+{
+  count = blocks = filterSize = 0;
+  firstKeys = offsets = firstRows = NULL;
+  filters = NULL;
+}
+
+MappedFile* FrozenTable::create()
+{
+  return new FrozenTable;
+}
+
+RC FrozenTable::get(const string& filename, const FrozenTable*& table)
+{
+  const MappedFile* file;
+  RC rc;
+
+  if ((rc = MappedFile::get(filename, create, file)) < 0) return rc;
+  table = static_cast<const FrozenTable*>(file);
+  return 0;
+}
+
+RC FrozenTable::parse()
+{
+  if (length < (long long)(HEADER_INTS * sizeof(int))) return RC_INVALID_FILE_FORMAT;
+
+  // the index and the filters are used right where they are in the file
+  const int* header = (const int*) base;
+  count = header[1];
+  blocks = header[2];
+  filterSize = header[3];
+  long long indexOffset = header[4];
+  if (header[0] != FROZEN_MAGIC || count < 0 || blocks < 0 || filterSize < 0 ||
+      indexOffset % (long long)sizeof(int) != 0 ||
+      indexOffset + (3 * (long long)blocks + 2) * (long long)sizeof(int) +
+      (long long)blocks * filterSize != length) {
+    return RC_INVALID_FILE_FORMAT;
+  }
+  firstKeys = (const int*)(base + indexOffset);
+  offsets = firstKeys + blocks;
+  firstRows = offsets + blocks + 1;
+  filters = (const char*)(firstRows + blocks + 1);
+  return 0;
+}
+
+RC FrozenTable::write(const string& filename, vector<pair<int, string> >& rows, bool bloom)
+{
+  FILE*       fp;
+  int         header[HEADER_INTS];
+  vector<int> keys, offsets, starts;
+  string      block, filters;
+  int         offset = HEADER_INTS * sizeof(int);
+  RC          rc;
+
+  if ((rc = beginWrite(filename, rows, fp)) < 0) return rc;
+  fseek(fp, offset, SEEK_SET);
+
+  // a block takes tuples as long as they fit in BLOCK_SIZE bytes.
+  // it takes at least one, however large
+  unsigned i = 0;
+  while (i < rows.size()) {
+    unsigned first = i;
+    int      prevKey = rows[i].first;
+    string   filter(bloom ? FILTER_SIZE : 0, '\0');
+
+    block.erase();
+    for (; i < rows.size(); i++) {
+      const string& value = rows[i].second;
+      unsigned prefix = 0;
+      if (i > first) {
+        const string& prev = rows[i - 1].second;
+        while (prefix < prev.size() && prefix < value.size() && prev[prefix] == value[prefix]) prefix++;
+      }
+
+      string tuple;
+      putVarint(tuple, (unsigned)rows[i].first - (unsigned)prevKey);
+      putVarint(tuple, prefix);
+      putVarint(tuple, value.size() - prefix);
+      tuple.append(value, prefix, string::npos);
+      if (i > first && block.size() + tuple.size() > (unsigned)BLOCK_SIZE) break;
+      block += tuple;
+      prevKey = rows[i].first;
+
+      if (bloom) {
+        unsigned h1, h2;
+        BloomFilter::hash(value.data(), value.size(), h1, h2);
+        for (int k = 0; k < HASH_COUNT; k++) {
+          unsigned bit = (h1 + k * h2) % (FILTER_SIZE * 8);
+          filter[bit / 8] |= (char)(1 << (bit % 8));
+        }
+      }
+    }
+
+    keys.push_back(rows[first].first);
+    offsets.push_back(offset);
+    starts.push_back(first);
+    filters += filter;
+    fwrite(block.data(), 1, block.size(), fp);
+    offset += block.size();
+  }
+  offsets.push_back(offset);
+  starts.push_back(rows.size());
+
+  // the index starts at an int boundary
+  while (offset % sizeof(int) != 0) {
+    fputc(0, fp);
+    offset++;
+  }
+  if (!keys.empty()) fwrite(&keys[0], sizeof(int), keys.size(), fp);
+  fwrite(&offsets[0], sizeof(int), offsets.size(), fp);
+  fwrite(&starts[0], sizeof(int), starts.size(), fp);
+  fwrite(filters.data(), 1, filters.size(), fp);
+
+  header[0] = FROZEN_MAGIC;
+  header[1] = rows.size();
+  header[2] = keys.size();
+  header[3] = bloom ? FILTER_SIZE : 0;
+  header[4] = offset;
+  fseek(fp, 0, SEEK_SET);
+  fwrite(header, sizeof(int), HEADER_INTS, fp);
+  return endWrite(filename, fp);
+}
+
+int FrozenTable::findBlock(int key) const
+{
+  // the tuples with the key may start in the last block whose first
+  // key is smaller, since equal keys can span blocks
+  int b = std::lower_bound(firstKeys, firstKeys + blocks, key) - firstKeys;
+  return (b > 0) ? b - 1 : 0;
+}
+
+RC FrozenTable::readBlock(int b, Block& block) const
+{
+  const char* p = base + offsets[b];
+  const char* end = base + offsets[b + 1];
+  int         n = firstRows[b + 1] - firstRows[b];
+  unsigned    delta, prefix, suffix;
+  int         key = firstKeys[b];
+  int         last = 0;
+
+  block.keys.resize(n);
+  block.offsets.resize(n + 1);
+  block.values.erase();
+  block.offsets[0] = 0;
+  for (int i = 0; i < n; i++) {
+    if (!getVarint(p, end, delta) || !getVarint(p, end, prefix) ||
+        !getVarint(p, end, suffix) || (int)prefix > (int)block.values.size() - last ||
+        suffix > (unsigned)(end - p)) {
+      return RC_INVALID_FILE_FORMAT;
+    }
+    key = (int)((unsigned)key + delta);
+    block.keys[i] = key;
+
+    // the value is the prefix of the value before it and the rest
+    int begin = block.values.size();
+    block.values.append(block.values, last, prefix);
+    block.values.append(p, suffix);
+    p += suffix;
+    last = begin;
+    block.offsets[i + 1] = block.values.size();
+  }
+
+  pthread_mutex_lock(&lock);
+  blockReadCount++;
+  pthread_mutex_unlock(&lock);
+  return 0;
+}
+
+bool FrozenTable::mayContain(int b, const string& value) const
+{
+  unsigned h1, h2;
+
+  if (filterSize == 0) return true;
+
+  const char* filter = filters + (long long)b * filterSize;
+  BloomFilter::hash(value.data(), value.size(), h1, h2);
+  for (int k = 0; k < HASH_COUNT; k++) {
+    unsigned bit = (h1 + k * h2) % (filterSize * 8);
+    if ((filter[bit / 8] & (1 << (bit % 8))) == 0) return false;
+  }
+  return true;
+}
+
+RC FrozenTable::getRows(vector<pair<int, string> >& rows) const
+{
+  Block block;
+  RC    rc;
+
+  rows.clear();
+  rows.reserve(count);
+  for (int b = 0; b < blocks; b++) {
+    if ((rc = readBlock(b, block)) < 0) return rc;
+    for (unsigned i = 0; i < block.keys.size(); i++) {
+      rows.push_back(std::make_pair(block.keys[i],
+        block.values.substr(block.offsets[i], block.offsets[i + 1] - block.offsets[i])));
+    }
+  }
+  return 0;
+}
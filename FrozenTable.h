@@ -0,0 +1,158 @@
+#ifndef FROZENTABLE_H
+#define FROZENTABLE_H
+
+#include <string>
+#include <utility>
+#include <vector>
+#include <pthread.h>
+#include "Bruinbase.h"
+#include "MappedFile.h"
+#include "PageFile.h"
+
+/**
+ * A read-only table written by FREEZE. The tuples are stored in key
+ * order in blocks of about BLOCK_SIZE bytes, filled completely, and a
+ * block is compressed: a key is stored as the difference from the key
+ * before it and a value as the length of the prefix it shares with the
+ * value before it plus the rest of it, all lengths in variable-length
+ * integers. A sparse index holds the first key of every block, so a
+ * key range is found by a binary search on the blocks.
+ *
+ * The frozen file (table + ".frz") is:
+ *
+ *   - a header: FROZEN_MAGIC, # tuples, # blocks n, # bytes of the
+ *     Bloom filter of a block (0: no filters), the offset of the index
+ *   - the blocks, one after another
+ *   - the index: the first keys of the n blocks, the n+1 offsets of the
+ *     blocks in the file, and the n+1 numbers of the first tuples
+ *   - the Bloom filters of the values of the blocks, if any
+ *
+ * Like a memory table (see MemTable and MappedFile), the file is mapped
+ * into memory by mmap() when it is first used, and stays mapped for the
+ * later commands. Only the blocks a query needs are decoded.
+ */
+class FrozenTable : public MappedFile {
+ public:
+
+  static const int FROZEN_MAGIC = 0x315a5246;  // "FRZ1"
+
+  // # bytes of a block, when its tuples are smaller
+  static const int BLOCK_SIZE = PageFile::PAGE_SIZE;
+
+  // # bytes of the Bloom filter of a block, and # bits set by a value
+  static const int FILTER_SIZE = 128;
+  static const int HASH_COUNT = 4;
+
+  /**
+   * the decoded tuples of a block.
+   */
+  struct Block {
+    std::vector<int> keys;      // the keys
+    std::vector<int> offsets;   // value i is the bytes [offset i, offset i+1)
+    std::string      values;    // the values, one after another
+  };
+
+  /**
+   * get the table of a frozen file, mapping the file into memory if
+   * it is not mapped yet.
+   * @param filename[IN] the name of the frozen file
+   * @param table[OUT] the table
+   * @return error code. 0 if no error
+   */
+  static RC get(const std::string& filename, const FrozenTable*& table);
+
+  /**
+   * write the tuples of a table to a frozen file. the tuples are sorted
+   * by key first. the old file, if any, is replaced atomically and
+   * unmapped.
+   * @param filename[IN] the name of the frozen file
+   * @param rows[IN] the (key, value) pairs of the table
+   * @param bloom[IN] keep Bloom filters of the values of the blocks?
+   * @return error code. 0 if no error
+   */
+  static RC write(const std::string& filename, std::vector<std::pair<int, std::string> >& rows,
+                  bool bloom);
+
+  /**
+   * @return # tuples
+   */
+  int size() const { return count; }
+
+  /**
+   * @return # blocks
+   */
+  int blockCount() const { return blocks; }
+
+  /**
+   * @param b[IN] a block (0 <= b < blockCount())
+   * @return the key of the first tuple of the block
+   */
+  int firstKey(int b) const { return firstKeys[b]; }
+
+  /**
+   * @param b[IN] a block (0 <= b <= blockCount())
+   * @return the number of the first tuple of the block (size() for
+   *         the end of the table)
+   */
+  int firstRow(int b) const { return firstRows[b]; }
+
+  /**
+   * @return the first block that may have a tuple with a key >= key
+   */
+  int findBlock(int key) const;
+
+  /**
+   * decode the tuples of a block.
+   * @param b[IN] the block (0 <= b < blockCount())
+   * @param block[OUT] the tuples of the block
+   * @return error code. 0 if no error
+   */
+  RC readBlock(int b, Block& block) const;
+
+  /**
+   * @return true if the blocks have Bloom filters
+   */
+  bool hasBloomFilter() const { return filterSize > 0; }
+
+  /**
+   * @param b[IN] a block
+   * @param value[IN] the value to look for
+   * @return false if no tuple of the block has the value. true if some
+   *         tuple may have it (or the block has no filter)
+   */
+  bool mayContain(int b, const std::string& value) const;
+
+  /**
+   * decode all tuples.
+   * @param rows[OUT] the (key, value) pairs, in key order
+   * @return error code. 0 if no error
+   */
+  RC getRows(std::vector<std::pair<int, std::string> >& rows) const;
+
+  /**
+   * @return the total # of blocks decoded
+   */
+  static int getBlockReadCount() { return blockReadCount; }
+
+ private:
+  int         count;       // # tuples
+  int         blocks;      // # blocks
+  int         filterSize;  // # bytes of the Bloom filter of a block
+  const int*  firstKeys;   // the index, in the file
+  const int*  offsets;
+  const int*  firstRows;
+  const char* filters;     // the Bloom filters, in the file
+
+  FrozenTable();
+
+  // set up the index and the filters on a mapped file
+  RC parse();
+
+  // make a table to map a frozen file
+  static MappedFile* create();
+
+  static int blockReadCount;    // total # of blocks decoded
+  static pthread_mutex_t lock;  // guards the counter
+};
+
+#endif // FROZENTABLE_H
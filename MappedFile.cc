@@ -0,0 +1,110 @@
+#include <algorithm>
+#include <cstdio>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "Bruinbase.h"
+#include "BTreeIndex.h"
+#include "MappedFile.h"
+
+using std::map;
+using std::pair;
+using std::string;
+using std::vector;
+
+map<string, MappedFile*> MappedFile::files;
+pthread_mutex_t MappedFile::lock = PTHREAD_MUTEX_INITIALIZER;
+
+MappedFile::MappedFile()
+{
+  base = NULL;
+  length = 0;
+}
+
+MappedFile::~MappedFile()
+{
+  if (base != NULL) ::munmap((void*) base, length);
+}
+
+bool MappedFile::exists(const string& filename)
+{
+  return ::access(filename.c_str(), F_OK) == 0;
+}
+
+RC MappedFile::get(const string& filename, MappedFile* (*create)(), const MappedFile*& file)
+{
+  RC rc = 0;
+
+  pthread_mutex_lock(&lock);
+  map<string, MappedFile*>::iterator it = files.find(filename);
+  if (it != files.end()) {
+    file = it->second;
+  } else {
+    MappedFile* f = create();
+    if ((rc = f->open(filename)) < 0 || (rc = f->parse()) < 0) {
+      delete f;
+    } else {
+      files[filename] = f;
+      file = f;
+    }
+  }
+  pthread_mutex_unlock(&lock);
+  return rc;
+}
+
+RC MappedFile::open(const string& filename)
+{
+  struct stat statbuf;
+  int         fd;
+
+  if ((fd = ::open(filename.c_str(), O_RDONLY)) < 0) return RC_FILE_OPEN_FAILED;
+  if (::fstat(fd, &statbuf) < 0 || statbuf.st_size == 0) {
+    ::close(fd);
+    return RC_INVALID_FILE_FORMAT;
+  }
+
+  length = statbuf.st_size;
+  void* p = ::mmap(NULL, length, PROT_READ, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (p == MAP_FAILED) return RC_FILE_READ_FAILED;
+  base = (const char*) p;
+  return 0;
+}
+
+RC MappedFile::beginWrite(const string& filename, vector<pair<int, string> >& rows, FILE*& fp)
+{
+  string tmpname = filename + ".tmp";
+
+  std::stable_sort(rows.begin(), rows.end(), lessKey<string>);
+
+  if ((fp = fopen(tmpname.c_str(), "w")) == NULL) return RC_FILE_OPEN_FAILED;
+  return 0;
+}
+
+RC MappedFile::endWrite(const string& filename, FILE* fp)
+{
+  string tmpname = filename + ".tmp";
+
+  if (ferror(fp)) {
+    fclose(fp);
+    ::unlink(tmpname.c_str());
+    return RC_FILE_WRITE_FAILED;
+  }
+  if (fclose(fp) != 0) {
+    ::unlink(tmpname.c_str());
+    return RC_FILE_WRITE_FAILED;
+  }
+
+  // the new file replaces the old one, which is mapped again
+  // when it is used next
+  pthread_mutex_lock(&lock);
+  RC rc = (::rename(tmpname.c_str(), filename.c_str()) == 0) ? 0 : RC_FILE_WRITE_FAILED;
+  map<string, MappedFile*>::iterator it = files.find(filename);
+  if (it != files.end()) {
+    delete it->second;
+    files.erase(it);
+  }
+  pthread_mutex_unlock(&lock);
+  return rc;
+}
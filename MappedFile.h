@@ -0,0 +1,87 @@
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include <cstdio>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+#include <pthread.h>
+#include "Bruinbase.h"
+
+/**
+ * A table file that is mapped into memory by mmap() and used right
+ * where it is mapped: the base of MemTable and FrozenTable.
+ *
+ * A file is mapped when it is first used, and stays mapped for all
+ * later commands of the process. A new version of the file is written
+ * to a temporary file (see beginWrite() and endWrite()), which replaces
+ * the old file atomically; the old mapping is dropped, so the file is
+ * mapped again when it is used next.
+ */
+class MappedFile {
+ public:
+
+  /**
+   * @param filename[IN] the name of a file
+   * @return true if the file exists
+   */
+  static bool exists(const std::string& filename);
+
+  /**
+   * @return # bytes of the file
+   */
+  long long getSize() const { return length; }
+
+ protected:
+  const char* base;     // the mapped file
+  long long   length;   // # bytes mapped
+
+  MappedFile();
+  virtual ~MappedFile();
+
+  /**
+   * check the mapped file and set up the object on it.
+   * @return error code. 0 if no error
+   */
+  virtual RC parse() = 0;
+
+  /**
+   * get the object of a file, mapping and parsing the file if it is
+   * not mapped yet.
+   * @param filename[IN] the name of the file
+   * @param create[IN] makes an object (of the class of the file) to map it
+   * @param file[OUT] the object of the file
+   * @return error code. 0 if no error
+   */
+  static RC get(const std::string& filename, MappedFile* (*create)(), const MappedFile*& file);
+
+  /**
+   * sort the tuples of a table by key, and open a temporary file to
+   * write the new version of the file to.
+   * @param filename[IN] the name of the file
+   * @param rows[IN/OUT] the (key, value) pairs of the table
+   * @param fp[OUT] the temporary file
+   * @return error code. 0 if no error
+   */
+  static RC beginWrite(const std::string& filename, std::vector<std::pair<int, std::string> >& rows,
+                       FILE*& fp);
+
+  /**
+   * close the temporary file opened by beginWrite(), and replace the
+   * file with it. the old file is unmapped.
+   * @param filename[IN] the name of the file
+   * @param fp[IN] the temporary file
+   * @return error code. 0 if no error
+   */
+  static RC endWrite(const std::string& filename, FILE* fp);
+
+ private:
+  // map a file into memory
+  RC open(const std::string& filename);
+
+  static std::map<std::string, MappedFile*> files;  // the mapped files
+  static pthread_mutex_t lock;                      // guards files
+};
+
+#endif // MAPPEDFILE_H
@@ -0,0 +1,96 @@
+#include <algorithm>
+#include <cstdio>
+#include "Bruinbase.h"
+#include "MemTable.h"
+
+using std::pair;
+using std::string;
+using std::vector;
+
+// # ints in the header of a snapshot
+static const int HEADER_INTS = 3;
+
+MemTable::MemTable()
+{
+  count = 0;
+  keys = offsets = NULL;
+  values = NULL;
+}
+
+MappedFile* MemTable::create()
+{
+  return new MemTable;
+}
+
+RC MemTable::get(const string& filename, const MemTable*& table)
+{
+  const MappedFile* file;
+  RC rc;
+
+  if ((rc = MappedFile::get(filename, create, file)) < 0) return rc;
+  table = static_cast<const MemTable*>(file);
+  return 0;
+}
+
+RC MemTable::parse()
+{
+  if (length < (long long)(HEADER_INTS * sizeof(int))) return RC_INVALID_FILE_FORMAT;
+
+  // the arrays are used right where they are in the snapshot
+  const int* header = (const int*) base;
+  count = header[1];
+  keys = header + HEADER_INTS;
+  offsets = keys + count;
+  values = (const char*)(offsets + count + 1);
+  if (header[0] != SNAPSHOT_MAGIC || count < 0 ||
+      (HEADER_INTS + 2 * (long long)count + 1) * (long long)sizeof(int) + header[2] != length) {
+    return RC_INVALID_FILE_FORMAT;
+  }
+  return 0;
+}
+
+RC MemTable::write(const string& filename, vector<pair<int, string> >& rows)
+{
+  FILE*  fp;
+  int    header[HEADER_INTS];
+  int    offset = 0;
+  RC     rc;
+
+  if ((rc = beginWrite(filename, rows, fp)) < 0) return rc;
+
+  header[0] = SNAPSHOT_MAGIC;
+  header[1] = rows.size();
+  header[2] = 0;
+  for (unsigned i = 0; i < rows.size(); i++) header[2] += rows[i].second.size();
+  fwrite(header, sizeof(int), HEADER_INTS, fp);
+  for (unsigned i = 0; i < rows.size(); i++) fwrite(&rows[i].first, sizeof(int), 1, fp);
+  for (unsigned i = 0; i <= rows.size(); i++) {
+    fwrite(&offset, sizeof(int), 1, fp);
+    if (i < rows.size()) offset += rows[i].second.size();
+  }
+  for (unsigned i = 0; i < rows.size(); i++) {
+    fwrite(rows[i].second.data(), 1, rows[i].second.size(), fp);
+  }
+  return endWrite(filename, fp);
+}
+
+int MemTable::lowerBound(int key) const
+{
+  return std::lower_bound(keys, keys + count, key) - keys;
+}
+
+int MemTable::upperBound(int key) const
+{
+  return std::upper_bound(keys, keys + count, key) - keys;
+}
+
+void MemTable::getRows(vector<pair<int, string> >& rows) const
+{
+  rows.clear();
+  rows.reserve(count);
+  for (int i = 0; i < count; i++) {
+    int len;
+    const char* v = value(i, len);
+    rows.push_back(std::make_pair(keys[i], string(v, len)));
+  }
+}
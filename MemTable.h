@@ -0,0 +1,104 @@
+#ifndef MEMTABLE_H
+#define MEMTABLE_H
+
+#include <string>
+#include <utility>
+#include <vector>
+#include "Bruinbase.h"
+#include "MappedFile.h"
+
+/**
+ * A table kept entirely in memory, loaded "WITH MEMORY". Instead of
+ * pages and a B+tree, the tuples are kept in arrays sorted by key, so
+ * a key is found by a binary search and a key range is a run of entries.
+ *
+ * The arrays are stored as they are in a snapshot file (table + ".mem"):
+ *
+ *   - a header: SNAPSHOT_MAGIC, # tuples n, # bytes of the values
+ *   - the n keys, in increasing order (ties in the order of loading)
+ *   - n+1 offsets: value i is the bytes [offset i, offset i+1)
+ *   - the values, one after another
+ *
+ * A snapshot is mapped into memory by mmap() when it is first used, and
+ * stays mapped for all later commands of the process (see MappedFile):
+ * a query does not read or open any file. A command that changes the
+ * table writes a new snapshot when it is done with the table (see write()).
+ */
+class MemTable : public MappedFile {
+ public:
+
+  static const int SNAPSHOT_MAGIC = 0x314d4542;  // "BEM1"
+
+  /**
+   * get the table of a snapshot, mapping the snapshot into memory if
+   * it is not mapped yet.
+   * @param filename[IN] the name of the snapshot file
+   * @param table[OUT] the table
+   * @return error code. 0 if no error
+   */
+  static RC get(const std::string& filename, const MemTable*& table);
+
+  /**
+   * write the tuples of a table to its snapshot. the tuples are sorted
+   * by key first. the old snapshot, if any, is replaced atomically and
+   * unmapped.
+   * @param filename[IN] the name of the snapshot file
+   * @param rows[IN] the (key, value) pairs of the table
+   * @return error code. 0 if no error
+   */
+  static RC write(const std::string& filename, std::vector<std::pair<int, std::string> >& rows);
+
+  /**
+   * @return # tuples
+   */
+  int size() const { return count; }
+
+  /**
+   * @param i[IN] a tuple (0 <= i < size())
+   * @return the key of the tuple
+   */
+  int key(int i) const { return keys[i]; }
+
+  /**
+   * @param i[IN] a tuple (0 <= i < size())
+   * @param len[OUT] # bytes of the value
+   * @return the first byte of the value
+   */
+  const char* value(int i, int& len) const
+  {
+    len = offsets[i + 1] - offsets[i];
+    return values + offsets[i];
+  }
+
+  /**
+   * @return the first tuple with a key >= key (size() if none)
+   */
+  int lowerBound(int key) const;
+
+  /**
+   * @return the first tuple with a key > key (size() if none)
+   */
+  int upperBound(int key) const;
+
+  /**
+   * copy all tuples, to change them and write() them back.
+   * @param rows[OUT] the (key, value) pairs, in the order of the table
+   */
+  void getRows(std::vector<std::pair<int, std::string> >& rows) const;
+
+ private:
+  int         count;    // # tuples
+  const int*  keys;     // the keys, in the snapshot
+  const int*  offsets;  // the offsets of the values, in the snapshot
+  const char* values;   // the values, in the snapshot
+
+  MemTable();
+
+  // set up the arrays on a mapped snapshot
+  RC parse();
+
+  // make a table to map a snapshot
+  static MappedFile* create();
+};
+
+#endif // MEMTABLE_H
@@ -9,34 +9,43 @@
 
 #include "Bruinbase.h"
 #include "PageFile.h"
+#include <cerrno>
+#include <cstdlib>
 #include <cstring>
 #include <fcntl.h>
 #include <sys/stat.h>
 #include <unistd.h>
 
 using std::string;
+using std::vector;
 
 int PageFile::readCount = 0;
 int PageFile::writeCount = 0;
+int PageFile::dirReadCount[PageFile::MAX_DATA_DIRS];
+int PageFile::dirWriteCount[PageFile::MAX_DATA_DIRS];
+vector<string> PageFile::dataDirs;
+bool PageFile::dataDirsLoaded = false;
 int PageFile::cacheClock = 1;
 struct PageFile::cacheStruct PageFile::readCache[PageFile::CACHE_COUNT];
+pthread_mutex_t PageFile::cacheLock = PTHREAD_MUTEX_INITIALIZER;
 
 PageFile::PageFile() 
 { 
   fd = -1; 
   epid = 0; 
+  stripes = 0;
 }
 
 PageFile::PageFile(const string& filename, char mode)
 {
   fd = -1;
   epid = 0;
+  stripes = 0;
   open(filename.c_str(), mode);
 }
 
 RC PageFile::open(const string& filename, char mode)
 {
-  RC   rc;
   int  oflag;
   struct stat statbuf;
 
@@ -56,26 +65,47 @@ RC PageFile::open(const string& filename, char mode)
     return RC_INVALID_FILE_MODE;
   }
 
-  // open the file
-  fd = ::open(filename.c_str(), oflag, 0644);
-  if (fd < 0) { fd = -1; return RC_FILE_OPEN_FAILED; }
+  // open the file in every data directory
+  vector<string> names = stripeNames(filename);
+  stripes = names.size();
+  epid = 0;
+  for (int k = 0; k < stripes; k++) {
+    fds[k] = ::open(names[k].c_str(), oflag, 0644);
+    if (fds[k] < 0 || ::fstat(fds[k], &statbuf) < 0) {
+      if (fds[k] >= 0) ::close(fds[k]);
+      while (--k >= 0) ::close(fds[k]);
+      fd = -1;
+      stripes = 0;
+      return RC_FILE_OPEN_FAILED;
+    }
 
-  // get the size of the file to set the end pid
-  rc = ::fstat(fd, &statbuf);
-  if (rc < 0) { ::close(fd); fd = -1; return RC_FILE_OPEN_FAILED; }
-  epid = statbuf.st_size / PAGE_SIZE;
+    // get the size of the stripe to set the end pid:
+    // one after the last page of all stripes
+    PageId pages = statbuf.st_size / PAGE_SIZE;
+    if (pages > 0) {
+      PageId last = pages - 1;
+      PageId pid = ((last / EXTENT_PAGES) * stripes + k) * EXTENT_PAGES + last % EXTENT_PAGES;
+      if (pid >= epid) epid = pid + 1;
+    }
+  }
+  fd = fds[0];
 
   return 0;
 }
 
 RC PageFile::close()
 {
+  RC rc = 0;
+
   if (fd <= 0) return RC_FILE_CLOSE_FAILED;
 
-  // close the file
-  if (::close(fd) < 0) return RC_FILE_CLOSE_FAILED;
+  // close the file in every data directory
+  for (int k = 0; k < stripes; k++) {
+    if (::close(fds[k]) < 0) rc = RC_FILE_CLOSE_FAILED;
+  }
 
   // evict all cached pages for this file
+  pthread_mutex_lock(&cacheLock);
   for (int i = 0; i < CACHE_COUNT; i++) {
     if (readCache[i].fd == fd && readCache[i].lastAccessed != 0) {
        readCache[i].fd = 0;
@@ -83,11 +113,13 @@ RC PageFile::close()
        readCache[i].lastAccessed = 0;
     }
   }
+  pthread_mutex_unlock(&cacheLock);
 
   // set the fd and epid to the initial state
   fd = -1; 
   epid = 0;
-  return 0;
+  stripes = 0;
+  return rc;
 }
 
 PageId PageFile::endPid() const 
@@ -95,23 +127,19 @@ PageId PageFile::endPid() const
   return epid;
 }
 
-RC PageFile::seek(PageId pid) const
-{
-  return (::lseek(fd, pid * PAGE_SIZE, SEEK_SET) < 0) ? RC_FILE_SEEK_FAILED : 0;
-}
-
 RC PageFile::write(PageId pid, const void* buffer)
 {
-  RC rc;
-  if (pid < 0) return RC_INVALID_PID; 
+  int   stripe;
+  off_t offset;
 
-  // seek to the location of the page
-  if ((rc = seek(pid)) < 0) return rc;
+  if (pid < 0) return RC_INVALID_PID; 
 
   // write the buffer to the disk page
-  if (::write(fd, buffer, PAGE_SIZE) < 0) return RC_FILE_WRITE_FAILED;
+  locate(pid, stripe, offset);
+  if (::pwrite(fds[stripe], buffer, PAGE_SIZE, offset) < 0) return RC_FILE_WRITE_FAILED;
 
   // if the page is in read cache, invalidate it
+  pthread_mutex_lock(&cacheLock);
   for (int i = 0; i < CACHE_COUNT; i++) {
     if (readCache[i].fd == fd && readCache[i].pid == pid &&
         readCache[i].lastAccessed != 0) {
@@ -127,54 +155,231 @@ RC PageFile::write(PageId pid, const void* buffer)
 
   // increase page write count
   writeCount++;
+  dirWriteCount[stripe]++;
+  pthread_mutex_unlock(&cacheLock);
 
   return 0;
 }
 
-RC PageFile::read(PageId pid, void* buffer) const
+RC PageFile::truncate(PageId endPid)
 {
-  RC rc;
+  if (endPid < 0 || endPid > epid) return RC_INVALID_PID;
+
+  // stripe k keeps the whole extents e < endExtent with e % stripes == k,
+  // and the first pages of extent endExtent if it is in the stripe
+  PageId endExtent = endPid / EXTENT_PAGES;
+  for (int k = 0; k < stripes; k++) {
+    off_t pages = (endExtent > k) ? ((endExtent - k - 1) / stripes + 1) * EXTENT_PAGES : 0;
+    if (endExtent % stripes == k) pages += endPid % EXTENT_PAGES;
+    if (::ftruncate(fds[k], pages * PAGE_SIZE) < 0) return RC_FILE_WRITE_FAILED;
+  }
+
+  // evict the discarded pages from the read cache
+  pthread_mutex_lock(&cacheLock);
+  for (int i = 0; i < CACHE_COUNT; i++) {
+    if (readCache[i].fd == fd && readCache[i].pid >= endPid &&
+        readCache[i].lastAccessed != 0) {
+       readCache[i].fd = 0;
+       readCache[i].pid = 0;
+       readCache[i].lastAccessed = 0;
+    }
+  }
+  pthread_mutex_unlock(&cacheLock);
+
+  epid = endPid;
+  return 0;
+}
 
+RC PageFile::read(PageId pid, void* buffer) const
+{
   if (pid < 0 || pid >= epid) return RC_INVALID_PID; 
 
   //
   // if the page is in cache, read it from there
   //
+  pthread_mutex_lock(&cacheLock);
+  int i = findCached(pid);
+  if (i >= 0) {
+    memcpy(buffer, readCache[i].buffer, PAGE_SIZE);
+    readCache[i].lastAccessed = ++cacheClock;
+    pthread_mutex_unlock(&cacheLock);
+    return 0;
+  }
+  pthread_mutex_unlock(&cacheLock);
+
+  // read the page without holding the lock, so that
+  // other threads can read other pages meanwhile
+  int   stripe;
+  off_t offset;
+  locate(pid, stripe, offset);
+  if (::pread(fds[stripe], buffer, PAGE_SIZE, offset) < 0) {
+    return RC_FILE_READ_FAILED;
+  }
+
+  // find the cache slot to evict and keep a copy of the page there
+  pthread_mutex_lock(&cacheLock);
+  int toEvict = findVictim();
+  if (toEvict >= 0) {
+    readCache[toEvict].fd = fd;
+    readCache[toEvict].pid = pid;
+    readCache[toEvict].lastAccessed = ++cacheClock;
+    memcpy(readCache[toEvict].buffer, buffer, PAGE_SIZE);
+  }
+
+  // increase the page read count
+  readCount++;
+  dirReadCount[stripe]++;
+  pthread_mutex_unlock(&cacheLock);
+
+  return 0;
+}
+
+RC PageFile::pin(PageId pid, const char*& page) const
+{
+  char buffer[PAGE_SIZE];
+
+  if (pid < 0 || pid >= epid) return RC_INVALID_PID; 
+
+  // if the page is in cache, pin it there
+  pthread_mutex_lock(&cacheLock);
+  int i = findCached(pid);
+  if (i >= 0) {
+    readCache[i].lastAccessed = ++cacheClock;
+    readCache[i].pinCount++;
+    page = readCache[i].buffer;
+    pthread_mutex_unlock(&cacheLock);
+    return 0;
+  }
+  pthread_mutex_unlock(&cacheLock);
+
+  int   stripe;
+  off_t offset;
+  locate(pid, stripe, offset);
+  if (::pread(fds[stripe], buffer, PAGE_SIZE, offset) < 0) {
+    return RC_FILE_READ_FAILED;
+  }
+
+  pthread_mutex_lock(&cacheLock);
+  readCount++;
+  dirReadCount[stripe]++;
+
+  // another thread may have cached the page in the meantime
+  if ((i = findCached(pid)) < 0 && (i = findVictim()) >= 0) {
+    readCache[i].fd = fd;
+    readCache[i].pid = pid;
+    memcpy(readCache[i].buffer, buffer, PAGE_SIZE);
+  }
+  if (i >= 0) {
+    readCache[i].lastAccessed = ++cacheClock;
+    readCache[i].pinCount++;
+    page = readCache[i].buffer;
+    pthread_mutex_unlock(&cacheLock);
+    return 0;
+  }
+  pthread_mutex_unlock(&cacheLock);
+
+  // every slot is pinned. the page gets a buffer of its own
+  char* copy = new char[PAGE_SIZE];
+  memcpy(copy, buffer, PAGE_SIZE);
+  page = copy;
+  return 0;
+}
+
+void PageFile::unpin(const char* page) const
+{
+  pthread_mutex_lock(&cacheLock);
   for (int i = 0; i < CACHE_COUNT; i++) {
-    if (readCache[i].fd == fd && readCache[i].pid == pid && 
-        readCache[i].lastAccessed != 0) {
-       memcpy(buffer, readCache[i].buffer, PAGE_SIZE);
-       readCache[i].lastAccessed = ++cacheClock;
-       return 0;
+    if (readCache[i].buffer == page) {
+      readCache[i].pinCount--;
+      pthread_mutex_unlock(&cacheLock);
+      return;
     }
   }
+  pthread_mutex_unlock(&cacheLock);
+
+  // not a cache slot: the page was read into a buffer of its own
+  delete [] page;
+}
 
-  // seek to the page
-  if ((rc = seek(pid)) < 0) return rc;
-  
-  // find the cache slot to evict
-  int toEvict = 0; 
+int PageFile::findCached(PageId pid) const
+{
   for (int i = 0; i < CACHE_COUNT; i++) {
-    if (readCache[i].lastAccessed == 0) {
-      toEvict = i;
-      break;
-    }
-    if (readCache[i].lastAccessed < readCache[toEvict].lastAccessed) {
+    if (readCache[i].fd == fd && readCache[i].pid == pid && 
+        readCache[i].lastAccessed != 0) return i;
+  }
+  return -1;
+}
+
+int PageFile::findVictim()
+{
+  // an empty slot, or else the least recently used slot that is not pinned
+  int toEvict = -1; 
+  for (int i = 0; i < CACHE_COUNT; i++) {
+    if (readCache[i].pinCount > 0) continue;
+    if (readCache[i].lastAccessed == 0) return i;
+    if (toEvict < 0 || readCache[i].lastAccessed < readCache[toEvict].lastAccessed) {
       toEvict = i;
     }
   }
-  readCache[toEvict].fd = fd;
-  readCache[toEvict].pid = pid;
-  readCache[toEvict].lastAccessed = ++cacheClock;
- 
-  // read the page to cache first and copy it to the buffer
-  if (::read(fd, readCache[toEvict].buffer, PAGE_SIZE) < 0) {
-    return RC_FILE_READ_FAILED;
+  return toEvict;
+}
+
+void PageFile::locate(PageId pid, int& stripe, off_t& offset) const
+{
+  PageId extent = pid / EXTENT_PAGES;
+  stripe = extent % stripes;
+  offset = ((off_t)(extent / stripes) * EXTENT_PAGES + pid % EXTENT_PAGES) * PAGE_SIZE;
+}
+
+vector<string> PageFile::stripeNames(const string& filename)
+{
+  vector<string> names;
+  int            n = getDataDirCount();
+
+  if (n == 0) names.push_back(filename);
+  for (int i = 0; i < n; i++) names.push_back(dataDirs[i] + "/" + filename);
+  return names;
+}
+
+int PageFile::getDataDirCount()
+{
+  pthread_mutex_lock(&cacheLock);
+  if (!dataDirsLoaded) {
+    // the directories are separated by ':', as in PATH
+    const char* env = getenv("BRUINBASE_DATA_DIRS");
+    string dirs = (env != NULL) ? env : "";
+    string::size_type begin = 0;
+    while (begin < dirs.size() && (int)dataDirs.size() < MAX_DATA_DIRS) {
+      string::size_type end = dirs.find(':', begin);
+      if (end == string::npos) end = dirs.size();
+      if (end > begin) dataDirs.push_back(dirs.substr(begin, end - begin));
+      begin = end + 1;
+    }
+    dataDirsLoaded = true;
   }
-  memcpy(buffer, readCache[toEvict].buffer, PAGE_SIZE);
+  int n = dataDirs.size();
+  pthread_mutex_unlock(&cacheLock);
+  return n;
+}
 
-  // increase the page read count
-  readCount++;
+const string& PageFile::getDataDir(int i)
+{
+  getDataDirCount();
+  return dataDirs[i];
+}
 
-  return 0;
+bool PageFile::exists(const string& filename)
+{
+  return ::access(stripeNames(filename)[0].c_str(), F_OK) == 0;
+}
+
+RC PageFile::remove(const string& filename)
+{
+  vector<string> names = stripeNames(filename);
+  RC             rc = 0;
+
+  for (unsigned k = 0; k < names.size(); k++) {
+    if (::unlink(names[k].c_str()) < 0 && errno != ENOENT) rc = RC_FILE_WRITE_FAILED;
+  }
+  return rc;
 }
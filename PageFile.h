@@ -10,19 +10,35 @@
 #ifndef PAGEFILE_H
 #define PAGEFILE_H
 
+#include <pthread.h>
+#include <sys/types.h>
 #include <string>
+#include <vector>
 #include "Bruinbase.h"
 
 typedef int PageId;
 
 /**
- * read/write a file in the unit of a page
+ * read/write a file in the unit of a page.
+ * pages can be read by several threads at the same time:
+ * the pages are read with pread() and the read cache shared by all
+ * files is guarded by a mutex.
+ *
+ * the files can be striped across several data directories, e.g., on
+ * different disks, listed in the environment variable BRUINBASE_DATA_DIRS
+ * separated by ':'. a file is then split into extents of EXTENT_PAGES
+ * pages, and extent e is stored in the file of the same name in data
+ * directory (e % # data directories). without BRUINBASE_DATA_DIRS,
+ * a file is stored as is, at its name.
  */
 class PageFile {
  public:
 
   static const int PAGE_SIZE = 1024;    // the size of a page is 1KB
 
+  static const int EXTENT_PAGES = 64;   // # pages striped to the same directory
+  static const int MAX_DATA_DIRS = 16;  // the largest # data directories
+
   PageFile();
   PageFile(const std::string& filename, char mode);
 
@@ -48,6 +64,23 @@ class PageFile {
    * @return error code. 0 if no error
    */
   RC read(PageId pid, void *buffer) const;
+
+  /**
+   * pin a disk page in the read cache and get a pointer to it, so that
+   * the page can be read without copying it. the page stays in the cache
+   * (and the pointer valid) until it is unpinned. if every cache slot is
+   * pinned, the page is read into a buffer of its own.
+   * @param pid[IN] the page to pin
+   * @param page[OUT] the page in memory
+   * @return error code. 0 if no error
+   */
+  RC pin(PageId pid, const char*& page) const;
+
+  /**
+   * release a page pinned by pin().
+   * @param page[IN] the pointer returned by pin()
+   */
+  void unpin(const char* page) const;
   
   /**
    * write the memory buffer to the disk page.
@@ -58,6 +91,14 @@ class PageFile {
    * @return error code. 0 if no error
    */
   RC write(PageId pid, const void *buffer);
+
+  /**
+   * cut the file down to its first endPid pages.
+   * the pages from endPid on are discarded and endPid() becomes endPid.
+   * @param endPid[IN] # pages to keep
+   * @return error code. 0 if no error
+   */
+  RC truncate(PageId endPid);
     
   /**
    * note the +1 part. The last page id in the file is actually endPid()-1.
@@ -76,19 +117,57 @@ class PageFile {
    */
   static int getPageWriteCount() { return writeCount; }
 
- protected:
   /**
-   * move the file cursor to the beginning of a page.
-   * this is an internal function not exposed to public.
-   * @param pid[IN] page to seek to
+   * @return # data directories the files are striped across
+   *         (0 if they are stored at their names)
+   */
+  static int getDataDirCount();
+
+  /**
+   * @param i[IN] a data directory
+   * @return the name of the data directory
+   */
+  static const std::string& getDataDir(int i);
+
+  /**
+   * @param i[IN] a data directory
+   * @return the total # of disk reads from the data directory
+   */
+  static int getDirReadCount(int i)  { return dirReadCount[i]; }
+
+  /**
+   * @param i[IN] a data directory
+   * @return the total # of disk writes to the data directory
+   */
+  static int getDirWriteCount(int i) { return dirWriteCount[i]; }
+
+  /**
+   * @param filename[IN] the name of a file
+   * @return true if the file exists (in the data directories)
+   */
+  static bool exists(const std::string& filename);
+
+  /**
+   * delete a file (from all data directories).
+   * @param filename[IN] the name of the file
    * @return error code. 0 if no error
    */
-  RC seek(PageId pid) const;
+  static RC remove(const std::string& filename);
 
  private:
   int     fd;     // file descriptor of the associated unix file
+                  // (of the first stripe if the file is striped)
   PageId  epid;   // (last page id + 1) of the file
 
+  int     stripes;             // # unix files of the file
+  int     fds[MAX_DATA_DIRS];  // their file descriptors
+
+  // the stripe of a page, and the offset of the page in the stripe
+  void locate(PageId pid, int& stripe, off_t& offset) const;
+
+  // the names of the unix files of a file
+  static std::vector<std::string> stripeNames(const std::string& filename);
+
   //
   // the following set of members implement LRU caching 
   //
@@ -102,11 +181,24 @@ class PageFile {
     PageId pid;             // page id of the cached page
     int    lastAccessed;    // the last time the cached page was accessed
                             //   (lastAccessed == 0) means that the buffer is empty
+    int    pinCount;        // # pins on the page. a pinned page is not evicted
     char buffer[PAGE_SIZE]; // the buffer used for caching
   } readCache[CACHE_COUNT];
 
+  // the cache slot of a page (-1 if not cached), and the slot to evict
+  // for a new page (-1 if every slot is pinned). called with cacheLock held
+  int findCached(PageId pid) const;
+  static int findVictim();
+
   static int readCount;  // total # of page reads 
   static int writeCount; // total # of page writes 
+  static int dirReadCount[MAX_DATA_DIRS];   // # page reads per data directory
+  static int dirWriteCount[MAX_DATA_DIRS];  // # page writes per data directory
+
+  static std::vector<std::string> dataDirs; // the data directories
+  static bool dataDirsLoaded;               // has BRUINBASE_DATA_DIRS been read?
+
+  static pthread_mutex_t cacheLock;  // guards the cache and the counters
 };
   
 #endif // PAGEFILE_H
@@ -0,0 +1,74 @@
+#include <algorithm>
+#include <climits>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include "Bruinbase.h"
+#include "Partitioning.h"
+
+using std::string;
+using std::vector;
+
+RC Partitioning::setBounds(const vector<int>& bounds)
+{
+  if ((int)bounds.size() >= MAX_PARTITIONS) return RC_INVALID_ATTRIBUTE;
+  for (unsigned i = 1; i < bounds.size(); i++) {
+    if (bounds[i] <= bounds[i - 1]) return RC_INVALID_ATTRIBUTE;
+  }
+
+  this->bounds = bounds;
+  return 0;
+}
+
+int Partitioning::find(int key) const
+{
+  return std::upper_bound(bounds.begin(), bounds.end(), key) - bounds.begin();
+}
+
+void Partitioning::getRange(int i, int& keyMin, int& keyMax) const
+{
+  keyMin = (i == 0) ? INT_MIN : bounds[i - 1];
+  keyMax = (i == (int)bounds.size()) ? INT_MAX : bounds[i] - 1;
+}
+
+string Partitioning::name(const string& table, int i)
+{
+  char suffix[16];
+
+  // a table name has no dots, so the partitions cannot clash with a table
+  sprintf(suffix, ".p%d", i);
+  return table + suffix;
+}
+
+RC Partitioning::load(const string& filename)
+{
+  std::ifstream in(filename.c_str());
+  string        line;
+  vector<int>   b;
+
+  if (!in.is_open()) return RC_FILE_OPEN_FAILED;
+
+  while (getline(in, line)) {
+    std::istringstream stat(line);
+    string name;
+    int    bound;
+
+    if (!(stat >> name) || name != "bounds") continue;
+    while (stat >> bound) b.push_back(bound);
+    if (!stat.eof()) return RC_INVALID_FILE_FORMAT;
+  }
+
+  return setBounds(b) < 0 ? RC_INVALID_FILE_FORMAT : 0;
+}
+
+RC Partitioning::save(const string& filename) const
+{
+  FILE* fp = fopen(filename.c_str(), "w");
+  if (fp == NULL) return RC_FILE_OPEN_FAILED;
+
+  fprintf(fp, "bounds");
+  for (unsigned i = 0; i < bounds.size(); i++) fprintf(fp, " %d", bounds[i]);
+  fprintf(fp, "\n");
+
+  return (fclose(fp) == 0) ? 0 : RC_FILE_WRITE_FAILED;
+}
@@ -0,0 +1,78 @@
+#ifndef PARTITIONING_H
+#define PARTITIONING_H
+
+#include <string>
+#include <vector>
+#include "Bruinbase.h"
+
+/**
+ * The range partitioning of a table on its key, declared by
+ * "PARTITION table AT b1, b2, ..., bn".
+ *
+ * The bounds split the keys into n+1 partitions: partition 0 has the keys
+ * below b1, partition i the keys in [bi, bi+1), and partition n the keys
+ * from bn on. Every partition is a table of its own, with its own record
+ * file, index and statistics, named table + ".p" + i (see name()). The
+ * table itself has no record file.
+ *
+ * The partitioning is stored in the partition file of the table
+ * (table + ".parts") as a "bounds b1 b2 ... bn" line.
+ */
+class Partitioning {
+ public:
+
+  // the largest # partitions of a table
+  static const int MAX_PARTITIONS = 64;
+
+  /**
+   * set the bounds of the partitions.
+   * @param bounds[IN] the bounds, in increasing order
+   * @return error code. 0 if no error
+   */
+  RC setBounds(const std::vector<int>& bounds);
+
+  /**
+   * @return # partitions
+   */
+  int count() const { return bounds.size() + 1; }
+
+  /**
+   * @param key[IN] a key
+   * @return the partition of the key
+   */
+  int find(int key) const;
+
+  /**
+   * get the range of keys of a partition.
+   * @param i[IN] the partition
+   * @param keyMin[OUT] the smallest key of the partition
+   * @param keyMax[OUT] the largest key of the partition
+   */
+  void getRange(int i, int& keyMin, int& keyMax) const;
+
+  /**
+   * @param table[IN] a partitioned table
+   * @param i[IN] a partition of the table
+   * @return the name of the table that stores the partition
+   */
+  static std::string name(const std::string& table, int i);
+
+  /**
+   * read the partitioning from a partition file.
+   * @param filename[IN] the name of the partition file
+   * @return error code. 0 if no error
+   */
+  RC load(const std::string& filename);
+
+  /**
+   * write the partitioning to a partition file.
+   * @param filename[IN] the name of the partition file
+   * @return error code. 0 if no error
+   */
+  RC save(const std::string& filename) const;
+
+ private:
+  std::vector<int> bounds;  // the smallest key of partitions 1 to n
+};
+
+#endif // PARTITIONING_H
@@ -9,9 +9,16 @@
 
 #include "Bruinbase.h"
 #include "RecordFile.h"
+#include "RowCache.h"
+#include <cstdio>
 #include <cstring>
+#include <unistd.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 using std::string;
+using std::vector;
 
 //
 // helper functions for page manipultation
@@ -32,6 +39,69 @@ static int getRecordCount(const char* page);
 // update # records stored in the page
 static void setRecordCount(char* page, int count);
 
+// get the layout of the page
+static int getPageLayout(const char* page);
+
+// set the layout of the page
+static void setPageLayout(char* page, int layout);
+
+// compute the pointer to the n'th key of a PAX page
+static char* paxKeyPtr(char* page, int n);
+
+// compute the pointer to the n'th value offset of a PAX page
+static char* paxOffsetPtr(char* page, int n);
+
+// get the n'th value offset of a PAX page, without the tombstone bit
+static unsigned short paxOffset(const char* page, int n);
+
+// read the record in the n'th slot of a PAX page
+static void readPaxSlot(const char* page, int n, int& key, std::string& value);
+
+// write the record to the n'th (the first empty) slot of a PAX page.
+// the value is given as len bytes at data.
+// return false if the record does not fit in the page
+static bool writePaxSlot(char* page, int n, int key, const char* data, int len);
+
+// rebuild a PAX page with the record in the n'th slot replaced.
+// the page is left unchanged and false is returned if it does not fit
+static bool repackPaxPage(char* page, int n, int key, const char* data, int len);
+
+// is the layout organized as a PAX page?
+static bool isPacked(int layout);
+
+// compute the pointer to the n'th key of a DICT page
+static char* dictKeyPtr(char* page, int n);
+
+// read the key and the value code in the n'th slot of a DICT page
+static void readDictSlot(const char* page, int n, int& key, int& code);
+
+// write the key and the value code to the n'th slot of a DICT page
+static void writeDictSlot(char* page, int n, int key, int code);
+
+// get the key of the record in the n'th slot of the page
+static int getSlotKey(const char* page, int n);
+
+// is the record in the n'th slot of the page deleted?
+static bool isDeleted(const char* page, int n);
+
+// leave a tombstone in the n'th slot of the page
+static void setDeleted(char* page, int n);
+
+// copy the record in the n'th slot of a page to the m'th (the first
+// empty) slot of a page of the same layout.
+// return false if the record does not fit in the page
+static bool copySlot(const char* from, int n, char* to, int m);
+
+// find the keys within [keyMin, keyMax] among n contiguous keys
+static int filterKeys(const char* ptr, int n, int keyMin, int keyMax, int* match);
+
+// # record slots in a page of the layout
+static int slotsPerPage(int layout);
+
+// the value as it is stored in a record, i.e., truncated
+// to at most RecordFile::MAX_VALUE_LENGTH-1 characters
+static string storedValue(const string& value);
+
 
 //
 // helper functions for RecordId manipulation
@@ -102,25 +172,72 @@ bool operator != (const RecordId& r1, const RecordId& r2)
   return ((r1.pid != r2.pid) || (r1.sid != r2.sid));
 }
 
+bool lessOldRid(const std::pair<RecordId, RecordId>& e, const RecordId& rid)
+{
+  return e.first < rid;
+}
+
 
 RecordFile::RecordFile()
 {
   erid.pid = 0;
   erid.sid = 0;
+  layout = ROW_LAYOUT;
+  encoded = false;
+  dictLoaded = false;
+  bloomed = false;
+  bloomLoaded = false;
+  clustered = false;
+  lastKey = 0;
 }
 
 RecordFile::RecordFile(const string& filename, char mode)
 {
+  encoded = false;
+  dictLoaded = false;
+  bloomed = false;
+  bloomLoaded = false;
+  clustered = false;
+  lastKey = 0;
   open(filename, mode);
 }
 
-RC RecordFile::open(const string& filename, char mode)
+RC RecordFile::open(const string& filename, char mode, int layout)
 {
   RC   rc;
   char page[PageFile::PAGE_SIZE];
 
   // open the page file
   if ((rc = pf.open(filename, mode)) < 0) return rc;
+  this->layout = layout;
+
+  // the values are dictionary-encoded if the file has a dictionary.
+  // a dictionary left behind by an old file of the same name is removed
+  // when the file is (re)created.
+  // so are the Bloom filters and the mark of a clustered file.
+  dictname = filename + ".dict";
+  bloomname = filename + ".bloom";
+  sortname = filename + ".clustered";
+  dictLoaded = false;
+  bloomLoaded = false;
+  cacheId = RowCache::fileId(filename);
+  if (pf.endPid() == 0) {
+    // the rows of an old file of the same name are not valid any more
+    RowCache::invalidateFile(cacheId);
+    if (mode == 'w' || mode == 'W') {
+      PageFile::remove(dictname);
+      PageFile::remove(bloomname);
+      ::unlink(sortname.c_str());
+    }
+    encoded = false;
+    bloomed = false;
+    clustered = false;
+  } else {
+    encoded = PageFile::exists(dictname);
+    bloomed = PageFile::exists(bloomname);
+    clustered = (::access(sortname.c_str(), F_OK) == 0);
+  }
+  if (encoded) this->layout = DICT_LAYOUT;
   
   //
   // in the rest of this function, we set the end record id
@@ -146,9 +263,14 @@ RC RecordFile::open(const string& filename, char mode)
     return rc;
   }
 
-  // get # records in the last page
+  // get # records in the last page.
+  // a PAX page has no fixed # slots. whether it is full is found out
+  // by append() when the next record does not fit.
+  // new pages continue the layout of the last page.
   erid.sid = getRecordCount(page);
-  if (erid.sid >= RECORDS_PER_PAGE) {
+  this->layout = getPageLayout(page);
+  if (erid.sid > 0) lastKey = getSlotKey(page, erid.sid - 1);
+  if (erid.sid >= slotsPerPage(getPageLayout(page))) {
     // the last page is full. advance the end record id to the next page.
     erid.pid++;
     erid.sid = 0;
@@ -159,10 +281,21 @@ RC RecordFile::open(const string& filename, char mode)
 
 RC RecordFile::close()
 {
+  RC rc = 0;
+
+  // write the Bloom filters that got new values
+  if (bloomLoaded && bloom.isDirty()) rc = bloom.save(bloomname);
+
   erid.pid = 0;
   erid.sid = 0;
+  encoded = false;
+  dictLoaded = false;
+  bloomed = false;
+  bloomLoaded = false;
+  clustered = false;
 
-  return pf.close();
+  RC closed = pf.close();
+  return (rc < 0) ? rc : closed;
 }
 
 RC RecordFile::read(const RecordId& rid, int& key, string& value) const
@@ -172,35 +305,111 @@ RC RecordFile::read(const RecordId& rid, int& key, string& value) const
   
   // check whether the rid is in the valid range
   if (rid.pid < 0 || rid.pid > erid.pid) return RC_INVALID_RID;
-  if (rid.sid < 0 || rid.sid >= RecordFile::RECORDS_PER_PAGE) return RC_INVALID_RID;
+  if (rid.sid < 0 || rid.sid >= RecordFile::MAX_RECORDS_PER_PAGE) return RC_INVALID_RID;
   if (rid >= erid) return RC_INVALID_RID;
+
+  // a record read recently may still be in the row cache
+  if (RowCache::lookup(cacheId, rid, key, value)) return 0;
   
   // read the page containing the record
   if ((rc = pf.read(rid.pid, page)) < 0) return rc;
+  if (rid.sid >= getRecordCount(page)) return RC_INVALID_RID;
+  if (isDeleted(page, rid.sid)) return RC_NO_SUCH_RECORD;
 
   // read the record from the slot in the page
-  readSlot(page, rid.sid, key, value);
+  switch (getPageLayout(page)) {
+  case PAX_LAYOUT:
+  case TUPLE_LAYOUT:
+    readPaxSlot(page, rid.sid, key, value);
+    break;
+  case DICT_LAYOUT:
+    {
+      const Dictionary* d;
+      int code;
+      if ((rc = getDictionary(d)) < 0) return rc;
+      readDictSlot(page, rid.sid, key, code);
+      if (code < 0 || code >= d->size()) return RC_INVALID_FILE_FORMAT;
+      value = d->decode(code);
+    }
+    break;
+  default:
+    readSlot(page, rid.sid, key, value);
+  }
 
+  RowCache::insert(cacheId, rid, key, value);
   return 0;
 }
 
-RC RecordFile::append(int key, const std::string& value, RecordId& rid)
+RC RecordFile::readCode(const RecordId& rid, int& key, int& code) const
 {
   RC   rc;
   char page[PageFile::PAGE_SIZE];
 
+  // check whether the rid is in the valid range
+  if (rid.pid < 0 || rid.pid > erid.pid) return RC_INVALID_RID;
+  if (rid.sid < 0 || rid.sid >= RecordFile::MAX_RECORDS_PER_PAGE) return RC_INVALID_RID;
+  if (rid >= erid) return RC_INVALID_RID;
+
+  // read the page containing the record
+  if ((rc = pf.read(rid.pid, page)) < 0) return rc;
+  if (rid.sid >= getRecordCount(page)) return RC_INVALID_RID;
+  if (getPageLayout(page) != DICT_LAYOUT) return RC_INVALID_FILE_FORMAT;
+  if (isDeleted(page, rid.sid)) return RC_NO_SUCH_RECORD;
+
+  readDictSlot(page, rid.sid, key, code);
+  return 0;
+}
+
+RC RecordFile::append(int key, const std::string& value, RecordId& rid)
+{
+  RC     rc;
+  char   page[PageFile::PAGE_SIZE];
+  int    code = 0;
+  string data;
+
+  // in a dictionary-encoded file, we store the code of the value
+  if (encoded) {
+    const Dictionary* d;
+    if ((rc = getDictionary(d)) < 0) return rc;
+    if ((code = d->encode(storedValue(value))) < 0) return RC_NOT_IN_DICTIONARY;
+  }
+
+  // a record out of key order ends the clustering of the file
+  if (clustered && (erid.pid > 0 || erid.sid > 0) && key < lastKey) unsetClustered();
+
   // unless we are writing to the the first slot of an empty page,
   // we have to read the page first
   if (erid.sid > 0) {
     if ((rc = pf.read(erid.pid, page)) < 0) return rc;
+  }
+
+  // a binary row is stored as is. a PAX value is truncated like a ROW value
+  int pageLayout = (erid.sid > 0) ? getPageLayout(page) : layout;
+  if (pageLayout == TUPLE_LAYOUT) {
+    if ((int)value.size() > MAX_ROW_LENGTH) return RC_INVALID_ATTRIBUTE;
+    data = value;
   } else {
+    data = storedValue(value);
+  }
+
+  // a PAX page is full when the record does not fit in its free space.
+  // in that case, the record goes to the first slot of the next page.
+  if (erid.sid > 0 && isPacked(pageLayout) &&
+      !writePaxSlot(page, erid.sid, key, data.data(), data.size())) {
+    erid.pid++;
+    erid.sid = 0;
+  }
+  if (erid.sid == 0) {
     // if this is the first slot of an empty page
     // we can simply initialize the page with zeros
     memset(page, 0, PageFile::PAGE_SIZE);
+    setPageLayout(page, layout);
+    if (isPacked(layout)) writePaxSlot(page, 0, key, data.data(), data.size());
   }
     
   // write the record to the first empty slot 
-  writeSlot(page, erid.sid, key, value);
+  if (getPageLayout(page) == ROW_LAYOUT) writeSlot(page, erid.sid, key, value);
+  if (getPageLayout(page) == DICT_LAYOUT) writeDictSlot(page, erid.sid, key, code);
 
   // the first four bytes in the page stores # records in the page.
   // update this number.
@@ -211,13 +420,411 @@ RC RecordFile::append(int key, const std::string& value, RecordId& rid)
     
   // we need to output the rid of the record slot
   rid = erid;
+  lastKey = key;
+  if ((rc = addToBloomFilter(erid.pid, value)) < 0) return rc;
 
   // advance the end record id by one to the next empty slot
-  ++erid;
+  if (++erid.sid >= slotsPerPage(getPageLayout(page))) {
+    erid.pid++;
+    erid.sid = 0;
+  }
 
   return 0;
 }
 
+RC RecordFile::filterPage(PageId pid, int keyMin, int keyMax, int codeMin, int codeMax,
+                          vector<int>& sids, vector<int>& keys) const
+{
+  RC          rc;
+  const char* page;
+
+  sids.clear();
+  keys.clear();
+
+  if ((rc = pinPage(pid, page)) < 0) return rc;
+  filterPage(page, keyMin, keyMax, codeMin, codeMax, sids, keys);
+  unpinPage(page);
+  return 0;
+}
+
+void RecordFile::filterPage(const char* pinned, int keyMin, int keyMax, int codeMin, int codeMax,
+                            vector<int>& sids, vector<int>& keys) const
+{
+  char* page = const_cast<char*>(pinned);
+  int   match[MAX_RECORDS_PER_PAGE];
+  int   count, n, key, code;
+
+  sids.clear();
+  keys.clear();
+  count = getRecordCount(page);
+
+  switch (getPageLayout(page)) {
+  case PAX_LAYOUT:
+  case TUPLE_LAYOUT:
+    // the keys are contiguous. compare them all first and
+    // then pick up the matching ones.
+    n = filterKeys(paxKeyPtr(page, 0), count, keyMin, keyMax, match);
+    for (int i = 0; i < n; i++) {
+      if (isDeleted(page, match[i])) continue;
+      memcpy(&key, paxKeyPtr(page, match[i]), sizeof(int));
+      sids.push_back(match[i]);
+      keys.push_back(key);
+    }
+    break;
+  case DICT_LAYOUT:
+    // the keys are contiguous, and so are the codes. 
+    // compare the keys first, and then the codes of the matching keys.
+    // a tombstone (code -1) is never in the code range.
+    n = filterKeys(dictKeyPtr(page, 0), count, keyMin, keyMax, match);
+    for (int i = 0; i < n; i++) {
+      readDictSlot(page, match[i], key, code);
+      if (code >= codeMin && code <= codeMax && code >= 0) {
+        sids.push_back(match[i]);
+        keys.push_back(key);
+      }
+    }
+    break;
+  default:
+    // the keys are RecordFile::MAX_VALUE_LENGTH bytes apart
+    for (int i = 0; i < count; i++) {
+      memcpy(&key, slotPtr(page, i), sizeof(int));
+      if (key >= keyMin && key <= keyMax && !isDeleted(page, i)) {
+        sids.push_back(i);
+        keys.push_back(key);
+      }
+    }
+  }
+}
+
+RC RecordFile::pinPage(PageId pid, const char*& page) const
+{
+  if (pid < 0 || pid > erid.pid) return RC_INVALID_PID;
+  return pf.pin(pid, page);
+}
+
+void RecordFile::unpinPage(const char* page) const
+{
+  pf.unpin(page);
+}
+
+RC RecordFile::readRef(const char* page, int sid, int& key, const char*& data, int& len) const
+{
+  RC rc;
+
+  if (sid < 0 || sid >= getRecordCount(page)) return RC_INVALID_RID;
+  if (isDeleted(page, sid)) return RC_NO_SUCH_RECORD;
+
+  switch (getPageLayout(page)) {
+  case PAX_LAYOUT:
+  case TUPLE_LAYOUT:
+    {
+      // the value is where readPaxSlot() would copy it from
+      unsigned short begin = paxOffset(page, sid);
+      unsigned short end = (sid == 0) ? PageFile::PAGE_SIZE : paxOffset(page, sid - 1);
+      memcpy(&key, paxKeyPtr(const_cast<char*>(page), sid), sizeof(int));
+      data = page + begin;
+      len = end - begin;
+    }
+    break;
+  case DICT_LAYOUT:
+    {
+      // the value stays in the dictionary as long as the file is open
+      const Dictionary* d;
+      int code;
+      if ((rc = getDictionary(d)) < 0) return rc;
+      readDictSlot(page, sid, key, code);
+      if (code < 0 || code >= d->size()) return RC_INVALID_FILE_FORMAT;
+      data = d->decode(code).data();
+      len = d->decode(code).size();
+    }
+    break;
+  default:
+    {
+      // the value is zero-terminated in its fixed-size slot
+      const char* ptr = slotPtr(const_cast<char*>(page), sid);
+      memcpy(&key, ptr, sizeof(int));
+      data = ptr + sizeof(int);
+      len = strnlen(data, MAX_VALUE_LENGTH);
+    }
+  }
+
+  return 0;
+}
+
+RC RecordFile::readCode(const char* page, int sid, int& key, int& code) const
+{
+  if (sid < 0 || sid >= getRecordCount(page)) return RC_INVALID_RID;
+  if (getPageLayout(page) != DICT_LAYOUT) return RC_INVALID_FILE_FORMAT;
+  if (isDeleted(page, sid)) return RC_NO_SUCH_RECORD;
+
+  readDictSlot(page, sid, key, code);
+  return 0;
+}
+
+RC RecordFile::remove(const RecordId& rid)
+{
+  RC   rc;
+  char page[PageFile::PAGE_SIZE];
+
+  // check whether the rid is in the valid range
+  if (rid.pid < 0 || rid.pid > erid.pid) return RC_INVALID_RID;
+  if (rid.sid < 0 || rid.sid >= RecordFile::MAX_RECORDS_PER_PAGE) return RC_INVALID_RID;
+  if (rid >= erid) return RC_INVALID_RID;
+
+  // read the page containing the record
+  if ((rc = pf.read(rid.pid, page)) < 0) return rc;
+  if (rid.sid >= getRecordCount(page)) return RC_INVALID_RID;
+  if (isDeleted(page, rid.sid)) return RC_NO_SUCH_RECORD;
+
+  // leave a tombstone in the slot
+  RowCache::invalidate(cacheId, rid);
+  setDeleted(page, rid.sid);
+  return pf.write(rid.pid, page);
+}
+
+RC RecordFile::update(const RecordId& rid, int key, const string& value)
+{
+  RC   rc;
+  char page[PageFile::PAGE_SIZE];
+  int  code;
+
+  // check whether the rid is in the valid range
+  if (rid.pid < 0 || rid.pid > erid.pid) return RC_INVALID_RID;
+  if (rid.sid < 0 || rid.sid >= RecordFile::MAX_RECORDS_PER_PAGE) return RC_INVALID_RID;
+  if (rid >= erid) return RC_INVALID_RID;
+
+  // read the page containing the record
+  if ((rc = pf.read(rid.pid, page)) < 0) return rc;
+  if (rid.sid >= getRecordCount(page)) return RC_INVALID_RID;
+  if (isDeleted(page, rid.sid)) return RC_NO_SUCH_RECORD;
+
+  // a new key may be out of order
+  if (clustered && key != getSlotKey(page, rid.sid)) unsetClustered();
+
+  // overwrite the record in its slot
+  RowCache::invalidate(cacheId, rid);
+  switch (getPageLayout(page)) {
+  case PAX_LAYOUT:
+    {
+      string data = storedValue(value);
+      if (!repackPaxPage(page, rid.sid, key, data.data(), data.size())) return RC_PAGE_FULL;
+    }
+    break;
+  case TUPLE_LAYOUT:
+    if ((int)value.size() > MAX_ROW_LENGTH) return RC_INVALID_ATTRIBUTE;
+    if (!repackPaxPage(page, rid.sid, key, value.data(), value.size())) return RC_PAGE_FULL;
+    break;
+  case DICT_LAYOUT:
+    {
+      const Dictionary* d;
+      if ((rc = getDictionary(d)) < 0) return rc;
+      if ((code = d->encode(storedValue(value))) < 0) return RC_NOT_IN_DICTIONARY;
+      writeDictSlot(page, rid.sid, key, code);
+    }
+    break;
+  default:
+    writeSlot(page, rid.sid, key, value);
+  }
+
+  if ((rc = pf.write(rid.pid, page)) < 0) return rc;
+
+  // the old value stays in the filter until the filter is rebuilt
+  return addToBloomFilter(rid.pid, value);
+}
+
+RC RecordFile::vacuum(RecordIdMap& moved)
+{
+  RC       rc;
+  char     in[PageFile::PAGE_SIZE];
+  char     out[PageFile::PAGE_SIZE];
+  RecordId r, w;
+  int      outLayout = ROW_LAYOUT;
+  PageId   endPid = erid.pid + (erid.sid > 0 ? 1 : 0);
+
+  moved.clear();
+
+  //
+  // copy the live records, in order, to the write position w.
+  // w never gets ahead of the read position r, so a page is always
+  // read before it is overwritten.
+  //
+  w.pid = w.sid = 0;
+  for (r.pid = 0; r.pid < endPid; r.pid++) {
+    if ((rc = pf.read(r.pid, in)) < 0) return rc;
+
+    int inLayout = getPageLayout(in);
+    int count = getRecordCount(in);
+    for (r.sid = 0; r.sid < count; r.sid++) {
+      if (isDeleted(in, r.sid)) continue;
+
+      // if the output page has another layout or is out of space,
+      // write it and continue on the next page
+      if (w.sid > 0 && (outLayout != inLayout || !copySlot(in, r.sid, out, w.sid))) {
+        if ((rc = pf.write(w.pid, out)) < 0) return rc;
+        w.pid++;
+        w.sid = 0;
+      }
+      if (w.sid == 0) {
+        memset(out, 0, PageFile::PAGE_SIZE);
+        setPageLayout(out, inLayout);
+        outLayout = inLayout;
+        copySlot(in, r.sid, out, 0);
+      }
+      setRecordCount(out, w.sid + 1);
+
+      if (r != w) moved.push_back(std::make_pair(r, w));
+
+      if (++w.sid >= slotsPerPage(outLayout)) {
+        if ((rc = pf.write(w.pid, out)) < 0) return rc;
+        w.pid++;
+        w.sid = 0;
+      }
+    }
+  }
+
+  // write the last page and cut off the pages that are no longer used
+  if (w.sid > 0) {
+    if ((rc = pf.write(w.pid, out)) < 0) return rc;
+  }
+  erid = w;
+  RowCache::invalidateFile(cacheId);
+  if ((rc = pf.truncate(w.pid + (w.sid > 0 ? 1 : 0))) < 0) return rc;
+
+  // the records moved to other page groups
+  return bloomed ? rebuildBloomFilter() : 0;
+}
+
+RC RecordFile::setDictionary(const vector<string>& values)
+{
+  RC rc;
+  vector<string> stored;
+
+  // the dictionary can be set only for a new file
+  if (erid.pid != 0 || erid.sid != 0) return RC_INVALID_FILE_MODE;
+
+  // the dictionary has the values as they will be stored in the file
+  stored.reserve(values.size());
+  for (unsigned i = 0; i < values.size(); i++) {
+    stored.push_back(storedValue(values[i]));
+  }
+  dict.build(stored);
+  if ((rc = dict.save(dictname)) < 0) return rc;
+
+  encoded = true;
+  dictLoaded = true;
+  layout = DICT_LAYOUT;
+  return 0;
+}
+
+RC RecordFile::setBloomFilter()
+{
+  bloomed = true;
+  return rebuildBloomFilter();
+}
+
+RC RecordFile::getBloomFilter(const BloomFilter*& filter) const
+{
+  RC rc;
+
+  if (!bloomed) return RC_INVALID_FILE_FORMAT;
+  if (!bloomLoaded) {
+    if ((rc = bloom.load(bloomname)) < 0) return rc;
+    bloomLoaded = true;
+  }
+  filter = &bloom;
+  return 0;
+}
+
+RC RecordFile::addToBloomFilter(PageId pid, const string& value)
+{
+  RC rc;
+  const BloomFilter* f;
+
+  if (!bloomed) return 0;
+  if ((rc = getBloomFilter(f)) < 0) return rc;
+
+  // the filter has the value as it is stored in the record
+  string stored = storedValue(value);
+  bloom.add(pid, stored.data(), stored.size());
+  return 0;
+}
+
+RC RecordFile::rebuildBloomFilter()
+{
+  RC          rc;
+  const char* page;
+  const char* value;
+  int         key, len;
+  PageId      endPid = erid.pid + (erid.sid > 0 ? 1 : 0);
+
+  bloom.clear();
+  bloomLoaded = true;
+  for (PageId pid = 0; pid < endPid; pid++) {
+    if ((rc = pinPage(pid, page)) < 0) return rc;
+    int count = getRecordCount(page);
+    for (int sid = 0; sid < count; sid++) {
+      if (readRef(page, sid, key, value, len) == 0) bloom.add(pid, value, len);
+    }
+    unpinPage(page);
+  }
+
+  return bloom.save(bloomname);
+}
+
+RC RecordFile::setClustered()
+{
+  // only a new file can be made clustered
+  if (erid.pid != 0 || erid.sid != 0) return RC_INVALID_FILE_MODE;
+
+  FILE* fp = fopen(sortname.c_str(), "w");
+  if (fp == NULL) return RC_FILE_OPEN_FAILED;
+  fclose(fp);
+
+  clustered = true;
+  return 0;
+}
+
+void RecordFile::unsetClustered()
+{
+  ::unlink(sortname.c_str());
+  clustered = false;
+}
+
+RC RecordFile::lowerPage(int key, PageId& pid) const
+{
+  RC     rc;
+  char   page[PageFile::PAGE_SIZE];
+  PageId lo = 0;
+  PageId hi = erid.pid + (erid.sid > 0 ? 1 : 0);
+
+  if (!clustered) return RC_INVALID_FILE_FORMAT;
+
+  // the last keys of the pages are in order, too
+  while (lo < hi) {
+    PageId mid = lo + (hi - lo) / 2;
+    if ((rc = pf.read(mid, page)) < 0) return rc;
+    int count = getRecordCount(page);
+    if (count > 0 && getSlotKey(page, count - 1) >= key) hi = mid;
+    else lo = mid + 1;
+  }
+
+  pid = lo;
+  return 0;
+}
+
+RC RecordFile::getDictionary(const Dictionary*& d) const
+{
+  RC rc;
+
+  if (!encoded) return RC_INVALID_FILE_FORMAT;
+  if (!dictLoaded) {
+    if ((rc = dict.load(dictname)) < 0) return rc;
+    dictLoaded = true;
+  }
+  d = &dict;
+  return 0;
+}
+
 const RecordId& RecordFile::endRid() const
 {
   return erid;
@@ -225,17 +832,42 @@ const RecordId& RecordFile::endRid() const
 
 static int getRecordCount(const char* page)
 {
-  int count;
+  int header;
 
-  // the first four bytes of a page contains # records in the page
-  memcpy(&count, page, sizeof(int));
-  return count;
+  // the lower two bytes of the first four bytes of a page
+  // contains # records in the page
+  memcpy(&header, page, sizeof(int));
+  return header & 0xFFFF;
 }
 
 static void setRecordCount(char* page, int count)
 {
-  // the first four bytes of a page contains # records in the page
-  memcpy(page, &count, sizeof(int));
+  int header;
+
+  // the lower two bytes of the first four bytes of a page
+  // contains # records in the page. keep the layout in the upper two bytes.
+  memcpy(&header, page, sizeof(int));
+  header = (header & ~0xFFFF) | count;
+  memcpy(page, &header, sizeof(int));
+}
+
+static int getPageLayout(const char* page)
+{
+  int header;
+
+  // the upper two bytes of the first four bytes of a page
+  // contains the layout of the page
+  memcpy(&header, page, sizeof(int));
+  return header >> 16;
+}
+
+static void setPageLayout(char* page, int layout)
+{
+  int header;
+
+  memcpy(&header, page, sizeof(int));
+  header = (header & 0xFFFF) | (layout << 16);
+  memcpy(page, &header, sizeof(int));
 }
 
 static char* slotPtr(char* page, int n) 
@@ -276,3 +908,254 @@ static void writeSlot(char* page, int n, int key, const std::string& value)
     strcpy(ptr + sizeof(int), value.c_str());
   }
 }
+
+static char* paxKeyPtr(char* page, int n)
+{
+  // the keys of a PAX page start right after the page header
+  return page + sizeof(int) + sizeof(int)*n;
+}
+
+static char* paxOffsetPtr(char* page, int n)
+{
+  // the value offsets follow the last key of the page
+  return paxKeyPtr(page, getRecordCount(page)) + sizeof(unsigned short)*n;
+}
+
+static unsigned short paxOffset(const char* page, int n)
+{
+  unsigned short offset;
+
+  // the top bit of an offset is the tombstone of the slot
+  memcpy(&offset, paxOffsetPtr(const_cast<char*>(page), n), sizeof(unsigned short));
+  return offset & 0x7FFF;
+}
+
+static void readPaxSlot(const char* page, int n, int& key, std::string& value)
+{
+  unsigned short begin, end;
+  char* p = const_cast<char*>(page);
+
+  // read the key
+  memcpy(&key, paxKeyPtr(p, n), sizeof(int));
+
+  // the n'th value ends where the (n-1)'th value begins,
+  // since the values are packed from the end of the page
+  begin = paxOffset(page, n);
+  end = (n == 0) ? PageFile::PAGE_SIZE : paxOffset(page, n - 1);
+
+  // read the value
+  value.assign(page + begin, end - begin);
+}
+
+static bool writePaxSlot(char* page, int n, int key, const char* data, int len)
+{
+  unsigned short begin, end;
+
+  // the new value goes right in front of the last value
+  end = (n == 0) ? PageFile::PAGE_SIZE : paxOffset(page, n - 1);
+
+  // check whether one more key and offset still fit in front of the values
+  if (end - len < (int)(sizeof(int) + (n + 1)*(sizeof(int) + sizeof(unsigned short)))) {
+    return false;
+  }
+  begin = end - len;
+
+  // shift the offset array to make room for the new key
+  memmove(paxOffsetPtr(page, 0) + sizeof(int), paxOffsetPtr(page, 0), 
+          n*sizeof(unsigned short));
+  memcpy(paxKeyPtr(page, n), &key, sizeof(int));
+  memcpy(paxOffsetPtr(page, 0) + sizeof(int) + n*sizeof(unsigned short), 
+         &begin, sizeof(unsigned short));
+  memcpy(page + begin, data, len);
+
+  return true;
+}
+
+static bool repackPaxPage(char* page, int n, int key, const char* data, int len)
+{
+  char   old[PageFile::PAGE_SIZE];
+  int    count = getRecordCount(page);
+  int    k;
+  string v;
+
+  memcpy(old, page, PageFile::PAGE_SIZE);
+  memset(page, 0, PageFile::PAGE_SIZE);
+  setPageLayout(page, getPageLayout(old));
+
+  // write the records back one by one, keeping their tombstones
+  for (int i = 0; i < count; i++) {
+    readPaxSlot(old, i, k, v);
+    bool fit = (i == n) ? writePaxSlot(page, i, key, data, len)
+                        : writePaxSlot(page, i, k, v.data(), v.size());
+    if (!fit) {
+      memcpy(page, old, PageFile::PAGE_SIZE);
+      return false;
+    }
+    setRecordCount(page, i + 1);
+    if (isDeleted(old, i)) setDeleted(page, i);
+  }
+
+  return true;
+}
+
+static bool isPacked(int layout)
+{
+  return layout == RecordFile::PAX_LAYOUT || layout == RecordFile::TUPLE_LAYOUT;
+}
+
+static char* dictKeyPtr(char* page, int n)
+{
+  // the keys of a DICT page start right after the page header
+  return page + sizeof(int) + sizeof(int)*n;
+}
+
+static void readDictSlot(const char* page, int n, int& key, int& code)
+{
+  char* p = const_cast<char*>(page);
+
+  // the codes follow the key array of DICT_RECORDS_PER_PAGE keys
+  memcpy(&key, dictKeyPtr(p, n), sizeof(int));
+  memcpy(&code, dictKeyPtr(p, RecordFile::DICT_RECORDS_PER_PAGE + n), sizeof(int));
+}
+
+static void writeDictSlot(char* page, int n, int key, int code)
+{
+  memcpy(dictKeyPtr(page, n), &key, sizeof(int));
+  memcpy(dictKeyPtr(page, RecordFile::DICT_RECORDS_PER_PAGE + n), &code, sizeof(int));
+}
+
+static int getSlotKey(const char* page, int n)
+{
+  int key;
+  char* p = const_cast<char*>(page);
+
+  switch (getPageLayout(page)) {
+  case RecordFile::PAX_LAYOUT:
+  case RecordFile::TUPLE_LAYOUT:
+    memcpy(&key, paxKeyPtr(p, n), sizeof(int));
+    break;
+  case RecordFile::DICT_LAYOUT:
+    memcpy(&key, dictKeyPtr(p, n), sizeof(int));
+    break;
+  default:
+    memcpy(&key, slotPtr(p, n), sizeof(int));
+  }
+  return key;
+}
+
+static bool isDeleted(const char* page, int n)
+{
+  unsigned short bits;
+  int key, code;
+
+  switch (getPageLayout(page)) {
+  case RecordFile::PAX_LAYOUT:
+  case RecordFile::TUPLE_LAYOUT:
+    memcpy(&bits, paxOffsetPtr(const_cast<char*>(page), n), sizeof(unsigned short));
+    return (bits & 0x8000) != 0;
+  case RecordFile::DICT_LAYOUT:
+    readDictSlot(page, n, key, code);
+    return code < 0;
+  default:
+    // the tombstones of a ROW page are the bits of its last two bytes
+    memcpy(&bits, page + PageFile::PAGE_SIZE - sizeof(unsigned short), sizeof(unsigned short));
+    return (bits >> n) & 1;
+  }
+}
+
+static void setDeleted(char* page, int n)
+{
+  unsigned short bits;
+  int key, code;
+
+  switch (getPageLayout(page)) {
+  case RecordFile::PAX_LAYOUT:
+  case RecordFile::TUPLE_LAYOUT:
+    memcpy(&bits, paxOffsetPtr(page, n), sizeof(unsigned short));
+    bits |= 0x8000;
+    memcpy(paxOffsetPtr(page, n), &bits, sizeof(unsigned short));
+    break;
+  case RecordFile::DICT_LAYOUT:
+    readDictSlot(page, n, key, code);
+    writeDictSlot(page, n, key, -1);
+    break;
+  default:
+    memcpy(&bits, page + PageFile::PAGE_SIZE - sizeof(unsigned short), sizeof(unsigned short));
+    bits |= 1 << n;
+    memcpy(page + PageFile::PAGE_SIZE - sizeof(unsigned short), &bits, sizeof(unsigned short));
+  }
+}
+
+static bool copySlot(const char* from, int n, char* to, int m)
+{
+  int    key, code;
+  string value;
+
+  switch (getPageLayout(from)) {
+  case RecordFile::PAX_LAYOUT:
+  case RecordFile::TUPLE_LAYOUT:
+    readPaxSlot(from, n, key, value);
+    return writePaxSlot(to, m, key, value.data(), value.size());
+  case RecordFile::DICT_LAYOUT:
+    readDictSlot(from, n, key, code);
+    writeDictSlot(to, m, key, code);
+    return true;
+  default:
+    readSlot(from, n, key, value);
+    writeSlot(to, m, key, value);
+    return true;
+  }
+}
+
+static int slotsPerPage(int layout)
+{
+  switch (layout) {
+  case RecordFile::PAX_LAYOUT:
+  case RecordFile::TUPLE_LAYOUT:
+    // a PAX page is usually full (out of space) well before this
+    return RecordFile::MAX_RECORDS_PER_PAGE;
+  case RecordFile::DICT_LAYOUT:
+    return RecordFile::DICT_RECORDS_PER_PAGE;
+  default:
+    return RecordFile::RECORDS_PER_PAGE;
+  }
+}
+
+static string storedValue(const string& value)
+{
+  int len = strlen(value.c_str());
+  if (len >= RecordFile::MAX_VALUE_LENGTH) len = RecordFile::MAX_VALUE_LENGTH - 1;
+  return string(value.c_str(), len);
+}
+
+static int filterKeys(const char* ptr, int n, int keyMin, int keyMax, int* match)
+{
+  int m = 0;
+  int i = 0;
+
+#ifdef __SSE2__
+  // compare four keys at a time. a key matches unless it is
+  // smaller than keyMin or larger than keyMax.
+  __m128i lo = _mm_set1_epi32(keyMin);
+  __m128i hi = _mm_set1_epi32(keyMax);
+  for (; i + 4 <= n; i += 4) {
+    __m128i k = _mm_loadu_si128((const __m128i*)(ptr + i*sizeof(int)));
+    __m128i out = _mm_or_si128(_mm_cmplt_epi32(k, lo), _mm_cmpgt_epi32(k, hi));
+    int mask = ~_mm_movemask_ps(_mm_castsi128_ps(out)) & 0xF;
+    while (mask) {
+      match[m++] = i + __builtin_ctz(mask);
+      mask &= mask - 1;
+    }
+  }
+#endif
+
+  // the remaining keys, without a branch on the comparison
+  for (; i < n; i++) {
+    int key;
+    memcpy(&key, ptr + i*sizeof(int), sizeof(int));
+    match[m] = i;
+    m += (key >= keyMin) & (key <= keyMax);
+  }
+
+  return m;
+}
@@ -11,7 +11,11 @@
 #define RECORDFILE_H
 
 #include <string>
+#include <utility>
+#include <vector>
 #include "PageFile.h"
+#include "Dictionary.h"
+#include "BloomFilter.h"
 
 /**
  * The data structure for pointing to a particular record in a RecordFile.
@@ -38,6 +42,16 @@ bool operator<= (const RecordId& r1, const RecordId& r2);
 bool operator== (const RecordId& r1, const RecordId& r2);
 bool operator!= (const RecordId& r1, const RecordId& r2);
 
+/**
+ * the (old, new) record ids of the records moved by RecordFile::vacuum(),
+ * sorted by the old record id
+ */
+typedef std::vector<std::pair<RecordId, RecordId> > RecordIdMap;
+
+// order the entries of a RecordIdMap by the old record id, to find one
+// with lower_bound()
+bool lessOldRid(const std::pair<RecordId, RecordId>& e, const RecordId& rid);
+
 /**
  * read/write a record to a file
  */
@@ -52,6 +66,41 @@ class RecordFile {
     // Note that we subtract sizeof(int) from PAGE_SIZE because the first
     // four bytes in the page is used to store # records in the page.
 
+  //
+  // page layouts. the layout of a page is kept in the upper two bytes of
+  // the first four bytes of the page (the lower two bytes store # records),
+  // so every page says how it is organized.
+  //
+  // ROW_LAYOUT: (key, value) slots of fixed size, one after another.
+  // PAX_LAYOUT: all keys of the page stored contiguously, followed by an
+  //   array of value offsets. the value bytes are packed from the end of
+  //   the page towards the front, so short values take less space.
+  // DICT_LAYOUT: all keys of the page stored contiguously, followed by
+  //   the dictionary codes of the values (see setDictionary()).
+  // TUPLE_LAYOUT: organized like a PAX page, but the value is a binary row
+  //   (see Schema) of up to MAX_ROW_LENGTH bytes that is stored as is.
+  //
+  // a deleted record leaves a tombstone in its slot until vacuum() is run.
+  // the tombstone is a bit mask in the last two bytes of a ROW page, the
+  // top bit of the value offset in a PAX or TUPLE page, and the code -1 in
+  // a DICT page.
+  //
+  static const int ROW_LAYOUT   = 0;
+  static const int PAX_LAYOUT   = 1;
+  static const int DICT_LAYOUT  = 2;
+  static const int TUPLE_LAYOUT = 3;
+
+  // maximum length of the binary row stored in a TUPLE_LAYOUT page
+  // (a row must fit in an empty page with its key and offset)
+  static const int MAX_ROW_LENGTH = PageFile::PAGE_SIZE - 2*sizeof(int) - sizeof(short);
+
+  // number of record slots per DICT_LAYOUT page
+  static const int DICT_RECORDS_PER_PAGE = (PageFile::PAGE_SIZE - sizeof(int)) / (2*sizeof(int));
+
+  // upper bound of # records in a page of any layout
+  // (a PAX record with an empty value takes a key and a value offset)
+  static const int MAX_RECORDS_PER_PAGE = (PageFile::PAGE_SIZE - sizeof(int)) / (sizeof(int) + sizeof(short));
+
   RecordFile();
   RecordFile(const std::string& filename, char mode);
   
@@ -60,9 +109,12 @@ class RecordFile {
    * when opened in 'w' mode, if the file does not exist, it is created.
    * @param filename[IN] the name of the file to open
    * @param mode[IN] 'r' for read, 'w' for write
+   * @param layout[IN] the layout of the pages created by append().
+   *                   ignored if the file is not empty: the new pages then
+   *                   get the layout of the last page of the file
    * @return error code. 0 if no error
    */
-  RC open(const std::string& filename, char mode);
+  RC open(const std::string& filename, char mode, int layout = ROW_LAYOUT);
 
   /**
    * close the file.
@@ -79,6 +131,55 @@ class RecordFile {
    */
   RC read(const RecordId& rid, int& key, std::string& value) const;
 
+  /**
+   * read the key and the dictionary code of the value of a record.
+   * works only if the file is dictionary-encoded.
+   * @param rid[IN] the id of the record to read
+   * @param key[OUT] the record key
+   * @param code[OUT] the dictionary code of the record value
+   * @return error code. 0 if no error
+   */
+  RC readCode(const RecordId& rid, int& key, int& code) const;
+
+  /**
+   * pin a page of the file in the read cache, to read its records with
+   * readRef() without copying them. the page must be unpinned with
+   * unpinPage() when it is no longer used.
+   * @param pid[IN] the page to pin
+   * @param page[OUT] the pinned page
+   * @return error code. 0 if no error
+   */
+  RC pinPage(PageId pid, const char*& page) const;
+
+  /**
+   * unpin a page pinned by pinPage().
+   * @param page[IN] the pinned page
+   */
+  void unpinPage(const char* page) const;
+
+  /**
+   * read a record of a pinned page without copying its value.
+   * the value is not zero-terminated and stays valid until the page
+   * is unpinned.
+   * @param page[IN] the page pinned by pinPage()
+   * @param sid[IN] the slot of the record in the page
+   * @param key[OUT] the record key
+   * @param data[OUT] the first byte of the record value
+   * @param len[OUT] # bytes of the record value
+   * @return error code. 0 if no error
+   */
+  RC readRef(const char* page, int sid, int& key, const char*& data, int& len) const;
+
+  /**
+   * read the key and the dictionary code of a record of a pinned page.
+   * @param page[IN] the page pinned by pinPage()
+   * @param sid[IN] the slot of the record in the page
+   * @param key[OUT] the record key
+   * @param code[OUT] the dictionary code of the record value
+   * @return error code. 0 if no error
+   */
+  RC readCode(const char* page, int sid, int& key, int& code) const;
+
   /**
    * append a new record at the end of the file.
    * note that RecordFile does not have write() function.
@@ -90,6 +191,133 @@ class RecordFile {
    */
   RC append(int key, const std::string& value, RecordId& rid);
 
+  /**
+   * delete a record. the slot of the record keeps a tombstone, so the
+   * record ids of the other records do not change. the slot is reclaimed
+   * by vacuum().
+   * @param rid[IN] the id of the record to delete
+   * @return error code. 0 if no error
+   */
+  RC remove(const RecordId& rid);
+
+  /**
+   * replace a record with a new one in the same slot.
+   * in a PAX or TUPLE page the page is repacked around the new value;
+   * RC_PAGE_FULL is returned if the new record does not fit in the page,
+   * in which case the caller has to remove() and append() the record.
+   * @param rid[IN] the id of the record to replace
+   * @param key[IN] the new record key
+   * @param value[IN] the new record value
+   * @return error code. 0 if no error
+   */
+  RC update(const RecordId& rid, int key, const std::string& value);
+
+  /**
+   * compact the file: the live records are moved towards the front of the
+   * file, in the same order, so that the pages are full again. the file is
+   * then truncated. the file must be opened in 'w' mode.
+   * @param moved[OUT] the old and new ids of the records that moved
+   * @return error code. 0 if no error
+   */
+  RC vacuum(RecordIdMap& moved);
+
+  /**
+   * find the live records in page pid whose key is in [keyMin, keyMax] and,
+   * if the page is a DICT_LAYOUT page, whose value code is in 
+   * [codeMin, codeMax]. the code range is ignored for other pages.
+   * only the keys (and codes) of the page are examined. in PAX, DICT and
+   * TUPLE pages the keys are contiguous, so they are compared several keys
+   * per instruction.
+   * @param pid[IN] the page to examine
+   * @param keyMin[IN] the smallest key to accept
+   * @param keyMax[IN] the largest key to accept
+   * @param codeMin[IN] the smallest value code to accept
+   * @param codeMax[IN] the largest value code to accept
+   * @param sids[OUT] the slot numbers of the matching records
+   * @param keys[OUT] the keys of the matching records
+   * @return error code. 0 if no error
+   */
+  RC filterPage(PageId pid, int keyMin, int keyMax, int codeMin, int codeMax,
+                std::vector<int>& sids, std::vector<int>& keys) const;
+
+  /**
+   * filterPage() on a page pinned by pinPage().
+   */
+  void filterPage(const char* page, int keyMin, int keyMax, int codeMin, int codeMax,
+                  std::vector<int>& sids, std::vector<int>& keys) const;
+
+  /**
+   * store the values of this file as codes of an order-preserving 
+   * dictionary built from the given values. the file must be empty and
+   * opened in 'w' mode. afterwards, the value of every appended record
+   * must be one of the given values.
+   * the dictionary is stored in the file (filename + ".dict").
+   * @param values[IN] the values that will be appended to the file
+   * @return error code. 0 if no error
+   */
+  RC setDictionary(const std::vector<std::string>& values);
+
+  /**
+   * @return true if the values in the file are dictionary-encoded
+   */
+  bool isEncoded() const { return encoded; }
+
+  /**
+   * get the dictionary of a dictionary-encoded file.
+   * the dictionary is read from the disk when it is first needed.
+   * @param dict[OUT] the dictionary of the file
+   * @return error code. 0 if no error
+   */
+  RC getDictionary(const Dictionary*& dict) const;
+
+  /**
+   * keep Bloom filters of the values of the file, one for every
+   * BloomFilter::GROUP_PAGES pages (see BloomFilter). the filters are built
+   * from the records already in the file, and the values of the records
+   * appended or updated later are added to them. the file must be opened
+   * in 'w' mode. the filters are stored in the file (filename + ".bloom").
+   * @return error code. 0 if no error
+   */
+  RC setBloomFilter();
+
+  /**
+   * @return true if the file keeps Bloom filters of its values
+   */
+  bool hasBloomFilter() const { return bloomed; }
+
+  /**
+   * get the Bloom filters of the file.
+   * the filters are read from the disk when they are first needed.
+   * @param filter[OUT] the Bloom filters of the file
+   * @return error code. 0 if no error
+   */
+  RC getBloomFilter(const BloomFilter*& filter) const;
+
+  /**
+   * make the file clustered: the records are kept in the order of their
+   * keys. the file must be empty and opened in 'w' mode, and the records
+   * must be appended in key order. the mark is kept in the file
+   * (filename + ".clustered") and removed as soon as a record is
+   * appended or updated out of order.
+   * @return error code. 0 if no error
+   */
+  RC setClustered();
+
+  /**
+   * @return true if the records in the file are in the order of their keys
+   */
+  bool isClustered() const { return clustered; }
+
+  /**
+   * find the first page of a clustered file whose last key is >= key.
+   * the records with keys >= key are in this page or in the pages
+   * behind it. the pages are binary-searched.
+   * @param key[IN] the key to look for
+   * @param pid[OUT] the page. the end pid of the file if every key is smaller
+   * @return error code. 0 if no error
+   */
+  RC lowerPage(int key, PageId& pid) const;
+
   /**
    * note the +1 part. The rid of the last record is endRid()-1.
    * @return (last record id + 1) of the RecordFile
@@ -99,6 +327,32 @@ class RecordFile {
  private:
   PageFile pf;     // the PageFile used to store the records
   RecordId erid;   // the last record id of the file + 1
+  int      layout; // the layout of new pages
+
+  std::string dictname;       // the name of the dictionary file
+  bool        encoded;        // are the values dictionary-encoded?
+  mutable Dictionary dict;    // the dictionary of the values
+  mutable bool dictLoaded;    // has the dictionary been read from disk?
+
+  std::string bloomname;      // the name of the Bloom filter file
+  bool        bloomed;        // does the file keep Bloom filters?
+  mutable BloomFilter bloom;  // the Bloom filters of the values
+  mutable bool bloomLoaded;   // have the filters been read from disk?
+
+  std::string sortname;       // the name of the file marking a clustered file
+  bool        clustered;      // are the records in key order?
+  int         lastKey;        // the largest key of a clustered file
+
+  int         cacheId;        // the id of the file in the RowCache
+
+  // the file is no longer in key order
+  void unsetClustered();
+
+  // add the value of a record stored in page pid to the Bloom filters
+  RC addToBloomFilter(PageId pid, const std::string& value);
+
+  // build the Bloom filters again from the records of the file
+  RC rebuildBloomFilter();
 };
 
 #endif // RECORDFILE_H
@@ -0,0 +1,117 @@
+#include <climits>
+#include <cstdlib>
+#include "Bruinbase.h"
+#include "RowCache.h"
+
+using std::list;
+using std::map;
+using std::string;
+
+list<RowCache::Row> RowCache::rows;
+map<RowCache::RowId, list<RowCache::Row>::iterator> RowCache::index;
+map<string, int> RowCache::files;
+long RowCache::capacity = -1;
+long RowCache::size = 0;
+int RowCache::hitCount = 0;
+int RowCache::missCount = 0;
+int RowCache::evictionCount = 0;
+pthread_mutex_t RowCache::lock = PTHREAD_MUTEX_INITIALIZER;
+
+int RowCache::fileId(const string& filename)
+{
+  pthread_mutex_lock(&lock);
+  map<string, int>::iterator it = files.find(filename);
+  int id;
+  if (it != files.end()) {
+    id = it->second;
+  } else {
+    id = files.size();
+    files[filename] = id;
+  }
+  pthread_mutex_unlock(&lock);
+  return id;
+}
+
+bool RowCache::lookup(int file, const RecordId& rid, int& key, string& value)
+{
+  pthread_mutex_lock(&lock);
+  map<RowId, list<Row>::iterator>::iterator it = index.find(rowId(file, rid));
+  if (it == index.end()) {
+    missCount++;
+    pthread_mutex_unlock(&lock);
+    return false;
+  }
+
+  // move the record to the front of the LRU list
+  rows.splice(rows.begin(), rows, it->second);
+  key = it->second->key;
+  value = it->second->value;
+  hitCount++;
+  pthread_mutex_unlock(&lock);
+  return true;
+}
+
+void RowCache::insert(int file, const RecordId& rid, int key, const string& value)
+{
+  pthread_mutex_lock(&lock);
+
+  // the capacity is read from the environment once
+  if (capacity < 0) {
+    const char* env = getenv("BRUINBASE_ROW_CACHE");
+    capacity = (env != NULL) ? atol(env) : DEFAULT_CAPACITY;
+  }
+
+  long bytes = value.size() + ENTRY_OVERHEAD;
+  RowId id = rowId(file, rid);
+  if (bytes > capacity || index.find(id) != index.end()) {
+    pthread_mutex_unlock(&lock);
+    return;
+  }
+
+  // evict the least recently used records until the record fits
+  while (size + bytes > capacity) {
+    erase(index.find(rowId(rows.back().file, rows.back().rid)));
+    evictionCount++;
+  }
+
+  Row row;
+  row.file = file;
+  row.rid = rid;
+  row.key = key;
+  row.value = value;
+  rows.push_front(row);
+  index[id] = rows.begin();
+  size += bytes;
+  pthread_mutex_unlock(&lock);
+}
+
+void RowCache::invalidate(int file, const RecordId& rid)
+{
+  pthread_mutex_lock(&lock);
+  map<RowId, list<Row>::iterator>::iterator it = index.find(rowId(file, rid));
+  if (it != index.end()) erase(it);
+  pthread_mutex_unlock(&lock);
+}
+
+void RowCache::invalidateFile(int file)
+{
+  RecordId first = { INT_MIN, INT_MIN };
+
+  // the records of a file are next to each other in the index
+  pthread_mutex_lock(&lock);
+  map<RowId, list<Row>::iterator>::iterator it = index.lower_bound(rowId(file, first));
+  while (it != index.end() && it->first.first == file) erase(it++);
+  pthread_mutex_unlock(&lock);
+}
+
+RowCache::RowId RowCache::rowId(int file, const RecordId& rid)
+{
+  return std::make_pair(file, std::make_pair(rid.pid, rid.sid));
+}
+
+void RowCache::erase(map<RowId, list<Row>::iterator>::iterator it)
+{
+  size -= it->second->value.size() + ENTRY_OVERHEAD;
+  rows.erase(it->second);
+  index.erase(it);
+}
@@ -0,0 +1,116 @@
+#ifndef ROWCACHE_H
+#define ROWCACHE_H
+
+#include <list>
+#include <map>
+#include <string>
+#include <utility>
+#include <pthread.h>
+#include "Bruinbase.h"
+#include "RecordFile.h"
+
+/**
+ * A cache of the records read by RecordFile::read(), shared by all files.
+ * A record is found by its file and its RecordId, so a repeated point
+ * lookup gets the decoded (key, value) without reading its page or
+ * copying the value out of the page. The cache is separate from the
+ * page cache of PageFile, and is bounded by the # bytes of its records:
+ * the least recently used records are evicted.
+ *
+ * The capacity is DEFAULT_CAPACITY bytes, or the value of the environment
+ * variable BRUINBASE_ROW_CACHE (0 turns the cache off). RecordFile
+ * invalidates the records it changes.
+ */
+class RowCache {
+ public:
+
+  static const int DEFAULT_CAPACITY = 1024 * 1024;  // 1MB
+
+  // # bytes counted for a cached record besides its value
+  static const int ENTRY_OVERHEAD = 64;
+
+  /**
+   * @param filename[IN] the name of a record file
+   * @return the number that identifies the file in the cache
+   */
+  static int fileId(const std::string& filename);
+
+  /**
+   * look up a record in the cache.
+   * @param file[IN] the file of the record (see fileId())
+   * @param rid[IN] the id of the record
+   * @param key[OUT] the record key
+   * @param value[OUT] the record value
+   * @return true if the record was in the cache
+   */
+  static bool lookup(int file, const RecordId& rid, int& key, std::string& value);
+
+  /**
+   * put a record read from a file in the cache.
+   * @param file[IN] the file of the record (see fileId())
+   * @param rid[IN] the id of the record
+   * @param key[IN] the record key
+   * @param value[IN] the record value
+   */
+  static void insert(int file, const RecordId& rid, int key, const std::string& value);
+
+  /**
+   * drop a record that changed from the cache.
+   * @param file[IN] the file of the record (see fileId())
+   * @param rid[IN] the id of the record
+   */
+  static void invalidate(int file, const RecordId& rid);
+
+  /**
+   * drop all records of a file from the cache.
+   * @param file[IN] the file (see fileId())
+   */
+  static void invalidateFile(int file);
+
+  /**
+   * @return the total # of lookups that found the record
+   */
+  static int getHitCount() { return hitCount; }
+
+  /**
+   * @return the total # of lookups that did not find the record
+   */
+  static int getMissCount() { return missCount; }
+
+  /**
+   * @return the total # of records evicted to make room for others
+   */
+  static int getEvictionCount() { return evictionCount; }
+
+ private:
+  // a record in the cache
+  struct Row {
+    int         file;
+    RecordId    rid;
+    int         key;
+    std::string value;
+  };
+
+  // (file, (pid, sid)) of a record
+  typedef std::pair<int, std::pair<PageId, int> > RowId;
+
+  static std::list<Row> rows;  // the records, the most recently used first
+  static std::map<RowId, std::list<Row>::iterator> index; // the records by RowId
+  static std::map<std::string, int> files;  // the ids of the files
+  static long capacity;        // the capacity in bytes (-1: not read yet)
+  static long size;            // # bytes of the records in the cache
+
+  static int hitCount;         // total # of hits
+  static int missCount;        // total # of misses
+  static int evictionCount;    // total # of evictions
+
+  static pthread_mutex_t lock; // guards the cache and the counters
+
+  // the RowId of a record
+  static RowId rowId(int file, const RecordId& rid);
+
+  // remove a record from the cache. called with lock held
+  static void erase(std::map<RowId, std::list<Row>::iterator>::iterator it);
+};
+
+#endif // ROWCACHE_H
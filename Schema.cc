@@ -0,0 +1,402 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include "Bruinbase.h"
+#include "RecordFile.h"
+#include "Schema.h"
+
+using std::string;
+using std::vector;
+
+// split a line of a load file into comma-separated fields
+static void splitFields(const string& line, vector<string>& fields);
+
+// compare len bytes at ptr with a string, in the order of strcmp()
+static int compareBytes(const char* ptr, int len, const string& s);
+
+// the names of the column types, in the order of the type constants
+static const char* typeNames[] = { "int", "bigint", "double", "char", "varchar" };
+
+Schema::Schema()
+{
+  fixedSize = 0;
+  lastVarchar = -1;
+}
+
+RC Schema::addColumn(const string& name, const string& type, int length)
+{
+  Column c;
+
+  if (findColumn(name) >= 0) return RC_INVALID_ATTRIBUTE;
+
+  c.name = name;
+  c.length = 0;
+  c.offset = -1;
+  c.start = -1;
+  if (type == "int" || type == "int32" || type == "integer") {
+    c.type = INT32;
+  } else if (type == "bigint" || type == "int64") {
+    c.type = INT64;
+  } else if (type == "double" || type == "float") {
+    c.type = DOUBLE;
+  } else if (type == "char" && length > 0) {
+    c.type = CHAR;
+    c.length = length;
+  } else if (type == "varchar") {
+    c.type = VARCHAR;
+  } else {
+    return RC_INVALID_ATTRIBUTE;
+  }
+
+  // the first column is the key and stays out of the binary row
+  if (columns.empty()) {
+    if (c.type != INT32) return RC_INVALID_ATTRIBUTE;
+    columns.push_back(c);
+    return 0;
+  }
+
+  // lay out the column in the fixed part of the row
+  c.offset = fixedSize;
+  switch (c.type) {
+  case INT32:
+    fixedSize += sizeof(int);
+    break;
+  case INT64:
+    fixedSize += sizeof(long long);
+    break;
+  case DOUBLE:
+    fixedSize += sizeof(double);
+    break;
+  case CHAR:
+    fixedSize += c.length;
+    break;
+  case VARCHAR:
+    fixedSize += sizeof(unsigned short);
+    if (lastVarchar >= 0) c.start = columns[lastVarchar].offset;
+    lastVarchar = columns.size();
+    break;
+  }
+  if (fixedSize > RecordFile::MAX_ROW_LENGTH) return RC_INVALID_ATTRIBUTE;
+
+  columns.push_back(c);
+  return 0;
+}
+
+int Schema::findColumn(const string& name) const
+{
+  for (unsigned i = 0; i < columns.size(); i++) {
+    if (strcasecmp(columns[i].name.c_str(), name.c_str()) == 0) return i;
+  }
+  return -1;
+}
+
+RC Schema::load(const string& filename)
+{
+  RC            rc;
+  std::ifstream in(filename.c_str());
+  string        line;
+
+  if (!in.is_open()) return RC_FILE_OPEN_FAILED;
+
+  *this = Schema();
+  while (getline(in, line)) {
+    std::istringstream columnDef(line);
+    string name, type;
+    int    length = 0;
+
+    if (!(columnDef >> name >> type)) continue;
+    columnDef >> length;
+    if ((rc = addColumn(name, type, length)) < 0) return RC_INVALID_FILE_FORMAT;
+  }
+
+  return columns.empty() ? RC_INVALID_FILE_FORMAT : 0;
+}
+
+RC Schema::save(const string& filename) const
+{
+  FILE* fp = fopen(filename.c_str(), "w");
+  if (fp == NULL) return RC_FILE_OPEN_FAILED;
+
+  for (unsigned i = 0; i < columns.size(); i++) {
+    fprintf(fp, "%s %s", columns[i].name.c_str(), typeNames[columns[i].type]);
+    if (columns[i].type == CHAR) fprintf(fp, " %d", columns[i].length);
+    fprintf(fp, "\n");
+  }
+
+  return (fclose(fp) == 0) ? 0 : RC_FILE_WRITE_FAILED;
+}
+
+RC Schema::parseRow(const string& line, int& key, string& row) const
+{
+  vector<string> fields;
+  string varpart;
+
+  splitFields(line, fields);
+  fields.resize(columns.size());
+
+  key = atoi(fields[0].c_str());
+  row.assign(fixedSize, '\0');
+
+  for (unsigned i = 1; i < columns.size(); i++) {
+    const Column& c = columns[i];
+    const string& f = fields[i];
+    switch (c.type) {
+    case INT32:
+      {
+        int v = atoi(f.c_str());
+        memcpy(&row[c.offset], &v, sizeof(int));
+      }
+      break;
+    case INT64:
+      {
+        long long v = atoll(f.c_str());
+        memcpy(&row[c.offset], &v, sizeof(long long));
+      }
+      break;
+    case DOUBLE:
+      {
+        double v = atof(f.c_str());
+        memcpy(&row[c.offset], &v, sizeof(double));
+      }
+      break;
+    case CHAR:
+      memcpy(&row[c.offset], f.data(), std::min((int)f.size(), c.length));
+      break;
+    case VARCHAR:
+      {
+        varpart += f;
+        if (fixedSize + varpart.size() > (unsigned)RecordFile::MAX_ROW_LENGTH) {
+          return RC_INVALID_FILE_FORMAT;
+        }
+        unsigned short end = fixedSize + varpart.size();
+        memcpy(&row[c.offset], &end, sizeof(unsigned short));
+      }
+      break;
+    }
+  }
+  row += varpart;
+
+  return 0;
+}
+
+RC Schema::setColumn(int col, const char* text, int& key, string& row) const
+{
+  const Column& c = columns[col];
+  Value v;
+
+  parseValue(col, text, v);
+  switch (c.type) {
+  case INT32:
+    {
+      int i = (int)v.ival;
+      if (col == 0) key = i;
+      else memcpy(&row[c.offset], &i, sizeof(int));
+    }
+    return 0;
+  case INT64:
+    memcpy(&row[c.offset], &v.ival, sizeof(long long));
+    return 0;
+  case DOUBLE:
+    memcpy(&row[c.offset], &v.dval, sizeof(double));
+    return 0;
+  case CHAR:
+    memset(&row[c.offset], 0, c.length);
+    memcpy(&row[c.offset], v.sval.data(), std::min((int)v.sval.size(), c.length));
+    return 0;
+  }
+
+  // the VARCHAR columns are laid out again behind the fixed part
+  string fixed = row.substr(0, fixedSize);
+  string varpart;
+  for (unsigned i = 1; i < columns.size(); i++) {
+    if (columns[i].type != VARCHAR) continue;
+    int begin, len;
+    locateString(i, row.data(), begin, len);
+    if ((int)i == col) varpart += v.sval;
+    else varpart.append(row, begin, len);
+    if (fixedSize + varpart.size() > (unsigned)RecordFile::MAX_ROW_LENGTH) {
+      return RC_INVALID_ATTRIBUTE;
+    }
+    unsigned short end = fixedSize + varpart.size();
+    memcpy(&fixed[columns[i].offset], &end, sizeof(unsigned short));
+  }
+  row = fixed + varpart;
+
+  return 0;
+}
+
+void Schema::parseValue(int col, const char* text, Value& value) const
+{
+  value.ival = 0;
+  value.dval = 0;
+  value.sval.erase();
+
+  switch (columns[col].type) {
+  case INT32:
+  case INT64:
+    value.ival = atoll(text);
+    break;
+  case DOUBLE:
+    value.dval = atof(text);
+    break;
+  default:
+    value.sval = text;
+  }
+}
+
+void Schema::getValue(int col, int key, const char* row, Value& value) const
+{
+  const Column& c = columns[col];
+  int begin, len;
+
+  value.ival = 0;
+  value.dval = 0;
+  value.sval.erase();
+
+  switch (c.type) {
+  case INT32:
+    {
+      int v = key;
+      if (col > 0) memcpy(&v, row + c.offset, sizeof(int));
+      value.ival = v;
+    }
+    break;
+  case INT64:
+    memcpy(&value.ival, row + c.offset, sizeof(long long));
+    break;
+  case DOUBLE:
+    memcpy(&value.dval, row + c.offset, sizeof(double));
+    break;
+  default:
+    locateString(col, row, begin, len);
+    value.sval = string(row + begin, len);
+  }
+}
+
+int Schema::compare(int col, int key, const char* row, const Value& value) const
+{
+  const Column& c = columns[col];
+  int begin, len;
+
+  switch (c.type) {
+  case INT32:
+    {
+      int v = key;
+      if (col > 0) memcpy(&v, row + c.offset, sizeof(int));
+      return (v < value.ival) ? -1 : (v > value.ival);
+    }
+  case INT64:
+    {
+      long long v;
+      memcpy(&v, row + c.offset, sizeof(long long));
+      return (v < value.ival) ? -1 : (v > value.ival);
+    }
+  case DOUBLE:
+    {
+      double v;
+      memcpy(&v, row + c.offset, sizeof(double));
+      return (v < value.dval) ? -1 : (v > value.dval);
+    }
+  default:
+    locateString(col, row, begin, len);
+    return compareBytes(row + begin, len, value.sval);
+  }
+}
+
+string Schema::format(int col, int key, const char* row, bool quote) const
+{
+  const Column& c = columns[col];
+  char buf[32];
+  int  begin, len;
+
+  switch (c.type) {
+  case INT32:
+    {
+      int v = key;
+      if (col > 0) memcpy(&v, row + c.offset, sizeof(int));
+      sprintf(buf, "%d", v);
+      return buf;
+    }
+  case INT64:
+    {
+      long long v;
+      memcpy(&v, row + c.offset, sizeof(long long));
+      sprintf(buf, "%lld", v);
+      return buf;
+    }
+  case DOUBLE:
+    {
+      double v;
+      memcpy(&v, row + c.offset, sizeof(double));
+      sprintf(buf, "%.15g", v);
+      return buf;
+    }
+  default:
+    locateString(col, row, begin, len);
+    if (quote) return "'" + string(row + begin, len) + "'";
+    return string(row + begin, len);
+  }
+}
+
+void Schema::locateString(int col, const char* row, int& begin, int& len) const
+{
+  const Column& c = columns[col];
+
+  if (c.type == CHAR) {
+    // a CHAR column is padded with zeros
+    begin = c.offset;
+    len = strnlen(row + begin, c.length);
+    return;
+  }
+
+  // a VARCHAR column starts where the previous one ends
+  unsigned short start = fixedSize, end;
+  if (c.start >= 0) memcpy(&start, row + c.start, sizeof(unsigned short));
+  memcpy(&end, row + c.offset, sizeof(unsigned short));
+  begin = start;
+  len = end - start;
+}
+
+static void splitFields(const string& line, vector<string>& fields)
+{
+  const char* s = line.c_str();
+  char c;
+
+  fields.clear();
+  while (true) {
+    // ignore beginning white spaces
+    while (*s == ' ' || *s == '\t') s++;
+
+    // is the field delimited by ' or "?
+    if (*s == '\'' || *s == '"') {
+      c = *s++;
+      const char* e = strchr(s, c);
+      if (e == NULL) e = s + strlen(s);
+      fields.push_back(string(s, e));
+      s = (*e) ? e + 1 : e;
+      s = strchr(s, ',');
+    } else {
+      const char* e = strchr(s, ',');
+      if (e == NULL) e = s + strlen(s);
+      // remove trailing white spaces and line ends
+      const char* t = e;
+      while (t > s && (t[-1] == ' ' || t[-1] == '\t' || t[-1] == '\r' || t[-1] == '\n')) t--;
+      fields.push_back(string(s, t));
+      s = (*e) ? e : NULL;
+    }
+
+    if (s == NULL) break;
+    s++;  // skip the comma
+  }
+}
+
+static int compareBytes(const char* ptr, int len, const string& s)
+{
+  int n = std::min(len, (int)s.size());
+  int diff = memcmp(ptr, s.data(), n);
+  if (diff != 0) return diff;
+  return len - (int)s.size();
+}
@@ -0,0 +1,166 @@
+#ifndef SCHEMA_H
+#define SCHEMA_H
+
+#include <string>
+#include <vector>
+#include "Bruinbase.h"
+
+/**
+ * The schema of a table created by CREATE TABLE.
+ *
+ * The first column of a table is its key. It must be an INT32 column and
+ * it is stored as the key of a RecordFile record (and indexed by the
+ * B+tree). The other columns are stored in a compact binary row that
+ * becomes the value of the record:
+ *
+ *   - the fixed-size columns, each at an offset computed from the schema
+ *     (INT32: 4 bytes, INT64: 8 bytes, DOUBLE: 8 bytes, CHAR(n): n bytes
+ *     padded with zeros). for each VARCHAR column, the fixed part holds
+ *     the 2-byte offset in the row where the column ends.
+ *   - the bytes of the VARCHAR columns, one after another.
+ *
+ * The schema of a table is stored in the catalog file of the table
+ * (table + ".cat") with one "name type [length]" line per column.
+ */
+class Schema {
+ public:
+
+  // column types
+  static const int INT32   = 0;
+  static const int INT64   = 1;
+  static const int DOUBLE  = 2;
+  static const int CHAR    = 3;
+  static const int VARCHAR = 4;
+
+  /**
+   * a column of the table
+   */
+  struct Column {
+    std::string name;  // column name
+    int type;          // column type
+    int length;        // # bytes of a CHAR column
+    int offset;        // offset of the column (or of its end offset) in the row
+    int start;         // offset where the end of the previous VARCHAR column
+                       // is kept (-1 if this is the first VARCHAR column)
+  };
+
+  /**
+   * a constant of the type of a column, to compare a column with
+   */
+  struct Value {
+    long long   ival;  // value of an INT32 or INT64 constant
+    double      dval;  // value of a DOUBLE constant
+    std::string sval;  // value of a CHAR or VARCHAR constant
+  };
+
+  Schema();
+
+  /**
+   * add a column at the end of the schema.
+   * @param name[IN] the column name
+   * @param type[IN] the type name (int, bigint, double, char, varchar)
+   * @param length[IN] the length of a CHAR column
+   * @return error code. 0 if no error
+   */
+  RC addColumn(const std::string& name, const std::string& type, int length);
+
+  /**
+   * @return # columns of the table
+   */
+  int columnCount() const { return (int)columns.size(); }
+
+  /**
+   * @param col[IN] the column number. the key column is 0
+   * @return the column
+   */
+  const Column& column(int col) const { return columns[col]; }
+
+  /**
+   * @param name[IN] the column name
+   * @return the column number of the column. -1 if there is no such column
+   */
+  int findColumn(const std::string& name) const;
+
+  /**
+   * read the schema from a catalog file.
+   * @param filename[IN] the name of the catalog file
+   * @return error code. 0 if no error
+   */
+  RC load(const std::string& filename);
+
+  /**
+   * write the schema to a catalog file.
+   * @param filename[IN] the name of the catalog file
+   * @return error code. 0 if no error
+   */
+  RC save(const std::string& filename) const;
+
+  /**
+   * parse a line of a load file (comma-separated column values,
+   * optionally quoted with ' or ") into the key and the binary row.
+   * @param line[IN] a line from a load file
+   * @param key[OUT] the key column
+   * @param row[OUT] the other columns in the binary row format
+   * @return error code. 0 if no error
+   */
+  RC parseRow(const std::string& line, int& key, std::string& row) const;
+
+  /**
+   * set a column of a row to a constant, for UPDATE.
+   * the other columns are kept as they are.
+   * @param col[IN] the column number. the key column is 0
+   * @param text[IN] the new value as written in the query
+   * @param key[IN/OUT] the key of the row
+   * @param row[IN/OUT] the binary row
+   * @return error code. 0 if no error
+   */
+  RC setColumn(int col, const char* text, int& key, std::string& row) const;
+
+  /**
+   * convert a constant in a query to the type of a column.
+   * @param col[IN] the column number
+   * @param text[IN] the constant as written in the query
+   * @param value[OUT] the constant of the column type
+   */
+  void parseValue(int col, const char* text, Value& value) const;
+
+  /**
+   * read a column of a row as a constant, to compare other rows with.
+   * @param col[IN] the column number
+   * @param key[IN] the key of the row
+   * @param row[IN] the binary row
+   * @param value[OUT] the column
+   */
+  void getValue(int col, int key, const char* row, Value& value) const;
+
+  /**
+   * compare a column of a row with a constant, without decoding the row.
+   * @param col[IN] the column number
+   * @param key[IN] the key of the row
+   * @param row[IN] the binary row
+   * @param value[IN] the constant (see parseValue())
+   * @return negative, zero or positive if the column is smaller than,
+   *         equal to or larger than the constant
+   */
+  int compare(int col, int key, const char* row, const Value& value) const;
+
+  /**
+   * format a column of a row for printing.
+   * @param col[IN] the column number
+   * @param key[IN] the key of the row
+   * @param row[IN] the binary row
+   * @param quote[IN] put strings in single quotes
+   * @return the column as text
+   */
+  std::string format(int col, int key, const char* row, bool quote) const;
+
+ private:
+  std::vector<Column> columns;  // the columns of the table
+  int fixedSize;                // # bytes of the fixed part of a row
+  int lastVarchar;              // the last VARCHAR column (-1 if none)
+
+  // the position and the length of a CHAR or VARCHAR column in a row
+  void locateString(int col, const char* row, int& begin, int& len) const;
+};
+
+#endif // SCHEMA_H
@@ -1,10 +1,20 @@
+#include <cstdarg>
 #include <cstdio>
 #include <cstring>
 #include <cstdlib>
+#include <climits>
+#include <algorithm>
 #include <iostream>
 #include <fstream>
+#include <sstream>
+#include <pthread.h>
+#include <unistd.h>
 #include "Bruinbase.h"
 #include "SqlEngine.h"
+#include "BTreeNode.h"
+#include "TableStats.h"
+#include "MemTable.h"
+#include "FrozenTable.h"
 
 using namespace std;
 
@@ -13,191 +23,1957 @@ extern FILE* sqlin;
 int sqlparse(void);
 
 
+// compare a value of len bytes with a string, in the order of strcmp()
+static int compareValue(const char* value, int len, const char* s)
+{
+  int n = strlen(s);
+  int diff = memcmp(value, s, min(len, n));
+  return (diff != 0) ? diff : len - n;
+}
+
+// print to a buffer, or to stdout if the buffer is NULL
+static void output(string* out, const char* format, ...)
+{
+  va_list ap;
+
+  va_start(ap, format);
+  if (out == NULL){
+    vfprintf(stdout, format, ap);
+  }
+  else{
+    char buf[256];
+    va_list ap2;
+    va_copy(ap2, ap);
+    int n = vsnprintf(buf, sizeof(buf), format, ap);
+    if (n < (int)sizeof(buf)) out->append(buf, n);
+    else{
+      string s(n + 1, '\0');
+      vsnprintf(&s[0], n + 1, format, ap2);
+      out->append(s.data(), n);
+    }
+    va_end(ap2);
+  }
+  va_end(ap);
+}
+
+// the value of a tuple as RecordFile stores it in a key-value table:
+// cut at its first NUL and to at most MAX_VALUE_LENGTH-1 characters
+static string storedValue(const string& value)
+{
+  int len = strlen(value.c_str());
+  if (len >= RecordFile::MAX_VALUE_LENGTH) len = RecordFile::MAX_VALUE_LENGTH - 1;
+  return value.substr(0, len);
+}
+
+// append a loaded row to the table, collect its index entry (if the
+// table has an index) and insert it into the value index (if any). the
+// index entries go into the index in one batch after the rows are stored
+static RC storeRow(RecordFile& rf, vector<IndexEntry>* entries, ValueIndex* valueIndex,
+                   const string& table, int key, const string& value)
+{
+  RecordId rid;
+
+  if(rf.append(key, value, rid)){
+    fprintf(stderr, "Error: cannot append record into file %s \n", table.c_str()); 
+    return RC_FILE_WRITE_FAILED;     
+  }
+  if(entries != NULL) entries->push_back(IndexEntry(key, rid));
+  if(valueIndex != NULL && valueIndex->insert(storedValue(value), rid)){
+    fprintf(stderr, "Error: cannot insert record into the value index of %s \n", table.c_str()); 
+    return RC_FILE_WRITE_FAILED;             
+  }
+  return 0;
+}
+
+// collect a loaded row, as RecordFile stores it, into the statistics
+static void addStats(TableStats& stats, bool typed, int key, const string& value)
+{
+  int len = value.size();
+  if (!typed){
+    len = strlen(value.c_str());
+    if (len >= RecordFile::MAX_VALUE_LENGTH) len = RecordFile::MAX_VALUE_LENGTH - 1;
+  }
+  stats.add(key, value.data(), len);
+}
+
+// compute the statistics from the collected tuples, add those of the
+// table file and of the index (if any) and write them to the statistics file
+static RC saveStats(TableStats& stats, const string& table, const RecordFile& rf,
+                    BTreeIndex* index)
+{
+  RC  rc;
+  int entries;
+
+  stats.finish();
+  stats.endPid = rf.endRid().pid;
+  stats.endSid = rf.endRid().sid;
+  stats.pages = rf.endRid().pid + (rf.endRid().sid > 0 ? 1 : 0);
+  stats.indexed = (index != NULL);
+  if (index != NULL){
+    if ((rc = index->getStats(stats.indexHeight, stats.indexPages, stats.indexLeaves, entries)) < 0){
+      return rc;
+    }
+    if (stats.indexLeaves > 0){
+      stats.indexFill = (double)entries / ((double)stats.indexLeaves * BTLeafNode::MAXKEY_NUM);
+    }
+  }
+  return stats.save(table + ".stats");
+}
+
+// bring the row count and the end record id of the statistics of a table
+// up to date after rows were added to (or removed from, if negative) the
+// table that ended at oldEnd. statistics that were already out of date
+// are removed, so they are not taken for the new state of the table
+static void refreshStats(const string& table, const RecordId& oldEnd, const RecordFile& rf,
+                         int rows)
+{
+  TableStats stats;
+  string     filename = table + ".stats";
+
+  if (stats.load(filename) < 0) return;
+  if (stats.endPid != oldEnd.pid || stats.endSid != oldEnd.sid){
+    ::unlink(filename.c_str());
+    return;
+  }
+  stats.rows += rows;
+  stats.endPid = rf.endRid().pid;
+  stats.endSid = rf.endRid().sid;
+  stats.pages = rf.endRid().pid + (rf.endRid().sid > 0 ? 1 : 0);
+  if (stats.save(filename) < 0) ::unlink(filename.c_str());
+}
+
+// the value of a tuple as a memory table keeps it: a value of a key-value
+// table is cut like RecordFile cuts it. a binary row is kept as it is
+static string memoryValue(bool typed, const string& value)
+{
+  return typed ? value : storedValue(value);
+}
+
+// write the statistics of a memory or a frozen table, given its # pages.
+// it has no record file, so its end record id stays (0, 0)
+static RC memoryStats(const string& table, const vector<pair<int, string> >& rows, int pages = 0)
+{
+  TableStats stats;
+
+  for (unsigned i = 0; i < rows.size(); i++){
+    stats.add(rows[i].first, rows[i].second.data(), rows[i].second.size());
+  }
+  stats.finish();
+  stats.pages = pages;
+  return stats.save(table + ".stats");
+}
+
+// does a table exist, on disk, in memory or frozen?
+static bool tableExists(const string& table)
+{
+  return PageFile::exists(table + ".tbl") || MemTable::exists(table + ".mem") ||
+         FrozenTable::exists(table + ".frz");
+}
+
+// # pages of a frozen table
+static int frozenPages(const FrozenTable& t)
+{
+  return (t.getSize() + PageFile::PAGE_SIZE - 1) / PageFile::PAGE_SIZE;
+}
+
+// a frozen table cannot be changed
+static bool isFrozen(const string& table)
+{
+  if (!FrozenTable::exists(table + ".frz")) return false;
+  fprintf(stderr, "Error: table %s is frozen\n", table.c_str());
+  return true;
+}
+
+// find the columns set by the SET clause of an UPDATE
+// (1: key, 2: value of a key-value table. the column of a typed table)
+static RC assignColumns(const vector<SelCond>& assigns, bool typed, const Schema& schema,
+                        vector<int>& cols)
+{
+  cols.clear();
+  for (unsigned j = 0; j < assigns.size(); j++){
+    int col = assigns[j].attr;
+    if (typed) col = (strcmp(assigns[j].name, "key") == 0) ? 0 : schema.findColumn(assigns[j].name);
+    else if (col != 1 && col != 2) col = -1;
+    if (col < 0){
+      fprintf(stderr, "Error: no attribute %s\n", assigns[j].name);
+      return RC_INVALID_ATTRIBUTE;
+    }
+    cols.push_back(col);
+  }
+  return 0;
+}
+
+// set the columns of a tuple as in the SET clause of an UPDATE
+static RC applyAssigns(const vector<SelCond>& assigns, const vector<int>& cols, bool typed,
+                       const Schema& schema, int& key, string& value)
+{
+  RC rc = 0;
+
+  for (unsigned j = 0; j < assigns.size() && rc == 0; j++){
+    if (typed) rc = schema.setColumn(cols[j], assigns[j].value, key, value);
+    else if (cols[j] == 1) key = atoi(assigns[j].value);
+    else value = assigns[j].value;
+  }
+  if (rc < 0) fprintf(stderr, "Error: the updated row is too long\n");
+  return rc;
+}
+
+// append rows to a table, and to its index if it has one
+static RC appendRows(const string& table, const vector<pair<int, string> >& rows)
+{
+  RecordFile rf;
+  BTreeIndex indexFile;
+  ValueIndex valueIndex;
+  bool       indexed = false, valueIndexed = false;
+  RC         rc = 0;
+
+  if (isFrozen(table)) return RC_INVALID_FILE_MODE;
+
+  // a memory table is written again with the rows
+  if (MemTable::exists(table + ".mem")){
+    const MemTable* t;
+    Schema schema;
+    vector<pair<int, string> > all;
+    bool typed = (schema.load(table + ".cat") == 0);
+
+    if ((rc = MemTable::get(table + ".mem", t)) < 0){
+      fprintf(stderr, "Error: cannot read the snapshot of table %s\n", table.c_str());
+      return rc;
+    }
+    t->getRows(all);
+    for (unsigned i = 0; i < rows.size(); i++){
+      all.push_back(make_pair(rows[i].first, memoryValue(typed, rows[i].second)));
+    }
+    if ((rc = MemTable::write(table + ".mem", all)) < 0){
+      fprintf(stderr, "Error: cannot write the snapshot of table %s\n", table.c_str());
+      return rc;
+    }
+    return memoryStats(table, all);
+  }
+
+  if (!PageFile::exists(table + ".tbl") || rf.open(table + ".tbl", 'w') < 0){
+    fprintf(stderr, "Error: table %s does not exist\n", table.c_str());
+    return RC_FILE_OPEN_FAILED;
+  }
+  if (PageFile::exists(table + ".idx")){
+    if ((rc = indexFile.open(table + ".idx", 'w')) < 0){
+      fprintf(stderr, "Error: cannot open the index of table %s\n", table.c_str());
+      rf.close();
+      return rc;
+    }
+    indexed = true;
+  }
+  if (PageFile::exists(table + ".vidx")){
+    if ((rc = valueIndex.open(table + ".vidx", 'w')) < 0){
+      fprintf(stderr, "Error: cannot open the value index of table %s\n", table.c_str());
+      if (indexed) indexFile.close();
+      rf.close();
+      return rc;
+    }
+    valueIndexed = true;
+  }
+
+  RecordId oldEnd = rf.endRid();
+  vector<IndexEntry> entries;
+  unsigned n;
+  for (n = 0; n < rows.size(); n++){
+    if ((rc = storeRow(rf, indexed ? &entries : NULL, valueIndexed ? &valueIndex : NULL,
+                       table, rows[n].first, rows[n].second)) < 0) break;
+  }
+  if (indexed && indexFile.insertBatch(entries)){
+    fprintf(stderr, "Error: cannot insert record into index file %s \n", table.c_str()); 
+    rc = RC_FILE_WRITE_FAILED;
+  }
+  refreshStats(table, oldEnd, rf, n);
+
+  if (valueIndexed) valueIndex.close();
+  if (indexed) indexFile.close();
+  rf.close();
+  return rc;
+}
+
+// find the first page of a clustered table that holds a key >= key, 
+// using the index of the table. return false if there is no such key
+static bool firstPage(BTreeIndex& index, int key, PageId& pid)
+{
+  IndexCursor cursor;
+  RecordId    rid;
+  int         k, first = 0;
+  bool        found = false;
+
+  // locate() lands on the first of the duplicates of key. they are in
+  // rid order only within a leaf node or the overflow pages of the key,
+  // so all of the entries with the first key are looked at.
+  index.locate(key, cursor);
+  while (index.readForward(cursor, k, rid) == 0){
+    if (k < key) continue;
+    if (found && k != first) break;
+    if (!found || rid.pid < pid) pid = rid.pid;
+    first = k;
+    found = true;
+  }
+  return found;
+}
+
+// order the (rid, key) pairs of an index scan by rid
+static bool lessRid(const pair<RecordId, int>& e1, const pair<RecordId, int>& e2)
+{
+  return e1.first < e2.first;
+}
+
 RC SqlEngine::run(FILE* commandline)
 {
-  fprintf(stdout, "Bruinbase> ");
+  fprintf(stdout, "Bruinbase> ");
+
+  // set the command line input and start parsing user input
+  sqlin = commandline;
+  sqlparse();  // sqlparse() is defined in SqlParser.tab.c generated from
+               // SqlParser.y by bison (bison is GNU equivalent of yacc)
+
+  return 0;
+}
+
+//
+// a SELECT statement prepared for execution on one table. the conditions
+// are sorted out by how they are checked, and the tuples that meet them
+// are counted and printed by emitTuple(). DELETE and UPDATE prepare the
+// same query to collect the tuples to change instead of printing them.
+//
+struct ColumnCond {
+  int col;                    // the column of a typed table
+  SelCond::Comparator comp;   // the comparator
+  Schema::Value value;        // the constant, of the type of the column
+};
+
+struct SqlEngine::Query {
+  int attr;                   // attribute in the SELECT clause
+                              // (5: a column, 6: MIN, 7: MAX)
+  int column;                 // the column printed when attr is 5 and the
+                              // column of MIN/MAX (1: value of a key-value table)
+  int keyMin, keyMax;         // the range of key
+  vector<int> NElist;         // the keys excluded by <> conditions
+  vector<SelCond> valueCond;  // conditions checked by meetCond()
+  bool codeCond;              // are the value codes restricted?
+  int  codeMin, codeMax;      // the range of the value codes
+  bool lowValue, highValue;   // is value bounded from below / above?
+  string valueMin, valueMax;  // the bounds of value, inclusive
+  const Schema* schema;       // the schema of a typed table. NULL otherwise
+  vector<ColumnCond> columnCond; // conditions on the columns of a typed table
+  int count;                  // # tuples that met the conditions
+  bool collect;               // collect the tuples instead of printing them
+  vector<RecordId> rids;      // the collected tuples
+  vector<int> keys;           // the keys of the collected tuples
+  bool found;                 // has MIN/MAX seen a tuple?
+  int aggKey;                 // the tuple with the MIN/MAX so far
+  string aggValue;
+  string* out;                // the buffer for the printed tuples (NULL: stdout)
+  const BloomFilter* bloom;   // the Bloom filters of the table if the value
+                              // must be equal to probe. NULL otherwise
+  string probe;
+  int order;                  // ORDER BY key: 1 ascending, -1 descending, 0 none
+  int limit;                  // the most tuples printed (LIMIT)
+  vector<pair<int, string> > sorted; // the tuples of an ORDER BY printed aside,
+                                     // with their keys (see printSorted())
+};
+
+//
+// a part of a table scan run by a worker thread
+//
+struct SqlEngine::ScanTask {
+  Query q;                    // a copy of the query, with its own output
+  const RecordFile* rf;       // the table
+  PageId beginPid, endPid;    // the pages to scan
+  const string* table;        // the table name
+  string out;                 // the tuples printed by the worker
+  RC rc;                      // the result of the scan
+  pthread_t thread;
+};
+
+//
+// a partition of a table queried or loaded by a worker thread
+//
+struct SqlEngine::PartitionTask {
+  string table;               // the name of the partition
+  int attr;                   // SELECT: the query on the partition
+  const vector<SelCond>* cond;
+  const string* column;
+  Schema schema;
+  Query q;
+  string out;                 // SELECT: the tuples printed by the worker
+  string rows;                // LOAD: the lines of the load file
+  int options;                // LOAD: the options in the WITH clause
+  bool parallel;              // does the task run in a thread of its own?
+  RC rc;                      // the result of the task
+  pthread_t thread;
+};
+
+RC SqlEngine::select(int attr, const string& table, const vector<SelCond>& cond,
+                     const string& column, int order, int limit)
+{
+  Partitioning parts;
+  Schema       schema;
+  Query        q;
+  RC           rc;
+
+  // a partitioned table is queried partition by partition
+  if (parts.load(table + ".parts") == 0){
+    return selectPartitions(attr, table, parts, cond, column, order, limit);
+  }
+
+  if ((rc = query(attr, table, cond, column, schema, q, NULL, order, limit)) < 0) return rc;
+  printResult(q);
+  return 0;
+}
+
+RC SqlEngine::query(int attr, const string& table, const vector<SelCond>& cond,
+                    const string& column, Schema& schema, Query& q, string* out,
+                    int order, int limit)
+{
+  RecordFile rf;   // RecordFile containing the table
+  BTreeIndex indexFile;
+  ValueIndex valueIndex;
+
+  RC     rc;
+  bool   empty;
+
+  // a memory table is queried right in memory
+  if (MemTable::exists(table + ".mem")){
+    const MemTable* t;
+    if ((rc = MemTable::get(table + ".mem", t)) < 0){
+      fprintf(stderr, "Error: cannot read the snapshot of table %s\n", table.c_str());
+      return rc;
+    }
+    bool typed = (schema.load(table + ".cat") == 0);
+    if ((rc = prepare(attr, column, cond, rf, typed ? &schema : NULL, q, empty, order, limit)) < 0) return rc;
+    q.out = out;
+    if (!empty && (rc = scanMemory(q, *t)) < 0) return rc;
+    printSorted(q);
+    return 0;
+  }
+
+  // so is a frozen table, which is mapped into memory, too
+  if (FrozenTable::exists(table + ".frz")){
+    const FrozenTable* t;
+    if ((rc = FrozenTable::get(table + ".frz", t)) < 0){
+      fprintf(stderr, "Error: cannot read the frozen table %s\n", table.c_str());
+      return rc;
+    }
+    bool typed = (schema.load(table + ".cat") == 0);
+    if ((rc = prepare(attr, column, cond, rf, typed ? &schema : NULL, q, empty, order, limit)) < 0) return rc;
+    q.out = out;
+    if (!empty && (rc = scanFrozen(q, *t)) < 0) return rc;
+    printSorted(q);
+    return 0;
+  }
+
+  // open the table file
+  if ((rc = rf.open(table + ".tbl", 'r')) < 0){
+    fprintf(stderr, "Error: table %s does not exist\n", table.c_str());
+    return rc;
+  }
+
+  // an unfiltered COUNT(*) is answered by the statistics of the table,
+  // if they are up to date
+  TableStats stats;
+  if (attr == 4 && cond.empty() && stats.load(table + ".stats") == 0 &&
+      stats.endPid == rf.endRid().pid && stats.endSid == rf.endRid().sid){
+    q.attr = attr;
+    q.count = stats.rows;
+    q.found = false;
+    rf.close();
+    return 0;
+  }
+
+  // a table created by CREATE TABLE has its schema in the catalog file
+  bool typed = (schema.load(table + ".cat") == 0);
+  if ((rc = prepare(attr, column, cond, rf, typed ? &schema : NULL, q, empty, order, limit)) < 0){
+    rf.close();
+    return rc;
+  }
+  q.out = out;
+
+  if (empty){
+    rf.close();
+    return 0;
+  }
+
+  //check the index file
+  bool indexed = (indexFile.open(table+".idx", 'r') == 0);
+  bool valueIndexed = (PageFile::exists(table + ".vidx") && valueIndex.open(table + ".vidx", 'r') == 0);
+  rc = execute(q, rf, indexed ? &indexFile : NULL, valueIndexed ? &valueIndex : NULL, table);
+  if (rc >= 0) printSorted(q);
+  if (valueIndexed) valueIndex.close();
+  if (indexed) indexFile.close();
+  rf.close();
+  return rc < 0 ? rc : 0;
+}
+
+void SqlEngine::printResult(const Query& q)
+{
+  // print matching tuple count if "select count(*)"
+  if (q.attr == 4){
+    fprintf(stdout, "%d\n", q.count);
+  }
+
+  // print the minimum or the maximum
+  if ((q.attr == 6 || q.attr == 7) && q.found){
+    if (q.column == 0) fprintf(stdout, "%d\n", q.aggKey);
+    else if (q.schema == NULL) fprintf(stdout, "%s\n", q.aggValue.c_str());
+    else fprintf(stdout, "%s\n", q.schema->format(q.column, q.aggKey, q.aggValue.data(), false).c_str());
+  }
+}
+
+RC SqlEngine::selectPartitions(int attr, const string& table, const Partitioning& parts,
+                               const vector<SelCond>& cond, const string& column,
+                               int order, int limit)
+{
+  RC          rc = 0;
+  vector<int> found;
+  Query*      result = NULL;
+
+  // the partitions out of the key range of the conditions are not read
+  findPartitions(table, parts, cond, found);
+
+  // the partitions are in key order. with ORDER BY, they are queried one
+  // after another (backward if descending) until LIMIT tuples are printed
+  if (order != 0 && attr != 4 && attr != 6 && attr != 7){
+    int printed = 0;
+    for (unsigned j = 0; j < found.size() && printed < limit; j++){
+      int i = (order > 0) ? found[j] : found[found.size() - 1 - j];
+      Schema schema;
+      Query  q;
+      if ((rc = query(attr, Partitioning::name(table, i), cond, column, schema, q, NULL,
+                      order, limit - printed)) < 0) return rc;
+      printed += min(q.count, limit - printed);
+    }
+    return 0;
+  }
+  vector<PartitionTask> tasks(found.size());
+  for (unsigned i = 0; i < found.size(); i++){
+    tasks[i].table = Partitioning::name(table, found[i]);
+    tasks[i].attr = attr;
+    tasks[i].cond = &cond;
+    tasks[i].column = &column;
+  }
+  runPartitions(tasks, selectWorker);
+
+  // merge the results in the order of the partitions
+  for (unsigned i = 0; i < tasks.size(); i++){
+    PartitionTask& task = tasks[i];
+    fwrite(task.out.data(), 1, task.out.size(), stdout);
+    if (task.rc != 0){
+      if (rc == 0 && task.rc < 0) rc = task.rc;
+      continue;
+    }
+    if (result == NULL){
+      result = &task.q;
+      continue;
+    }
+    result->count += task.q.count;
+    if (task.q.found && (!result->found || isBetter(*result, task.q.aggKey, task.q.aggValue.data(), task.q.aggValue.size()))){
+      result->found = true;
+      result->aggKey = task.q.aggKey;
+      result->aggValue = task.q.aggValue;
+    }
+  }
+  if (rc < 0) return rc;
+
+  if (result != NULL) printResult(*result);
+  else if (attr == 4) fprintf(stdout, "0\n");
+  return 0;
+}
+
+void* SqlEngine::selectWorker(void* arg)
+{
+  PartitionTask* task = (PartitionTask*) arg;
+
+  // a partition queried in a thread of its own prints to its buffer
+  task->rc = query(task->attr, task->table, *task->cond, *task->column, task->schema,
+                   task->q, task->parallel ? &task->out : NULL);
+  return NULL;
+}
+
+void SqlEngine::findPartitions(const string& table, const Partitioning& parts,
+                               const vector<SelCond>& cond, vector<int>& found)
+{
+  int keyMin, keyMax;
+
+  found.clear();
+  if (!keyBounds(table, cond, keyMin, keyMax)) return;
+
+  // a partition that was never loaded has no tuples
+  for (int i = parts.find(keyMin); i <= parts.find(keyMax); i++){
+    if (tableExists(Partitioning::name(table, i))) found.push_back(i);
+  }
+}
+
+void SqlEngine::runPartitions(vector<PartitionTask>& tasks, void* (*worker)(void*))
+{
+  unsigned threads = coreCount();
+
+  // a task that is not run is left with rc > 0
+  for (unsigned i = 0; i < tasks.size(); i++){
+    tasks[i].parallel = false;
+    tasks[i].rc = 1;
+  }
+
+  // one after another, the tasks stop at the first error
+  if (threads <= 1 || tasks.size() <= 1){
+    for (unsigned i = 0; i < tasks.size(); i++){
+      worker(&tasks[i]);
+      if (tasks[i].rc < 0) break;
+    }
+    return;
+  }
+
+  // the tasks are run in rounds of one thread per core
+  for (unsigned begin = 0; begin < tasks.size(); begin += threads){
+    unsigned end = min((unsigned)tasks.size(), begin + threads);
+    for (unsigned i = begin; i < end; i++){
+      tasks[i].parallel = true;
+      if (pthread_create(&tasks[i].thread, NULL, worker, &tasks[i]) != 0){
+        // no thread. run the task right here
+        tasks[i].thread = pthread_self();
+        worker(&tasks[i]);
+      }
+    }
+    for (unsigned i = begin; i < end; i++){
+      if (!pthread_equal(tasks[i].thread, pthread_self())) pthread_join(tasks[i].thread, NULL);
+    }
+  }
+}
+
+RC SqlEngine::execute(Query& q, const RecordFile& rf, BTreeIndex* index,
+                      ValueIndex* valueIndex, const string& table)
+{
+  RC       rc = 0;
+  PageId   beginPid = 0;
+  PageId   endPid = rf.endRid().pid + (rf.endRid().sid > 0 ? 1 : 0);
+
+  // an ORDER BY on key reads the index in key order, if reading LIMIT
+  // tuples one by one takes fewer pages than the table has. otherwise
+  // the tuples are found as without ORDER BY, and sorted
+  if (q.order != 0 && index != NULL && (keyOnly(q) || q.limit < endPid)){
+    return orderScan(q, rf, *index, table);
+  }
+
+  // a bounded value with any key is found through the value index, if
+  // fewer tuples have a value in the range than the table has pages.
+  // otherwise the tuples would be on about every page anyway
+  if (valueIndex != NULL && (q.lowValue || q.highValue) &&
+      q.keyMin == INT_MIN && q.keyMax == INT_MAX &&
+      valueRows(q, *valueIndex, rf, table, endPid) < endPid){
+    return valueScan(q, rf, *valueIndex, table);
+  }
+
+  if (rf.isClustered()){
+    // the table is in key order, so the key range is a run of contiguous
+    // pages: from the first page that has a key >= keyMin up to the 
+    // first page that has a key > keyMax
+    PageId lastPid = endPid;
+    if (index != NULL){
+      // the index finds the pages with fewer reads than a binary search
+      if (q.keyMin > INT_MIN && !firstPage(*index, q.keyMin, beginPid)) beginPid = endPid;
+      if (q.keyMax < INT_MAX) firstPage(*index, q.keyMax + 1, lastPid);
+    }
+    else{
+      if (q.keyMin > INT_MIN) rc = rf.lowerPage(q.keyMin, beginPid);
+      if (rc >= 0 && q.keyMax < INT_MAX) rc = rf.lowerPage(q.keyMax + 1, lastPid);
+    }
+    if (rc < 0){
+      fprintf(stderr, "Error: while reading a page from table %s\n", table.c_str());
+      return rc;
+    }
+    if (lastPid < endPid) endPid = lastPid + 1;
+  }
+  else if (index != NULL){
+    return indexScan(q, rf, *index, table);
+  }
+
+  // a long scan is split into ranges of pages scanned by worker threads
+  int threads = scanThreads(endPid - beginPid);
+  if (threads <= 1) return scanPages(q, rf, beginPid, endPid, table);
+
+  // the dictionary is read before the workers share it
+  const Dictionary* dict;
+  if (rf.isEncoded() && (rc = rf.getDictionary(dict)) < 0) return rc;
+
+  vector<ScanTask> tasks(threads);
+  for (int t = 0; t < threads; t++){
+    ScanTask& task = tasks[t];
+    task.q = q;
+    task.q.count = 0;
+    task.q.rids.clear();
+    task.q.keys.clear();
+    task.q.sorted.clear();
+    task.q.found = false;
+    task.q.out = &task.out;
+    task.rf = &rf;
+    task.beginPid = beginPid + (PageId)((long long)(endPid - beginPid) * t / threads);
+    task.endPid = beginPid + (PageId)((long long)(endPid - beginPid) * (t + 1) / threads);
+    task.table = &table;
+    if (pthread_create(&task.thread, NULL, scanWorker, &task) != 0){
+      // no thread. scan the range right here
+      task.thread = pthread_self();
+      scanWorker(&task);
+    }
+  }
+
+  // merge the results in the order of the ranges,
+  // so the tuples come out as in a single-threaded scan
+  for (int t = 0; t < threads; t++){
+    if (!pthread_equal(tasks[t].thread, pthread_self())) pthread_join(tasks[t].thread, NULL);
+  }
+  for (int t = 0; t < threads; t++){
+    const ScanTask& task = tasks[t];
+    if (rc == 0 && task.rc < 0) rc = task.rc;
+    if (q.out == NULL) fwrite(task.out.data(), 1, task.out.size(), stdout);
+    else q.out->append(task.out);
+    q.count += task.q.count;
+    q.rids.insert(q.rids.end(), task.q.rids.begin(), task.q.rids.end());
+    q.keys.insert(q.keys.end(), task.q.keys.begin(), task.q.keys.end());
+    q.sorted.insert(q.sorted.end(), task.q.sorted.begin(), task.q.sorted.end());
+    if (task.q.found && (!q.found || isBetter(q, task.q.aggKey, task.q.aggValue.data(), task.q.aggValue.size()))){
+      q.found = true;
+      q.aggKey = task.q.aggKey;
+      q.aggValue = task.q.aggValue;
+    }
+  }
+  return rc;
+}
+
+void* SqlEngine::scanWorker(void* arg)
+{
+  ScanTask* task = (ScanTask*) arg;
+  task->rc = scanPages(task->q, *task->rf, task->beginPid, task->endPid, *task->table);
+  return NULL;
+}
+
+RC SqlEngine::scanPages(Query& q, const RecordFile& rf, PageId beginPid, PageId endPid,
+                        const string& table)
+{
+  RC          rc;
+  RecordId    rid;
+  const char* page;
+
+  // scan the table page by page, checking the keys of 
+  // a page before reading any of its values.
+  // the values are read in place while the page is pinned
+  vector<int> sids, keys;
+  for (rid.pid = beginPid; rid.pid < endPid; rid.pid++){
+    if (q.bloom != NULL && !q.bloom->mayContain(rid.pid, q.probe)){
+      // skip to the last page of the page group
+      rid.pid = (rid.pid / BloomFilter::GROUP_PAGES + 1) * BloomFilter::GROUP_PAGES - 1;
+      continue;
+    }
+    if ((rc = rf.pinPage(rid.pid, page)) < 0){
+      fprintf(stderr, "Error: while reading a page from table %s\n", table.c_str());
+      return rc;
+    }
+    rf.filterPage(page, q.keyMin, q.keyMax, q.codeMin, q.codeMax, sids, keys);
+    for (unsigned i = 0; i < sids.size(); i++){
+      rid.sid = sids[i];
+      if ((rc = emitTuple(q, rf, page, rid, keys[i])) < 0){
+        fprintf(stderr, "Error: while reading a tuple from table %s\n", table.c_str());
+        rf.unpinPage(page);
+        return rc;
+      }
+    }
+    rf.unpinPage(page);
+  }
+  return 0;
+}
+
+RC SqlEngine::indexScan(Query& q, const RecordFile& rf, BTreeIndex& index, const string& table)
+{
+  RC          rc = 0;
+  IndexCursor cursor;
+  RecordId    rid;
+  int         key;
+
+  // if only the keys are needed, the tuples come right from the index
+  bool heap = !keyOnly(q) || q.codeCond;
+
+  //
+  // otherwise the (rid, key) pairs in the key range are collected first.
+  // a few tuples are read in key order. for more, the rids are sorted by
+  // page, so that every page of the table is read once and in order. 
+  // beyond BITMAP_EXACT_ROWS pairs, only the pages are remembered (in a
+  // bitmap) and their tuples in the key range are found again by
+  // filterPage().
+  //
+  vector<pair<RecordId, int> > entries;
+  vector<bool> pages;
+  index.locate(q.keyMin, cursor);
+  while (index.readForward(cursor, key, rid) == 0){
+    if (key > q.keyMax) break;
+    if (!heap){
+      if ((rc = emitTuple(q, rf, NULL, rid, key)) < 0) break;
+      continue;
+    }
+    if (q.bloom != NULL && !q.bloom->mayContain(rid.pid, q.probe)) continue;
+    if (pages.empty()){
+      entries.push_back(make_pair(rid, key));
+      if (entries.size() <= (unsigned)BITMAP_EXACT_ROWS) continue;
+
+      // too many rids to keep. switch to the page bitmap
+      pages.resize(rf.endRid().pid + 1, false);
+      for (unsigned i = 0; i < entries.size(); i++) pages[entries[i].first.pid] = true;
+      entries.clear();
+    }
+    if (rid.pid >= 0 && rid.pid < (PageId)pages.size()) pages[rid.pid] = true;
+  }
+  if (!heap){
+    if (rc < 0) fprintf(stderr, "Error: while reading a tuple from table %s\n", table.c_str());
+    return rc < 0 ? rc : 0;
+  }
+
+  const char* page;
+  if (!pages.empty()){
+    vector<int> sids, keys;
+    for (rid.pid = 0; rid.pid < (PageId)pages.size(); rid.pid++){
+      if (!pages[rid.pid]) continue;
+      if ((rc = rf.pinPage(rid.pid, page)) < 0){
+        fprintf(stderr, "Error: while reading a page from table %s\n", table.c_str());
+        return rc;
+      }
+      rf.filterPage(page, q.keyMin, q.keyMax, q.codeMin, q.codeMax, sids, keys);
+      for (unsigned i = 0; i < sids.size(); i++){
+        rid.sid = sids[i];
+        if ((rc = emitTuple(q, rf, page, rid, keys[i])) < 0){
+          fprintf(stderr, "Error: while reading a tuple from table %s\n", table.c_str());
+          rf.unpinPage(page);
+          return rc;
+        }
+      }
+      rf.unpinPage(page);
+    }
+    return 0;
+  }
+
+  // a few tuples are point lookups. they are read through the row cache,
+  // which keeps them for the next lookups of the same keys
+  if (entries.size() <= (unsigned)BITMAP_SCAN_ROWS && !q.codeCond){
+    for (unsigned i = 0; i < entries.size(); i++){
+      if ((rc = emitTuple(q, rf, NULL, entries[i].first, entries[i].second)) < 0){
+        fprintf(stderr, "Error: while reading a tuple from table %s\n", table.c_str());
+        break;
+      }
+    }
+    return rc < 0 ? rc : 0;
+  }
+
+  // a page stays pinned while its tuples follow one another
+  if (entries.size() > (unsigned)BITMAP_SCAN_ROWS) sort(entries.begin(), entries.end(), lessRid);
+  page = NULL;
+  for (unsigned i = 0; i < entries.size(); i++){
+    if (i == 0 || entries[i].first.pid != entries[i-1].first.pid){
+      if (page != NULL) rf.unpinPage(page);
+      page = NULL;
+      if ((rc = rf.pinPage(entries[i].first.pid, page)) < 0){
+        fprintf(stderr, "Error: while reading a page from table %s\n", table.c_str());
+        return rc;
+      }
+    }
+    if ((rc = emitTuple(q, rf, page, entries[i].first, entries[i].second)) < 0){
+      fprintf(stderr, "Error: while reading a tuple from table %s\n", table.c_str());
+      break;
+    }
+  }
+  if (page != NULL) rf.unpinPage(page);
+  return rc < 0 ? rc : 0;
+}
+
+RC SqlEngine::orderScan(Query& q, const RecordFile& rf, BTreeIndex& index, const string& table)
+{
+  RC          rc;
+  IndexCursor cursor;
+  RecordId    rid;
+  int         key;
+  const char* page;
+
+  // the tuples come in key order, so they are printed right away. a
+  // descending scan starts at the last entry in the key range, and
+  // reads the leaf nodes backward
+  bool forward = (q.order > 0);
+  q.order = 0;
+  if (forward) index.locate(q.keyMin, cursor);
+  else if ((rc = index.locateBackward(q.keyMax, cursor)) < 0){
+    fprintf(stderr, "Error: while reading the index of table %s\n", table.c_str());
+    return rc;
+  }
+  while (q.count < q.limit){
+    if ((forward ? index.readForward(cursor, key, rid) : index.readBackward(cursor, key, rid)) != 0) break;
+    if (forward ? key > q.keyMax : key < q.keyMin) break;
+    if (q.bloom != NULL && !q.bloom->mayContain(rid.pid, q.probe)) continue;
+
+    // a tuple is a point lookup through the row cache, unless its
+    // value code is checked in the page
+    page = NULL;
+    if (q.codeCond && (rc = rf.pinPage(rid.pid, page)) < 0){
+      fprintf(stderr, "Error: while reading a page from table %s\n", table.c_str());
+      return rc;
+    }
+    rc = emitTuple(q, rf, page, rid, key);
+    if (page != NULL) rf.unpinPage(page);
+    if (rc < 0){
+      fprintf(stderr, "Error: while reading a tuple from table %s\n", table.c_str());
+      return rc;
+    }
+  }
+  return 0;
+}
+
+void SqlEngine::sortTuples(Query& q)
+{
+  // a stable sort keeps the tuples with the same key in the order they
+  // were found, so a descending order takes them from the end
+  stable_sort(q.sorted.begin(), q.sorted.end(), lessKey<string>);
+  if (q.sorted.size() <= (size_t)q.limit) return;
+  if (q.order > 0) q.sorted.erase(q.sorted.begin() + q.limit, q.sorted.end());
+  else q.sorted.erase(q.sorted.begin(), q.sorted.end() - q.limit);
+}
+
+void SqlEngine::printSorted(Query& q)
+{
+  if (q.order == 0) return;
+  sortTuples(q);
+  for (unsigned i = 0; i < q.sorted.size(); i++){
+    const string& row = q.sorted[(q.order > 0) ? i : q.sorted.size() - 1 - i].second;
+    if (q.out == NULL) fwrite(row.data(), 1, row.size(), stdout);
+    else q.out->append(row);
+  }
+  q.sorted.clear();
+}
+
+int SqlEngine::valueRows(const Query& q, ValueIndex& valueIndex, const RecordFile& rf,
+                         const string& table, int limit)
+{
+  IndexCursor cursor;
+  RecordId    rid;
+  string      value;
+  int         n = 0;
+
+  // a single value has the average # tuples of a value
+  TableStats stats;
+  if (q.lowValue && q.highValue && q.valueMin == q.valueMax &&
+      stats.load(table + ".stats") == 0 && stats.distinctValues > 0 &&
+      stats.endPid == rf.endRid().pid && stats.endSid == rf.endRid().sid){
+    return stats.rows / stats.distinctValues;
+  }
+
+  valueIndex.locate(q.lowValue ? q.valueMin : string(), cursor);
+  while (n < limit && valueIndex.readForward(cursor, value, rid) == 0){
+    if (q.highValue && value > q.valueMax) break;
+    n++;
+  }
+  return n;
+}
+
+RC SqlEngine::valueScan(Query& q, const RecordFile& rf, ValueIndex& valueIndex, const string& table)
+{
+  RC          rc = 0;
+  IndexCursor cursor;
+  RecordId    rid;
+  string      value;
+  int         key, len;
+  const char* data;
+  const char* page = NULL;
+
+  // the rids in the value range are sorted, so that every page is read
+  // once and the tuples come out in the order of a table scan. the
+  // conditions on value are checked again on the tuples
+  vector<RecordId> rids;
+  valueIndex.locate(q.lowValue ? q.valueMin : string(), cursor);
+  while (valueIndex.readForward(cursor, value, rid) == 0){
+    if (q.highValue && value > q.valueMax) break;
+    rids.push_back(rid);
+  }
+  sort(rids.begin(), rids.end());
+
+  for (unsigned i = 0; i < rids.size(); i++){
+    if (i == 0 || rids[i].pid != rids[i-1].pid){
+      if (page != NULL) rf.unpinPage(page);
+      page = NULL;
+      if ((rc = rf.pinPage(rids[i].pid, page)) < 0){
+        fprintf(stderr, "Error: while reading a page from table %s\n", table.c_str());
+        return rc;
+      }
+    }
+    if ((rc = rf.readRef(page, rids[i].sid, key, data, len)) < 0 ||
+        (rc = emitTuple(q, rf, page, rids[i], key)) < 0){
+      fprintf(stderr, "Error: while reading a tuple from table %s\n", table.c_str());
+      break;
+    }
+  }
+  if (page != NULL) rf.unpinPage(page);
+  return rc < 0 ? rc : 0;
+}
+
+RC SqlEngine::prepare(int attr, const string& column, const vector<SelCond>& cond,
+                      const RecordFile& rf, const Schema* schema, Query& q, bool& empty,
+                      int order, int limit)
+{
+  RC rc;
+  vector<SelCond> keyCond;
+
+  q.attr = attr;
+  q.column = 0;
+  q.NElist.clear();
+  q.valueCond.clear();
+  q.codeCond = false;
+  q.codeMin = 0;
+  q.codeMax = INT_MAX;
+  q.lowValue = q.highValue = false;
+  q.valueMin.erase();
+  q.valueMax.erase();
+  q.schema = schema;
+  q.columnCond.clear();
+  q.count = 0;
+  q.collect = false;
+  q.rids.clear();
+  q.keys.clear();
+  q.found = false;
+  q.aggKey = 0;
+  q.aggValue.erase();
+  q.out = NULL;
+  q.bloom = NULL;
+  q.probe.erase();
+  q.sorted.clear();
+
+  // a count or a MIN/MAX is one row, which ORDER BY and LIMIT leave as it is
+  q.order = (attr == 4 || attr == 6 || attr == 7) ? 0 : order;
+  q.limit = (q.order == 0) ? INT_MAX : limit;
+
+  if (schema == NULL){
+    // a key-value table has no other attributes
+    if (attr == 6 || attr == 7){
+      if (strcasecmp(column.c_str(), "key") == 0) q.column = 0;
+      else if (strcasecmp(column.c_str(), "value") == 0) q.column = 1;
+      else attr = 5;
+    }
+    if (attr == 5){
+      fprintf(stderr, "Error: no attribute %s\n", column.c_str());
+      return RC_INVALID_ATTRIBUTE;
+    }
+    for (unsigned i = 0; i < cond.size(); i++){
+      if (cond[i].attr != 1 && cond[i].attr != 2){
+        fprintf(stderr, "Error: no attribute %s\n", cond[i].name);
+        return RC_INVALID_ATTRIBUTE;
+      }
+    }
+    keyCond = cond;
+  }
+  else{
+    // in a typed table, the attributes are looked up by name.
+    // "key" is always the first column.
+    if (attr == 1 || attr == 2 || attr == 5 || attr == 6 || attr == 7){
+      int col = (column == "key") ? 0 : schema->findColumn(column);
+      if (col < 0){
+        fprintf(stderr, "Error: no column %s\n", column.c_str());
+        return RC_INVALID_ATTRIBUTE;
+      }
+      if (attr < 6) q.attr = (col == 0) ? 1 : 5;
+      q.column = col;
+    }
+    for (unsigned i = 0; i < cond.size(); i++){
+      int col = (strcmp(cond[i].name, "key") == 0) ? 0 : schema->findColumn(cond[i].name);
+      if (col < 0){
+        fprintf(stderr, "Error: no column %s\n", cond[i].name);
+        return RC_INVALID_ATTRIBUTE;
+      }
+      if (col == 0){
+        keyCond.push_back(cond[i]);
+        keyCond.back().attr = 1;
+      }
+      else{
+        ColumnCond c;
+        c.col = col;
+        c.comp = cond[i].comp;
+        schema->parseValue(col, cond[i].value, c.value);
+        q.columnCond.push_back(c);
+      }
+    }
+  }
+
+  // check boundary condition
+  empty = !keyRange(keyCond, q.keyMin, q.keyMax, q.NElist, q.valueCond);
+
+  // the bounds of value for the value index, taken before the
+  // conditions on value turn into codes
+  for (unsigned i = 0; i < q.valueCond.size(); i++){
+    string val(q.valueCond[i].value);
+    SelCond::Comparator comp = q.valueCond[i].comp;
+    if (comp == SelCond::EQ || comp == SelCond::GT || comp == SelCond::GE){
+      if (!q.lowValue || val > q.valueMin) q.valueMin = val;
+      q.lowValue = true;
+    }
+    if (comp == SelCond::EQ || comp == SelCond::LT || comp == SelCond::LE){
+      if (!q.highValue || val < q.valueMax) q.valueMax = val;
+      q.highValue = true;
+    }
+  }
+
+  // with value = constant, the page groups whose Bloom filter
+  // does not have the constant are not read
+  if (!empty && rf.hasBloomFilter()){
+    for (unsigned i = 0; i < q.valueCond.size(); i++){
+      if (q.valueCond[i].comp != SelCond::EQ) continue;
+      if ((rc = rf.getBloomFilter(q.bloom)) < 0){
+        fprintf(stderr, "Error: cannot read the Bloom filters of the table\n");
+        return rc;
+      }
+      q.probe = q.valueCond[i].value;
+      break;
+    }
+  }
+
+  // on a dictionary-encoded table, the conditions on value 
+  // are checked on the codes of the values
+  if (!empty && rf.isEncoded() && !q.valueCond.empty()){
+    const Dictionary* dict;
+    if ((rc = rf.getDictionary(dict)) < 0){
+      fprintf(stderr, "Error: cannot read the dictionary of the table\n");
+      return rc;
+    }
+    empty = !codeRange(*dict, q.valueCond, q.codeMin, q.codeMax);
+    q.codeCond = true;
+  }
+
+  return 0;
+}
+
+RC SqlEngine::emitTuple(Query& q, const RecordFile& rf, const char* page, const RecordId& rid, int key)
+{
+  RC          rc;
+  int         code;
+  const char* value = NULL;
+  int         len = 0;
+  string      row;
+
+  if (find(q.NElist.begin(), q.NElist.end(), key) != q.NElist.end()) return 0;
+
+  if (q.codeCond){
+    if ((rc = rf.readCode(page, rid.sid, key, code)) < 0) return rc;
+    if (code < q.codeMin || code > q.codeMax) return 0;
+  }
+
+  // the key is all we need if nothing else is checked or printed
+  if (keyOnly(q)){
+    return countTuple(q, rid, key, value, len);
+  }
+
+  // the value is read in place. it is copied only if it is printed.
+  // without a page, the tuple is read through the row cache
+  if (page == NULL){
+    if ((rc = rf.read(rid, key, row)) < 0) return rc;
+    value = row.data();
+    len = row.size();
+  } else if ((rc = rf.readRef(page, rid.sid, key, value, len)) < 0) return rc;
+  if (!meetCond(q.valueCond, key, value, len)) return 0;
+  if (!meetColumnCond(q, key, value)) return 0;
+
+  return countTuple(q, rid, key, value, len);
+}
+
+bool SqlEngine::meetColumnCond(const Query& q, int key, const char* value)
+{
+  // check the conditions on the columns of a typed table 
+  // directly on the binary row
+  for (unsigned i = 0; i < q.columnCond.size(); i++){
+    const ColumnCond& c = q.columnCond[i];
+    int diff = q.schema->compare(c.col, key, value, c.value);
+    switch (c.comp){
+      case SelCond::EQ: if (diff != 0) return false; break;
+      case SelCond::NE: if (diff == 0) return false; break;
+      case SelCond::GT: if (diff <= 0) return false; break;
+      case SelCond::LT: if (diff >= 0) return false; break;
+      case SelCond::GE: if (diff < 0) return false; break;
+      case SelCond::LE: if (diff > 0) return false; break;
+    }
+  }
+  return true;
+}
+
+RC SqlEngine::scanMemory(Query& q, const MemTable& t)
+{
+  RecordId    rid;
+  const char* value = NULL;
+  int         len = 0;
+  RC          rc;
+
+  // the tuples in the key range are a run of the sorted arrays
+  int begin = t.lowerBound(q.keyMin);
+  int end = t.upperBound(q.keyMax);
+  if (q.attr == 4 && keyOnly(q) && q.NElist.empty() && !q.collect){
+    q.count += end - begin;
+    return 0;
+  }
+
+  // the rid of a tuple is its place in the arrays
+  rid.sid = 0;
+  for (rid.pid = begin; rid.pid < end; rid.pid++){
+    int key = t.key(rid.pid);
+    if (find(q.NElist.begin(), q.NElist.end(), key) != q.NElist.end()) continue;
+    if (!keyOnly(q)){
+      value = t.value(rid.pid, len);
+      if (!meetCond(q.valueCond, key, value, len) || !meetColumnCond(q, key, value)) continue;
+    }
+    if ((rc = countTuple(q, rid, key, value, len)) < 0) return rc;
+  }
+  return 0;
+}
+
+RC SqlEngine::scanFrozen(Query& q, const FrozenTable& t)
+{
+  FrozenTable::Block block;
+  RecordId rid;
+  RC       rc;
+
+  // with value = constant, the blocks whose Bloom filter does not
+  // have the constant are not decoded
+  const SelCond* probe = NULL;
+  for (unsigned i = 0; i < q.valueCond.size() && t.hasBloomFilter(); i++){
+    if (q.valueCond[i].comp == SelCond::EQ){
+      probe = &q.valueCond[i];
+      break;
+    }
+  }
+
+  bool countOnly = (q.attr == 4 && keyOnly(q) && q.NElist.empty() && !q.collect);
+  rid.sid = 0;
+  for (int b = t.findBlock(q.keyMin); b < t.blockCount() && t.firstKey(b) <= q.keyMax; b++){
+    // the keys of a block are at most the first key of the next one,
+    // so a block within the key range is counted without decoding it
+    if (countOnly && t.firstKey(b) >= q.keyMin && b + 1 < t.blockCount() &&
+        t.firstKey(b + 1) <= q.keyMax){
+      q.count += t.firstRow(b + 1) - t.firstRow(b);
+      continue;
+    }
+    if (probe != NULL && !t.mayContain(b, probe->value)) continue;
+    if ((rc = t.readBlock(b, block)) < 0) return rc;
+
+    for (unsigned i = 0; i < block.keys.size(); i++){
+      int key = block.keys[i];
+      if (key < q.keyMin) continue;
+      if (key > q.keyMax) return 0;
+      if (find(q.NElist.begin(), q.NElist.end(), key) != q.NElist.end()) continue;
+      const char* value = block.values.data() + block.offsets[i];
+      int len = block.offsets[i + 1] - block.offsets[i];
+      if (!keyOnly(q) && (!meetCond(q.valueCond, key, value, len) || !meetColumnCond(q, key, value))) continue;
+
+      // the rid of a tuple is its place in the table
+      rid.pid = t.firstRow(b) + i;
+      if ((rc = countTuple(q, rid, key, value, len)) < 0) return rc;
+    }
+  }
+  return 0;
+}
+
+RC SqlEngine::countTuple(Query& q, const RecordId& rid, int key, const char* value, int len)
+{
+  q.count++;
+  if (q.collect){
+    q.rids.push_back(rid);
+    q.keys.push_back(key);
+    return 0;
+  }
+
+  // keep the tuple with the minimum or the maximum so far
+  if (q.attr == 6 || q.attr == 7){
+    if (!q.found || isBetter(q, key, value, len)){
+      q.found = true;
+      q.aggKey = key;
+      q.aggValue.assign(value, len);
+    }
+    return 0;
+  }
+
+  // the tuples of an ORDER BY that do not come in key order are printed
+  // aside, and sorted by printSorted() at the end
+  string* out = q.out;
+  if (q.order != 0){
+    if (q.limit == 0) return 0;
+    q.sorted.push_back(make_pair(key, string()));
+    q.out = &q.sorted.back().second;
+  }
+
+  if (q.schema == NULL){
+    printTuple(q.out, q.attr, key, value, len);
+  }
+  else switch (q.attr){
+    case 1:  // SELECT key
+      output(q.out, "%d\n", key);
+      break;
+    case 3:  // SELECT *
+      for (int col = 0; col < q.schema->columnCount(); col++){
+        output(q.out, col ? " %s" : "%s", q.schema->format(col, key, value, true).c_str());
+      }
+      output(q.out, "\n");
+      break;
+    case 5:  // SELECT column
+      output(q.out, "%s\n", q.schema->format(q.column, key, value, false).c_str());
+      break;
+  }
+
+  // only LIMIT of the tuples are kept
+  q.out = out;
+  if (q.order != 0 && q.sorted.size() >= 2 * (size_t)q.limit) sortTuples(q);
+  return 0;
+}
+
+bool SqlEngine::keyOnly(const Query& q)
+{
+  if (!q.valueCond.empty() || !q.columnCond.empty()) return false;
+  return q.attr == 1 || q.attr == 4 || ((q.attr == 6 || q.attr == 7) && q.column == 0);
+}
+
+bool SqlEngine::isBetter(const Query& q, int key, const char* value, int len)
+{
+  int diff;
+
+  if (q.column == 0){
+    diff = (key < q.aggKey) ? -1 : (key > q.aggKey);
+  }
+  else if (q.schema == NULL){
+    diff = compareValue(value, len, q.aggValue.c_str());
+  }
+  else{
+    Schema::Value v;
+    q.schema->getValue(q.column, q.aggKey, q.aggValue.data(), v);
+    diff = q.schema->compare(q.column, key, value, v);
+  }
+  return (q.attr == 6) ? diff < 0 : diff > 0;
+}
+
+int SqlEngine::scanThreads(PageId pages)
+{
+  int cores = coreCount();
+  int threads = pages / SCAN_PAGES_PER_THREAD;
+  if (threads > cores) threads = cores;
+  return (threads < 1) ? 1 : threads;
+}
+
+int SqlEngine::coreCount()
+{
+  static int cores = 0;
+
+  // the number of cores can be overridden with BRUINBASE_THREADS
+  if (cores == 0){
+    const char* env = getenv("BRUINBASE_THREADS");
+    int n = (env != NULL) ? atoi(env) : (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (n > MAX_SCAN_THREADS) n = MAX_SCAN_THREADS;
+    if (n < 1) n = 1;
+    cores = n;
+  }
+  return cores;
+}
+
+bool SqlEngine::keyRange(const vector<SelCond>& cond, int& keyMin, int& keyMax,
+                         vector<int>& NElist, vector<SelCond>& valueCond)
+{
+  keyMin = INT_MIN;
+  keyMax = INT_MAX;
+  for (unsigned i = 0; i < cond.size(); i++){
+    if (cond[i].attr == 2){
+      valueCond.push_back(cond[i]);
+      continue;
+    }
+    int val = atoi(cond[i].value);
+    switch (cond[i].comp){
+      case SelCond::EQ:   
+        keyMin = max(keyMin, val);
+        keyMax = min(keyMax, val);
+        break;
+      case SelCond::NE:
+        NElist.push_back(val);
+        break;
+      case SelCond::GT:
+        if (val == INT_MAX) return false;
+        keyMin = max(keyMin, val+1);
+        break;
+      case SelCond::LT:
+        if (val == INT_MIN) return false;
+        keyMax = min(keyMax, val-1);
+        break;
+      case SelCond::GE:
+        keyMin = max(keyMin, val);
+        break;
+      case SelCond::LE:
+        keyMax = min(keyMax, val);
+        break;
+    }
+  }
+  return keyMin <= keyMax;
+}
+
+bool SqlEngine::keyBounds(const string& table, const vector<SelCond>& cond,
+                          int& keyMin, int& keyMax)
+{
+  Schema          schema;
+  vector<SelCond> keyCond, valueCond;
+  vector<int>     NElist;
+
+  // in a typed table, the key is "key" or the name of the first column
+  bool typed = (schema.load(table + ".cat") == 0);
+  for (unsigned i = 0; i < cond.size(); i++){
+    if (typed ? (strcmp(cond[i].name, "key") == 0 || schema.findColumn(cond[i].name) == 0)
+              : cond[i].attr == 1){
+      keyCond.push_back(cond[i]);
+      keyCond.back().attr = 1;
+    }
+  }
+  return keyRange(keyCond, keyMin, keyMax, NElist, valueCond);
+}
+
+bool SqlEngine::codeRange(const Dictionary& dict, vector<SelCond>& valueCond,
+                          int& codeMin, int& codeMax)
+{
+  vector<SelCond> NEcond;
+
+  // the codes preserve the order of the values, so every comparison
+  // other than <> narrows down the range of codes
+  codeMin = 0;
+  codeMax = dict.size() - 1;
+  for (unsigned i = 0; i < valueCond.size(); i++){
+    string val(valueCond[i].value);
+    switch (valueCond[i].comp){
+      case SelCond::EQ:
+        codeMin = max(codeMin, dict.lowerBound(val));
+        codeMax = min(codeMax, dict.upperBound(val)-1);
+        break;
+      case SelCond::NE:
+        NEcond.push_back(valueCond[i]);
+        break;
+      case SelCond::GT:
+        codeMin = max(codeMin, dict.upperBound(val));
+        break;
+      case SelCond::LT:
+        codeMax = min(codeMax, dict.lowerBound(val)-1);
+        break;
+      case SelCond::GE:
+        codeMin = max(codeMin, dict.lowerBound(val));
+        break;
+      case SelCond::LE:
+        codeMax = min(codeMax, dict.upperBound(val)-1);
+        break;
+    }
+  }
+  valueCond = NEcond;
+  return codeMin <= codeMax;
+}
+
+void SqlEngine::printTuple(string* out, int attr, int key, const char* value, int len)
+{
+  switch (attr){
+    case 1:  // SELECT key
+      output(out, "%d\n", key);
+      break;
+    case 2:  // SELECT value
+      output(out, "%.*s\n", len, value);
+      break;
+    case 3:  // SELECT *
+      output(out, "%d '%.*s'\n", key, len, value);
+      break;
+  }
+}
+
+
+bool SqlEngine::meetCond(const std::vector<SelCond>& cond, const int key, const char* value, int len)
+{
+  int diff = 0;
+  // check the conditions on the tuple
+  for (unsigned i = 0; i < cond.size(); i++){
+        // compute the difference between the tuple value and the condition value
+    switch (cond[i].attr){
+      case 1:
+        diff = key - atoi(cond[i].value);
+        break;
+      case 2:
+        diff = compareValue(value, len, cond[i].value);
+        break;
+    }
+        
+    // skip the tuple if any condition is not met
+    switch (cond[i].comp){
+      case SelCond::EQ:
+        if (diff != 0) return false;
+        break;
+      case SelCond::NE:
+        if (diff == 0) return false;
+        break;
+      case SelCond::GT:
+        if (diff <= 0) return false;
+        break;
+      case SelCond::LT:
+        if (diff >= 0) return false;
+        break;
+      case SelCond::GE:
+        if (diff < 0) return false;
+        break;
+      case SelCond::LE:
+        if (diff > 0) return false;
+        break;
+    }
+  }
+  return true;
+}
+
+RC SqlEngine::create(const string& table, const vector<ColumnDef>& columns)
+{
+  RC     rc;
+  Schema schema;
+
+  // a table cannot be created twice
+  if (schema.load(table + ".cat") == 0 || tableExists(table) ||
+      ::access((table + ".parts").c_str(), F_OK) == 0){
+    fprintf(stderr, "Error: table %s already exists\n", table.c_str());
+    return RC_INVALID_ATTRIBUTE;
+  }
+
+  for (unsigned i = 0; i < columns.size(); i++){
+    if ((rc = schema.addColumn(columns[i].name, columns[i].type, columns[i].length)) < 0){
+      fprintf(stderr, "Error: invalid column %s %s", columns[i].name, columns[i].type);
+      if (columns[i].length > 0) fprintf(stderr, " %d", columns[i].length);
+      fprintf(stderr, "%s\n", (i == 0) ? " (the first column must be an int key)" : "");
+      return rc;
+    }
+  }
+
+  if ((rc = schema.save(table + ".cat")) < 0){
+    fprintf(stderr, "Error: cannot write the catalog file of table %s\n", table.c_str());
+  }
+  return rc;
+}
+
+RC SqlEngine::createIndex(const string& table, const string& column)
+{
+  RecordFile  rf;
+  ValueIndex  valueIndex;
+  Schema      schema;
+  RC          rc = 0;
+  const char* page;
+  const char* value;
+  int         key, len;
+  vector<int> sids, keys;
+  vector<pair<string, RecordId> > entries;
+
+  if (strcasecmp(column.c_str(), "value") != 0){
+    if (strcasecmp(column.c_str(), "key") == 0) fprintf(stderr, "Error: the index on key is built by LOAD ... WITH INDEX\n");
+    else fprintf(stderr, "Error: no attribute %s\n", column.c_str());
+    return RC_INVALID_ATTRIBUTE;
+  }
+
+  // every partition is indexed on its own
+  Partitioning parts;
+  if (parts.load(table + ".parts") == 0){
+    vector<int> found;
+    findPartitions(table, parts, vector<SelCond>(), found);
+    for (unsigned i = 0; i < found.size(); i++){
+      if ((rc = createIndex(Partitioning::name(table, found[i]), column)) < 0) return rc;
+    }
+    return 0;
+  }
+
+  if (isFrozen(table)) return RC_INVALID_FILE_MODE;
+  if (MemTable::exists(table + ".mem")){
+    fprintf(stderr, "Error: table %s is kept in memory and has no other index\n", table.c_str());
+    return RC_INVALID_FILE_MODE;
+  }
+  if (schema.load(table + ".cat") == 0){
+    fprintf(stderr, "Error: table %s has a schema and has no value column\n", table.c_str());
+    return RC_INVALID_ATTRIBUTE;
+  }
+  if (!PageFile::exists(table + ".tbl") || (rc = rf.open(table + ".tbl", 'r')) < 0){
+    fprintf(stderr, "Error: table %s does not exist\n", table.c_str());
+    return RC_FILE_OPEN_FAILED;
+  }
+
+  // collect every live tuple, reading the values in place
+  PageId endPid = rf.endRid().pid + (rf.endRid().sid > 0 ? 1 : 0);
+  for (PageId pid = 0; pid < endPid && rc == 0; pid++){
+    if ((rc = rf.pinPage(pid, page)) < 0) break;
+    rf.filterPage(page, INT_MIN, INT_MAX, INT_MIN, INT_MAX, sids, keys);
+    for (unsigned i = 0; i < sids.size() && rc == 0; i++){
+      RecordId rid;
+      rid.pid = pid;
+      rid.sid = sids[i];
+      if ((rc = rf.readRef(page, sids[i], key, value, len)) == 0) entries.push_back(make_pair(string(value, len), rid));
+    }
+    rf.unpinPage(page);
+  }
+  rf.close();
+  if (rc < 0){
+    fprintf(stderr, "Error: while reading a tuple from table %s\n", table.c_str());
+    return rc;
+  }
+
+  // the index is built again from scratch, in value order
+  sort(entries.begin(), entries.end());
+  PageFile::remove(table + ".vidx");
+  if ((rc = valueIndex.open(table + ".vidx", 'w')) < 0){
+    fprintf(stderr, "Error: cannot create the value index of table %s\n", table.c_str());
+    return rc;
+  }
+  for (unsigned i = 0; i < entries.size() && rc == 0; i++){
+    rc = valueIndex.insert(entries[i].first, entries[i].second);
+  }
+  if (valueIndex.close() < 0 && rc == 0) rc = RC_FILE_CLOSE_FAILED;
+  if (rc < 0){
+    fprintf(stderr, "Error: cannot create the value index of table %s\n", table.c_str());
+    PageFile::remove(table + ".vidx");
+  }
+  return rc;
+}
+
+RC SqlEngine::partition(const string& table, const vector<int>& bounds)
+{
+  RC           rc;
+  Partitioning parts;
+  Schema       schema;
+
+  // a table is partitioned before it is loaded
+  if (tableExists(table) || ::access((table + ".parts").c_str(), F_OK) == 0){
+    fprintf(stderr, "Error: table %s already exists\n", table.c_str());
+    return RC_INVALID_ATTRIBUTE;
+  }
+  if ((rc = parts.setBounds(bounds)) < 0){
+    fprintf(stderr, "Error: the bounds must be increasing and fewer than %d\n", Partitioning::MAX_PARTITIONS);
+    return rc;
+  }
+
+  // the partitions of a table created by CREATE TABLE have its schema
+  if (schema.load(table + ".cat") == 0){
+    for (int i = 0; i < parts.count(); i++){
+      if ((rc = schema.save(Partitioning::name(table, i) + ".cat")) < 0){
+        fprintf(stderr, "Error: cannot write the catalog file of table %s\n", table.c_str());
+        return rc;
+      }
+    }
+  }
+
+  if ((rc = parts.save(table + ".parts")) < 0){
+    fprintf(stderr, "Error: cannot write the partition file of table %s\n", table.c_str());
+  }
+  return rc;
+}
+
+RC SqlEngine::collect(const string& table, const vector<SelCond>& cond,
+                      RecordFile& rf, BTreeIndex& index, bool& indexed,
+                      ValueIndex& valueIndex, bool& valueIndexed,
+                      Schema& schema, bool& typed, Query& q)
+{
+  RC   rc;
+  bool empty;
+
+  indexed = valueIndexed = false;
+  if (!PageFile::exists(table + ".tbl") || rf.open(table + ".tbl", 'w') < 0){
+    fprintf(stderr, "Error: table %s does not exist\n", table.c_str());
+    return RC_FILE_OPEN_FAILED;
+  }
+
+  // opening a missing index in 'w' mode would create an empty one
+  if (PageFile::exists(table + ".idx")){
+    if ((rc = index.open(table + ".idx", 'w')) < 0){
+      fprintf(stderr, "Error: cannot open the index of table %s\n", table.c_str());
+      return rc;
+    }
+    indexed = true;
+  }
+  if (PageFile::exists(table + ".vidx")){
+    if ((rc = valueIndex.open(table + ".vidx", 'w')) < 0){
+      fprintf(stderr, "Error: cannot open the value index of table %s\n", table.c_str());
+      return rc;
+    }
+    valueIndexed = true;
+  }
+
+  typed = (schema.load(table + ".cat") == 0);
+  if ((rc = prepare(4, "", cond, rf, typed ? &schema : NULL, q, empty)) < 0) return rc;
+
+  // all tuples are collected before any of them is changed
+  q.collect = true;
+  if (empty) return 0;
+  return execute(q, rf, indexed ? &index : NULL, valueIndexed ? &valueIndex : NULL, table);
+}
+
+RC SqlEngine::remove(const string& table, const vector<SelCond>& cond)
+{
+  RecordFile rf;
+  BTreeIndex indexFile;
+  ValueIndex valueIndex;
+  Schema     schema;
+  Query      q;
+  bool       indexed, valueIndexed, typed;
+  RC         rc;
 
-  // set the command line input and start parsing user input
-  sqlin = commandline;
-  sqlparse();  // sqlparse() is defined in SqlParser.tab.c generated from
-               // SqlParser.y by bison (bison is GNU equivalent of yacc)
+  // the tuples are deleted from the partitions in the key range
+  Partitioning parts;
+  if (parts.load(table + ".parts") == 0){
+    vector<int> found;
+    findPartitions(table, parts, cond, found);
+    for (unsigned i = 0; i < found.size(); i++){
+      if ((rc = remove(Partitioning::name(table, found[i]), cond)) < 0) return rc;
+    }
+    return 0;
+  }
 
-  return 0;
+  if (isFrozen(table)) return RC_INVALID_FILE_MODE;
+  if (MemTable::exists(table + ".mem")){
+    vector<pair<int, string> > moved;
+    return changeMemory(table, NULL, cond, INT_MIN, INT_MAX, moved);
+  }
+
+  if ((rc = collect(table, cond, rf, indexFile, indexed, valueIndex, valueIndexed,
+                    schema, typed, q)) == 0){
+    unsigned i;
+    for (i = 0; i < q.rids.size(); i++){
+      // the value is read before the tuple is gone
+      int    key;
+      string value;
+      if (valueIndexed && ((rc = rf.read(q.rids[i], key, value)) < 0 ||
+                           (rc = valueIndex.remove(value, q.rids[i])) < 0)) break;
+      if ((rc = rf.remove(q.rids[i])) < 0) break;
+      if (indexed && (rc = indexFile.remove(q.keys[i], q.rids[i])) < 0) break;
+    }
+    if (rc < 0) fprintf(stderr, "Error: cannot delete a tuple from table %s\n", table.c_str());
+    refreshStats(table, rf.endRid(), rf, -(int)i);
+  }
+
+  if (valueIndexed) valueIndex.close();
+  if (indexed) indexFile.close();
+  rf.close();
+  return rc;
 }
 
-RC SqlEngine::select(int attr, const string& table, const vector<SelCond>& cond)
+RC SqlEngine::update(const string& table, const vector<SelCond>& assigns,
+                     const vector<SelCond>& cond)
 {
-  RecordFile rf;   // RecordFile containing the table
-  RecordId   rid;  // record cursor for table scanning
+  Partitioning parts;
+  vector<pair<int, string> > moved;
+  RC rc = 0;
+
+  if (parts.load(table + ".parts") != 0){
+    return updateTable(table, assigns, cond, INT_MIN, INT_MAX, moved);
+  }
+
+  // a tuple whose new key is out of the range of its partition
+  // moves to the partition of the new key
+  vector<int> found;
+  findPartitions(table, parts, cond, found);
+  for (unsigned i = 0; i < found.size() && rc == 0; i++){
+    int keyMin, keyMax;
+    parts.getRange(found[i], keyMin, keyMax);
+    rc = updateTable(Partitioning::name(table, found[i]), assigns, cond, keyMin, keyMax, moved);
+  }
+
+  // the moved tuples are already removed from their old partitions
+  vector<vector<pair<int, string> > > rows(parts.count());
+  for (unsigned i = 0; i < moved.size(); i++) rows[parts.find(moved[i].first)].push_back(moved[i]);
+  for (int i = 0; i < parts.count(); i++){
+    if (rows[i].empty()) continue;
+    RC moveRc = appendRows(Partitioning::name(table, i), rows[i]);
+    if (rc == 0) rc = moveRc;
+  }
+  return rc;
+}
+
+RC SqlEngine::updateTable(const string& table, const vector<SelCond>& assigns,
+                          const vector<SelCond>& cond, int keyMin, int keyMax,
+                          vector<pair<int, string> >& moved)
+{
+  RecordFile rf;
   BTreeIndex indexFile;
-  vector<SelCond> valueCond;
+  ValueIndex valueIndex;
+  Schema     schema;
+  Query      q;
+  bool       indexed, valueIndexed, typed;
+  RC         rc;
+  vector<int> cols;
+  int        left = 0;
 
-  RC     rc;
-  int    key;     
-  string value;
-  int    count;
-  int    diff;
+  if (isFrozen(table)) return RC_INVALID_FILE_MODE;
+  if (MemTable::exists(table + ".mem")){
+    return changeMemory(table, &assigns, cond, keyMin, keyMax, moved);
+  }
 
-  // open the table file
-  if ((rc = rf.open(table + ".tbl", 'r')) < 0){
-    fprintf(stderr, "Error: table %s does not exist\n", table.c_str());
+  if ((rc = collect(table, cond, rf, indexFile, indexed, valueIndex, valueIndexed,
+                    schema, typed, q)) < 0){
+    if (valueIndexed) valueIndex.close();
+    if (indexed) indexFile.close();
+    rf.close();
     return rc;
   }
+  RecordId oldEnd = rf.endRid();
 
-  //check the index file
-  if(!indexFile.open(table+".idx", 'r')){
-    count = 0;
-    int keyMin = INT_MIN, keyMax = INT_MAX;
-    // check boundary condition
-    bool minequal = false, maxequal = false;
-    vector<int> NElist;
-    for (unsigned i = 0; i < cond.size(); i++){
-      if (cond[i].attr == 2) valueCond.push_back(cond[i]);
-      else{
-        int val = atoi(cond[i].value);
-        switch (cond[i].comp){
-          case SelCond::EQ:   
-            if (val>keyMin){
-              keyMin = val;
-              minequal = true;
-            }
-            if (val<keyMax){
-              keyMax = val;
-              maxequal = true;
-            }
-            break;
-          case SelCond::NE:
-            NElist.push_back(val);
-            break;
-          case SelCond::GT:
-            if (val>keyMin || (val==keyMin && minequal)){
-              keyMin = val;
-              minequal = false;
-            }
-            break;
-          case SelCond::LT:
-            if (val<keyMax || (val==keyMax && minequal)){
-              keyMax = val;
-              maxequal = false;
-            }
-            break;
-          case SelCond::GE:
-            if (val>keyMin){
-              keyMin = val;
-              minequal = true;
-            }
-            break;
-          case SelCond::LE:
-            if (val<keyMax){
-              keyMax = val;
-              maxequal = true;
-            }
-            break;
-        }
+  // find the attributes in the SET clause
+  rc = assignColumns(assigns, typed, schema, cols);
+
+  for (unsigned i = 0; i < q.rids.size() && rc == 0; i++){
+    RecordId rid = q.rids[i];
+    RecordId newRid = rid;
+    int      key, oldKey;
+    string   value, oldValue;
+
+    if ((rc = rf.read(rid, key, value)) < 0) break;
+    oldKey = key;
+    oldValue = value;
+    if ((rc = applyAssigns(assigns, cols, typed, schema, key, value)) < 0) break;
+
+    // a tuple with a key of another partition leaves this one
+    if (key < keyMin || key > keyMax){
+      if ((rc = rf.remove(rid)) < 0 || (indexed && (rc = indexFile.remove(oldKey, rid)) < 0) ||
+          (valueIndexed && (rc = valueIndex.remove(oldValue, rid)) < 0)){
+        fprintf(stderr, "Error: cannot update a tuple of table %s\n", table.c_str());
+        break;
       }
+      moved.push_back(make_pair(key, value));
+      left++;
+      continue;
     }
-    if (keyMin > keyMax || (keyMax == keyMin && (!minequal || !maxequal))){
-      rf.close();
-      return rc;
+
+    // a tuple that outgrows its page moves to the end of the table
+    rc = rf.update(rid, key, value);
+    if (rc == RC_PAGE_FULL && (rc = rf.remove(rid)) == 0){
+      rc = rf.append(key, value, newRid);
+    }
+    if (rc == RC_NOT_IN_DICTIONARY){
+      fprintf(stderr, "Error: '%s' is not in the dictionary of table %s\n", value.c_str(), table.c_str());
+      break;
     }
-    IndexCursor startidx, endidx, temp, currentidx;
-    indexFile.locate(keyMin, startidx);
-    temp = startidx;
-    indexFile.readForward(startidx, key, rid);
-    if (key > keyMin || minequal) startidx = temp;
-
-    if(!indexFile.locate(keyMax, endidx)){
-      temp = endidx;
-      indexFile.readForward(endidx, key, rid);
-      if (key < keyMax || !maxequal) endidx = temp;
-    }   
-
-    currentidx = startidx;
-    while (currentidx.pid!=-1 && (currentidx.pid!=endidx.pid || currentidx.eid!=endidx.eid)){
-      indexFile.readForward(currentidx, key, rid);
-      int i;
-      for (i = 0; i<NElist.size(); i++)
-        if (key == NElist[i]) break;
-      if (i < NElist.size()) continue;
-      if (valueCond.empty() && (attr==1||attr==4)){
-        count++;
-        if (attr == 1)
-        fprintf(stdout, "%d\n", key);
+    if (rc < 0){
+      fprintf(stderr, "Error: cannot update a tuple of table %s\n", table.c_str());
+      break;
+    }
+
+    if (indexed && (key != oldKey || newRid != rid)){
+      if ((rc = indexFile.remove(oldKey, rid)) < 0 || (rc = indexFile.insert(key, newRid)) < 0){
+        fprintf(stderr, "Error: cannot update the index of table %s\n", table.c_str());
       }
-      else{
-        if ((rc = rf.read(rid, key, value)) < 0){
-          fprintf(stderr, "Error: while reading a tuple from table %s\n", table.c_str());
-          rf.close();
-          return rc;
-        }
-        if (meetCond(valueCond, key, value)){
-          count++;                    
-                    // print the tuple
-          switch (attr){
-            case 1:  // SELECT key
-              fprintf(stdout, "%d\n", key);
-              break;
-            case 2:  // SELECT value
-              fprintf(stdout, "%s\n", value.c_str());
-              break;
-            case 3:  // SELECT *
-              fprintf(stdout, "%d '%s'\n", key, value.c_str());
-              break;
-          }
-        }
+    }
+    if (rc == 0 && valueIndexed && (storedValue(value) != oldValue || newRid != rid)){
+      if ((rc = valueIndex.remove(oldValue, rid)) < 0 ||
+          (rc = valueIndex.insert(storedValue(value), newRid)) < 0){
+        fprintf(stderr, "Error: cannot update the value index of table %s\n", table.c_str());
       }
     }
-    // print matching tuple count if "select count(*)"
-    if (attr == 4){
-      fprintf(stdout, "%d\n", count);
+  }
+
+  // moved tuples leave the row count as it is, but not the end of the table
+  refreshStats(table, oldEnd, rf, -left);
+  if (valueIndexed) valueIndex.close();
+  if (indexed) indexFile.close();
+  rf.close();
+  return rc;
+}
+
+RC SqlEngine::changeMemory(const string& table, const vector<SelCond>* assigns,
+                           const vector<SelCond>& cond, int keyMin, int keyMax,
+                           vector<pair<int, string> >& moved)
+{
+  const MemTable* t;
+  RecordFile      rf;
+  Schema          schema;
+  Query           q;
+  bool            empty;
+  vector<int>     cols;
+  RC              rc;
+
+  if ((rc = MemTable::get(table + ".mem", t)) < 0){
+    fprintf(stderr, "Error: cannot read the snapshot of table %s\n", table.c_str());
+    return rc;
+  }
+  bool typed = (schema.load(table + ".cat") == 0);
+  if (assigns != NULL && (rc = assignColumns(*assigns, typed, schema, cols)) < 0) return rc;
+
+  // the tuples to change are found in key order, i.e., in the
+  // order of the arrays
+  if ((rc = prepare(4, "", cond, rf, typed ? &schema : NULL, q, empty)) < 0) return rc;
+  q.collect = true;
+  if (!empty && (rc = scanMemory(q, *t)) < 0) return rc;
+  if (q.rids.empty()) return 0;
+
+  // the table is written again without the deleted tuples and with
+  // the updated ones. a tuple with a key of another partition leaves it
+  vector<pair<int, string> > rows, kept;
+  unsigned next = 0;
+  t->getRows(rows);
+  for (int i = 0; i < (int)rows.size(); i++){
+    if (next >= q.rids.size() || q.rids[next].pid != i){
+      kept.push_back(rows[i]);
+      continue;
     }
-    rf.close();
+    next++;
+    if (assigns == NULL) continue;
+
+    pair<int, string>& row = rows[i];
+    if ((rc = applyAssigns(*assigns, cols, typed, schema, row.first, row.second)) < 0) return rc;
+    row.second = memoryValue(typed, row.second);
+    if (row.first < keyMin || row.first > keyMax) moved.push_back(row);
+    else kept.push_back(row);
+  }
+
+  if ((rc = MemTable::write(table + ".mem", kept)) < 0){
+    fprintf(stderr, "Error: cannot write the snapshot of table %s\n", table.c_str());
     return rc;
   }
+  return memoryStats(table, kept);
 }
 
-
-bool SqlEngine::meetCond(const std::vector<SelCond>& cond, const int key, const string& value)
+RC SqlEngine::vacuum(const string& table)
 {
-  int diff = 0;
-  // check the conditions on the tuple
-  for (unsigned i = 0; i < cond.size(); i++){
-        // compute the difference between the tuple value and the condition value
-    switch (cond[i].attr){
-      case 1:
-        diff = key - atoi(cond[i].value);
-        break;
-      case 2:
-        diff = strcmp(value.c_str(), cond[i].value);
-        break;
+  RecordFile  rf;
+  BTreeIndex  indexFile;
+  RecordIdMap moved;
+  RC          rc;
+
+  // every partition is compacted on its own
+  Partitioning parts;
+  if (parts.load(table + ".parts") == 0){
+    vector<int> found;
+    findPartitions(table, parts, vector<SelCond>(), found);
+    for (unsigned i = 0; i < found.size(); i++){
+      if ((rc = vacuum(Partitioning::name(table, found[i]))) < 0) return rc;
     }
-        
-    // skip the tuple if any condition is not met
-    switch (cond[i].comp){
-      case SelCond::EQ:
-        if (diff != 0) return false;
-        break;
-      case SelCond::NE:
-        if (diff == 0) return false;
-        break;
-      case SelCond::GT:
-        if (diff <= 0) return false;
-        break;
-      case SelCond::LT:
-        if (diff >= 0) return false;
-        break;
-      case SelCond::GE:
-        if (diff < 0) return false;
-        break;
-      case SelCond::LE:
-        if (diff > 0) return false;
-        break;
+    return 0;
+  }
+
+  // a snapshot or a frozen table has no deleted tuples
+  if (MemTable::exists(table + ".mem") || FrozenTable::exists(table + ".frz")) return 0;
+
+  if (!PageFile::exists(table + ".tbl") || rf.open(table + ".tbl", 'w') < 0){
+    fprintf(stderr, "Error: table %s does not exist\n", table.c_str());
+    return RC_FILE_OPEN_FAILED;
+  }
+  RecordId oldEnd = rf.endRid();
+  rc = rf.vacuum(moved);
+  refreshStats(table, oldEnd, rf, 0);
+  rf.close();
+  if (rc < 0){
+    fprintf(stderr, "Error: cannot compact table %s\n", table.c_str());
+    return rc;
+  }
+
+  // the index entries of the moved tuples are fixed up in one pass
+  if (PageFile::exists(table + ".idx")){
+    if ((rc = indexFile.open(table + ".idx", 'w')) == 0){
+      rc = indexFile.remapRids(moved);
+      indexFile.close();
     }
+    if (rc < 0) fprintf(stderr, "Error: cannot update the index of table %s\n", table.c_str());
   }
-  return true;
+  if (rc == 0 && PageFile::exists(table + ".vidx")){
+    ValueIndex valueIndex;
+    if ((rc = valueIndex.open(table + ".vidx", 'w')) == 0){
+      rc = valueIndex.remapRids(moved);
+      valueIndex.close();
+    }
+    if (rc < 0) fprintf(stderr, "Error: cannot update the value index of table %s\n", table.c_str());
+  }
+  return rc;
 }
 
-RC SqlEngine::load(const string& table, const string& loadfile, bool index)
+RC SqlEngine::load(const string& table, const string& loadfile, int options)
 {
   std::ifstream infile;
   infile.open(loadfile.c_str());
@@ -205,8 +1981,83 @@ RC SqlEngine::load(const string& table, const string& loadfile, bool index)
     fprintf(stderr, "Error: file %s doesn't exist or cannot open\n", loadfile.c_str());
     return RC_FILE_OPEN_FAILED;
   }
+
+  // the rows of a partitioned table are loaded into its partitions
+  Partitioning parts;
+  if(parts.load(table + ".parts") == 0) return loadPartitions(table, parts, infile, options);
+  return loadTable(table, infile, options);
+}
+
+RC SqlEngine::loadPartitions(const string& table, const Partitioning& parts,
+                             istream& infile, int options)
+{
+  string line, value;
+  int    key;
+
+  // the key comes first in a line of a key-value table
+  // and of a typed table alike
+  vector<string> rows(parts.count());
+  while(getline(infile, line)){
+    parseLoadLine(line, key, value);
+    string& r = rows[parts.find(key)];
+    r += line;
+    r += '\n';
+  }
+
+  // a new partition is created even if it gets no rows, so that all
+  // partitions have the same files. a dictionary cannot be built
+  // without values, though
+  vector<PartitionTask> tasks;
+  for(int i = 0; i < parts.count(); i++){
+    string name = Partitioning::name(table, i);
+    if(rows[i].empty() && tableExists(name)) continue;
+    tasks.push_back(PartitionTask());
+    tasks.back().table = name;
+    tasks.back().rows.swap(rows[i]);
+    tasks.back().options = options;
+    if(tasks.back().rows.empty()) tasks.back().options &= ~LOAD_DICTIONARY;
+  }
+  runPartitions(tasks, loadWorker);
+
+  for(unsigned i = 0; i < tasks.size(); i++){
+    if(tasks[i].rc < 0) return tasks[i].rc;
+  }
+  return 0;
+}
+
+void* SqlEngine::loadWorker(void* arg)
+{
+  PartitionTask* task = (PartitionTask*) arg;
+  std::istringstream in(task->rows);
+
+  task->rows.clear();
+  task->rc = loadTable(task->table, in, task->options);
+  return NULL;
+}
+
+RC SqlEngine::loadTable(const string& table, istream& infile, int options)
+{
+  bool index = (options & LOAD_INDEX) != 0;
+
+  // a table created by CREATE TABLE is stored in binary rows
+  Schema schema;
+  bool typed = (schema.load(table + ".cat") == 0);
+  if(typed && (options & (LOAD_PAX | LOAD_DICTIONARY | LOAD_BLOOM))){
+    fprintf(stderr, "Error: table %s has a schema and is stored in binary rows\n", table.c_str());
+    return RC_INVALID_ATTRIBUTE;
+  }
+
+  if(isFrozen(table)) return RC_INVALID_FILE_MODE;
+
+  // a memory table stays in memory
+  if((options & LOAD_MEMORY) || MemTable::exists(table + ".mem")){
+    return loadMemory(table, infile, options, typed ? &schema : NULL);
+  }
+
   RecordFile outfile;
-  if(outfile.open(table + ".tbl", 'w')){
+  int layout = (options & LOAD_PAX) ? RecordFile::PAX_LAYOUT : RecordFile::ROW_LAYOUT;
+  if(typed) layout = RecordFile::TUPLE_LAYOUT;
+  if(outfile.open(table + ".tbl", 'w', layout)){
     fprintf(stderr, "Error: file %s doesn't exist or cannot be created\n", table.c_str());
     return RC_FILE_OPEN_FAILED;
   }
@@ -218,32 +2069,324 @@ RC SqlEngine::load(const string& table, const string& loadfile, bool index)
     }
   }
 
+  // a value index made by CREATE INDEX takes the new rows, too
+  ValueIndex valueIndex;
+  bool valueIndexed = PageFile::exists(table + ".vidx");
+  if(valueIndexed && valueIndex.open(table + ".vidx", 'w')){
+    fprintf(stderr, "Error: cannot open the value index of table %s\n", table.c_str());
+    return RC_FILE_OPEN_FAILED;
+  }
+
+  // the statistics of a new table are collected as its rows are stored
+  TableStats stats;
+  bool fresh = (outfile.endRid().pid == 0 && outfile.endRid().sid == 0);
+
   string line;
   int key;
   string value;
-  RecordId rid;
+
+  // with a dictionary, the values are read once to build the
+  // dictionary before any record is stored
+  if(options & LOAD_DICTIONARY){
+    vector<string> values;
+    while(getline(infile, line)){
+      parseLoadLine(line, key, value);
+      values.push_back(value);
+    }
+    if(outfile.setDictionary(values)){
+      fprintf(stderr, "Error: cannot create a dictionary for table %s (is it empty?)\n", table.c_str());
+      return RC_FILE_WRITE_FAILED;
+    }
+    infile.clear();
+    infile.seekg(0);
+  }
+
+  // the Bloom filters get the values as the rows are stored
+  if((options & LOAD_BLOOM) && !outfile.hasBloomFilter() && outfile.setBloomFilter()){
+    fprintf(stderr, "Error: cannot create the Bloom filters of table %s\n", table.c_str());
+    return RC_FILE_WRITE_FAILED;
+  }
+
+  // a clustered table is stored in key order, so all rows are
+  // read and sorted before any of them is stored
+  bool clustered = (options & LOAD_CLUSTERED) != 0;
+  vector<pair<int, string> > rows;
+  vector<IndexEntry> entries;
+  if(clustered && !outfile.isClustered() && outfile.setClustered()){
+    fprintf(stderr, "Error: table %s must be empty to be clustered\n", table.c_str());
+    return RC_INVALID_FILE_MODE;
+  }
 
   while(getline(infile, line)){
-    parseLoadLine(line, key, value);
-    if(outfile.append(key, value, rid)){
-      fprintf(stderr, "Error: cannot append record into file %s \n", table.c_str()); 
-      return RC_FILE_WRITE_FAILED;     
-    }
-    if(index){
-      if(indexFile.insert(key, rid)){
-        fprintf(stderr, "Error: cannot insert record into index file %s \n", table.c_str()); 
-        return RC_FILE_WRITE_FAILED;             
+    if(typed){
+      if(schema.parseRow(line, key, value)){
+        fprintf(stderr, "Error: the row is too long: %s\n", line.c_str());
+        continue;
       }
     }
+    else parseLoadLine(line, key, value);
+    if(clustered){
+      rows.push_back(make_pair(key, value));
+    }
+    else if(storeRow(outfile, index ? &entries : NULL, valueIndexed ? &valueIndex : NULL,
+                     table, key, value)){
+      return RC_FILE_WRITE_FAILED;
+    }
+    else if(fresh) addStats(stats, typed, key, value);
+  }
+
+  stable_sort(rows.begin(), rows.end(), lessKey<string>);
+  for(unsigned i = 0; i < rows.size(); i++){
+    if(storeRow(outfile, index ? &entries : NULL, valueIndexed ? &valueIndex : NULL,
+                table, rows[i].first, rows[i].second)){
+      return RC_FILE_WRITE_FAILED;
+    }
+    if(fresh) addStats(stats, typed, rows[i].first, rows[i].second);
+  }
+  if(index && indexFile.insertBatch(entries)){
+    fprintf(stderr, "Error: cannot insert record into index file %s \n", table.c_str()); 
+    return RC_FILE_WRITE_FAILED;
+  }
+  if(fresh && saveStats(stats, table, outfile, index ? &indexFile : NULL)){
+    fprintf(stderr, "Error: cannot write the statistics of table %s\n", table.c_str());
+  }
+  if(outfile.close()){
+    fprintf(stderr, "Error: cannot write table %s\n", table.c_str());
+    return RC_FILE_WRITE_FAILED;
   }
-  infile.close();
-  outfile.close();
   if(index){
     indexFile.close();
   }
+  if(valueIndexed){
+    valueIndex.close();
+  }
+
+  // the rows already in the table are not collected while loading.
+  // all of them are analyzed again
+  return fresh ? 0 : analyze(table);
+}
+
+RC SqlEngine::loadMemory(const string& table, istream& infile, int options, const Schema* schema)
+{
+  RC     rc;
+  string line, value;
+  int    key;
+  vector<pair<int, string> > rows;
+
+  // the sorted arrays are the index of the table
+  if(options & (LOAD_PAX | LOAD_DICTIONARY | LOAD_CLUSTERED | LOAD_BLOOM)){
+    fprintf(stderr, "Error: table %s is kept in memory and has no other storage options\n", table.c_str());
+    return RC_INVALID_ATTRIBUTE;
+  }
+  if(PageFile::exists(table + ".tbl")){
+    fprintf(stderr, "Error: table %s is stored on disk\n", table.c_str());
+    return RC_INVALID_FILE_MODE;
+  }
+
+  // the rows are added to those already in the table
+  if(MemTable::exists(table + ".mem")){
+    const MemTable* t;
+    if((rc = MemTable::get(table + ".mem", t)) < 0){
+      fprintf(stderr, "Error: cannot read the snapshot of table %s\n", table.c_str());
+      return rc;
+    }
+    t->getRows(rows);
+  }
+
+  while(getline(infile, line)){
+    if(schema != NULL){
+      if(schema->parseRow(line, key, value)){
+        fprintf(stderr, "Error: the row is too long: %s\n", line.c_str());
+        continue;
+      }
+    }
+    else parseLoadLine(line, key, value);
+    rows.push_back(make_pair(key, memoryValue(schema != NULL, value)));
+  }
+
+  if((rc = MemTable::write(table + ".mem", rows)) < 0){
+    fprintf(stderr, "Error: cannot write the snapshot of table %s\n", table.c_str());
+    return rc;
+  }
+  if(memoryStats(table, rows) < 0){
+    fprintf(stderr, "Error: cannot write the statistics of table %s\n", table.c_str());
+  }
   return 0;
 }
 
+RC SqlEngine::analyze(const string& table)
+{
+  RecordFile  rf;
+  BTreeIndex  indexFile;
+  TableStats  stats;
+  RC          rc = 0;
+  const char* page;
+  const char* value;
+  int         key, len;
+  vector<int> sids, keys;
+
+  // every partition has statistics of its own
+  Partitioning parts;
+  if (parts.load(table + ".parts") == 0){
+    vector<int> found;
+    findPartitions(table, parts, vector<SelCond>(), found);
+    for (unsigned i = 0; i < found.size(); i++){
+      if ((rc = analyze(Partitioning::name(table, found[i]))) < 0) return rc;
+    }
+    return 0;
+  }
+
+  if (MemTable::exists(table + ".mem")){
+    const MemTable* t;
+    vector<pair<int, string> > rows;
+    if ((rc = MemTable::get(table + ".mem", t)) < 0){
+      fprintf(stderr, "Error: cannot read the snapshot of table %s\n", table.c_str());
+      return rc;
+    }
+    t->getRows(rows);
+    if ((rc = memoryStats(table, rows)) < 0){
+      fprintf(stderr, "Error: cannot write the statistics of table %s\n", table.c_str());
+    }
+    return rc;
+  }
+
+  if (FrozenTable::exists(table + ".frz")){
+    const FrozenTable* t;
+    vector<pair<int, string> > rows;
+    if ((rc = FrozenTable::get(table + ".frz", t)) < 0 || (rc = t->getRows(rows)) < 0){
+      fprintf(stderr, "Error: cannot read the frozen table %s\n", table.c_str());
+      return rc;
+    }
+    if ((rc = memoryStats(table, rows, frozenPages(*t))) < 0){
+      fprintf(stderr, "Error: cannot write the statistics of table %s\n", table.c_str());
+    }
+    return rc;
+  }
+
+  if ((rc = rf.open(table + ".tbl", 'r')) < 0){
+    fprintf(stderr, "Error: table %s does not exist\n", table.c_str());
+    return rc;
+  }
+
+  // collect every live tuple, reading the values in place
+  PageId endPid = rf.endRid().pid + (rf.endRid().sid > 0 ? 1 : 0);
+  for (PageId pid = 0; pid < endPid && rc == 0; pid++){
+    if ((rc = rf.pinPage(pid, page)) < 0) break;
+    rf.filterPage(page, INT_MIN, INT_MAX, INT_MIN, INT_MAX, sids, keys);
+    for (unsigned i = 0; i < sids.size() && rc == 0; i++){
+      if ((rc = rf.readRef(page, sids[i], key, value, len)) == 0) stats.add(key, value, len);
+    }
+    rf.unpinPage(page);
+  }
+  if (rc < 0){
+    fprintf(stderr, "Error: while reading a tuple from table %s\n", table.c_str());
+    rf.close();
+    return rc;
+  }
+
+  // the index is opened only if it exists, so that none is created
+  bool indexed = (PageFile::exists(table + ".idx") &&
+                  indexFile.open(table + ".idx", 'r') == 0);
+  if ((rc = saveStats(stats, table, rf, indexed ? &indexFile : NULL)) < 0){
+    fprintf(stderr, "Error: cannot write the statistics of table %s\n", table.c_str());
+  }
+  if (indexed) indexFile.close();
+  rf.close();
+  return rc;
+}
+
+RC SqlEngine::freeze(const string& table, int options)
+{
+  RecordFile  rf;
+  Schema      schema;
+  RC          rc = 0;
+  const char* page;
+  const char* value;
+  int         key, len;
+  vector<int> sids, keys;
+  vector<pair<int, string> > rows;
+
+  // every partition is frozen on its own
+  Partitioning parts;
+  if (parts.load(table + ".parts") == 0){
+    vector<int> found;
+    findPartitions(table, parts, vector<SelCond>(), found);
+    for (unsigned i = 0; i < found.size(); i++){
+      if ((rc = freeze(Partitioning::name(table, found[i]), options)) < 0) return rc;
+    }
+    return 0;
+  }
+
+  bool typed = (schema.load(table + ".cat") == 0);
+  if (options & ~LOAD_BLOOM){
+    fprintf(stderr, "Error: a frozen table has no storage options but BLOOM\n");
+    return RC_INVALID_ATTRIBUTE;
+  }
+  if (typed && (options & LOAD_BLOOM)){
+    fprintf(stderr, "Error: table %s has a schema and is stored in binary rows\n", table.c_str());
+    return RC_INVALID_ATTRIBUTE;
+  }
+
+  // the tuples are read from the table wherever it is. a frozen
+  // table is frozen again with the new options
+  if (FrozenTable::exists(table + ".frz")){
+    const FrozenTable* t;
+    if ((rc = FrozenTable::get(table + ".frz", t)) < 0 || (rc = t->getRows(rows)) < 0){
+      fprintf(stderr, "Error: cannot read the frozen table %s\n", table.c_str());
+      return rc;
+    }
+  }
+  else if (MemTable::exists(table + ".mem")){
+    const MemTable* t;
+    if ((rc = MemTable::get(table + ".mem", t)) < 0){
+      fprintf(stderr, "Error: cannot read the snapshot of table %s\n", table.c_str());
+      return rc;
+    }
+    t->getRows(rows);
+  }
+  else{
+    if (!PageFile::exists(table + ".tbl") || (rc = rf.open(table + ".tbl", 'r')) < 0){
+      fprintf(stderr, "Error: table %s does not exist\n", table.c_str());
+      return RC_FILE_OPEN_FAILED;
+    }
+    PageId endPid = rf.endRid().pid + (rf.endRid().sid > 0 ? 1 : 0);
+    for (PageId pid = 0; pid < endPid && rc == 0; pid++){
+      if ((rc = rf.pinPage(pid, page)) < 0) break;
+      rf.filterPage(page, INT_MIN, INT_MAX, INT_MIN, INT_MAX, sids, keys);
+      for (unsigned i = 0; i < sids.size() && rc == 0; i++){
+        if ((rc = rf.readRef(page, sids[i], key, value, len)) == 0) rows.push_back(make_pair(key, string(value, len)));
+      }
+      rf.unpinPage(page);
+    }
+    rf.close();
+    if (rc < 0){
+      fprintf(stderr, "Error: while reading a tuple from table %s\n", table.c_str());
+      return rc;
+    }
+  }
+
+  if ((rc = FrozenTable::write(table + ".frz", rows, (options & LOAD_BLOOM) != 0)) < 0){
+    fprintf(stderr, "Error: cannot write the frozen table %s\n", table.c_str());
+    return rc;
+  }
+
+  // the old storage of the table is not needed any more
+  ::unlink((table + ".mem").c_str());
+  PageFile::remove(table + ".tbl");
+  PageFile::remove(table + ".tbl.dict");
+  PageFile::remove(table + ".tbl.bloom");
+  ::unlink((table + ".tbl.clustered").c_str());
+  PageFile::remove(table + ".idx");
+  PageFile::remove(table + ".vidx");
+
+  const FrozenTable* t;
+  if ((rc = FrozenTable::get(table + ".frz", t)) < 0 ||
+      (rc = memoryStats(table, rows, frozenPages(*t))) < 0){
+    fprintf(stderr, "Error: cannot write the statistics of table %s\n", table.c_str());
+  }
+  return rc;
+}
+
 RC SqlEngine::parseLoadLine(const string& line, int& key, string& value)
 {
     const char *s;
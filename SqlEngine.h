@@ -10,18 +10,36 @@
 #ifndef SQLENGINE_H
 #define SQLENGINE_H
 
+#include <climits>
+#include <iosfwd>
+#include <string>
 #include <vector>
 #include "Bruinbase.h"
 #include "RecordFile.h"
 #include "BTreeIndex.h"
+#include "ValueIndex.h"
+#include "Schema.h"
+#include "Partitioning.h"
+#include "MemTable.h"
+#include "FrozenTable.h"
 
 /**
  * data structure to represent a condition in the WHERE clause
  */
 struct SelCond {
-  int attr;     // attribute: 1 - key column,  2 - value column
+  int attr;     // attribute: 1 - key column,  2 - value column, 0 - other
   enum Comparator { EQ, NE, LT, GT, LE, GE } comp;
   char* value;  // the value to compare
+  char* name;   // the attribute name (a column name of a typed table)
+};
+
+/**
+ * data structure to represent a column in CREATE TABLE
+ */
+struct ColumnDef {
+  char* name;   // the column name
+  char* type;   // the type name
+  int length;   // the length of a CHAR column (0 if not given)
 };
 
 /**
@@ -29,6 +47,25 @@ struct SelCond {
  */
 class SqlEngine {
  public:
+
+  // options of the LOAD command given in its WITH clause
+  static const int LOAD_INDEX = 1;  // "WITH INDEX": build a B+tree on key
+  static const int LOAD_PAX   = 2;  // "WITH PAX": store the table in PAX pages
+  static const int LOAD_DICTIONARY = 4;  // "WITH DICTIONARY": dictionary-encode values
+  static const int LOAD_CLUSTERED = 8;   // "WITH CLUSTERED": store the table in key order
+  static const int LOAD_BLOOM = 16;      // "WITH BLOOM": keep Bloom filters of values
+  static const int LOAD_MEMORY = 32;     // "WITH MEMORY": keep the table in memory (see MemTable)
+
+  // an index scan that reads more than BITMAP_SCAN_ROWS tuples reads
+  // them in the order of their rids (a bitmap heap scan). the rids of
+  // up to BITMAP_EXACT_ROWS tuples are kept; beyond that only their pages.
+  static const int BITMAP_SCAN_ROWS  = 32;
+  static const int BITMAP_EXACT_ROWS = 65536;
+
+  // a table scan is split among up to MAX_SCAN_THREADS threads (one per
+  // core), each of which scans at least SCAN_PAGES_PER_THREAD pages
+  static const int MAX_SCAN_THREADS      = 16;
+  static const int SCAN_PAGES_PER_THREAD = 64;
     
   /**
    * takes the user commands from commandline and executes them.
@@ -44,21 +81,117 @@ class SqlEngine {
    * all conditions in conds must be ANDed together.
    * the result of the SELECT is printed on screen.
    * @param attr[IN] attribute in the SELECT clause
-   * (1: key, 2: value, 3: *, 4: count(*))
+   * (1: key, 2: value, 3: *, 4: count(*), 5: another column,
+   *  6: MIN of column, 7: MAX of column)
+   * @param table[IN] the table name in the FROM clause
+   * @param conds[IN] list of conditions in the WHERE clause
+   * @param column[IN] the attribute name in the SELECT clause (or of MIN/MAX)
+   * @param order[IN] ORDER BY key: 1 for ascending, -1 for descending key
+   *                  order, 0 without ORDER BY
+   * @param limit[IN] the most tuples printed (LIMIT)
+   * @return error code. 0 if no error
+   */
+  static RC select(int attr, const std::string& table, const std::vector<SelCond>& conds,
+                   const std::string& column, int order = 0, int limit = INT_MAX);
+
+  /**
+   * executes a DELETE statement.
+   * the tuples that meet all conditions in conds are deleted from the
+   * table and from its index. their slots are reclaimed by vacuum().
    * @param table[IN] the table name in the FROM clause
    * @param conds[IN] list of conditions in the WHERE clause
    * @return error code. 0 if no error
    */
-  static RC select(int attr, const std::string& table, const std::vector<SelCond>& conds);
+  static RC remove(const std::string& table, const std::vector<SelCond>& conds);
+
+  /**
+   * executes an UPDATE statement.
+   * the tuples that meet all conditions in conds are rewritten in place
+   * with the attributes in assigns set to the given values. a tuple that 
+   * no longer fits in its page is moved to the end of the table.
+   * @param table[IN] the table name in the UPDATE clause
+   * @param assigns[IN] the attributes and their new values in the SET clause
+   * @param conds[IN] list of conditions in the WHERE clause
+   * @return error code. 0 if no error
+   */
+  static RC update(const std::string& table, const std::vector<SelCond>& assigns,
+                   const std::vector<SelCond>& conds);
+
+  /**
+   * executes a VACUUM statement.
+   * the table is compacted to reclaim the slots of deleted tuples and
+   * the index of the table is updated with the new locations of the tuples.
+   * @param table[IN] the table to compact
+   * @return error code. 0 if no error
+   */
+  static RC vacuum(const std::string& table);
+
+  /**
+   * executes an ANALYZE statement.
+   * the statistics of the table and of its index (row and page counts,
+   * key range and histogram, value lengths, # distinct keys and values,
+   * height and fill of the B+tree) are collected and stored in the
+   * statistics file of the table (see TableStats). LOAD collects them, too.
+   * @param table[IN] the table to analyze
+   * @return error code. 0 if no error
+   */
+  static RC analyze(const std::string& table);
+
+  /**
+   * executes a PARTITION statement.
+   * the table is declared as partitioned on key at the given bounds (see
+   * Partitioning). LOAD routes the rows of the table to its partitions,
+   * and the other commands run on the partitions that may have tuples in
+   * the key range of their conditions.
+   * @param table[IN] the table to partition. it must not be loaded yet
+   * @param bounds[IN] the smallest keys of the partitions after the first
+   * @return error code. 0 if no error
+   */
+  static RC partition(const std::string& table, const std::vector<int>& bounds);
+
+  /**
+   * executes a FREEZE statement.
+   * the table is rewritten into a read-only frozen table (see FrozenTable):
+   * full compressed blocks of tuples in key order with a sparse index,
+   * which replace the record file and the index of the table. queries
+   * read the frozen table, and the commands that change it fail.
+   * @param table[IN] the table to freeze
+   * @param options[IN] LOAD_BLOOM keeps Bloom filters of the values of
+   *                    the blocks. no other option is allowed
+   * @return error code. 0 if no error
+   */
+  static RC freeze(const std::string& table, int options);
+
+  /**
+   * create a table with typed columns. the schema is stored in the
+   * catalog file of the table, and LOAD stores the rows of the table
+   * in a binary format computed from the schema.
+   * @param table[IN] the table name in the CREATE TABLE command
+   * @param columns[IN] the columns of the table. the first is the key.
+   * @return error code. 0 if no error
+   */
+  static RC create(const std::string& table, const std::vector<ColumnDef>& columns);
+
+  /**
+   * executes a CREATE INDEX statement.
+   * a secondary index on the value column (see ValueIndex) is built from
+   * the tuples of the table and kept up to date by LOAD, DELETE, UPDATE
+   * and VACUUM. SELECT uses it for the conditions on value when the key
+   * is not restricted. the key index is built by LOAD ... WITH INDEX.
+   * @param table[IN] the table to index. it must be a key-value table on disk
+   * @param column[IN] the column to index. only "value" can be indexed
+   * @return error code. 0 if no error
+   */
+  static RC createIndex(const std::string& table, const std::string& column);
 
   /**
    * load a table from a load file.
    * @param table[IN] the table name in the LOAD command
    * @param loadfile[IN] the file name of the load file
-   * @param index[IN] true if "WITH INDEX" option was specified
+   * @param options[IN] the options in the WITH clause (LOAD_INDEX, ...)
    * @return error code. 0 if no error
    */
-  static RC load(const std::string& table, const std::string& loadfile, bool index);
+  static RC load(const std::string& table, const std::string& loadfile, int options);
 
   /**
    * parse a line from the load file into the (key, value) pair.
@@ -70,7 +203,292 @@ class SqlEngine {
   static RC parseLoadLine(const std::string& line, int& key, std::string& value);
 
 private:
-    static bool meetCond(const std::vector<SelCond>& conds, const int key, const std::string& value);
+    struct Query;     // a SELECT statement prepared for a table
+    struct ScanTask;  // a part of a table scan run by a worker thread
+    struct PartitionTask; // a partition of a table queried or loaded by a thread
+
+    /**
+     * run a SELECT statement on a table that is not partitioned, without
+     * printing the count or the MIN/MAX (see printResult()).
+     * @param schema[OUT] the schema of a typed table, used by q
+     * @param q[OUT] the query with its result
+     * @param out[IN] the buffer for the printed tuples (NULL: stdout)
+     * @param order[IN] ORDER BY key, as in select()
+     * @param limit[IN] the most tuples printed
+     * @return error code. 0 if no error
+     */
+    static RC query(int attr, const std::string& table, const std::vector<SelCond>& conds,
+                    const std::string& column, Schema& schema, Query& q, std::string* out,
+                    int order = 0, int limit = INT_MAX);
+
+    /**
+     * print the count or the MIN/MAX of a query, if it has one.
+     */
+    static void printResult(const Query& q);
+
+    /**
+     * run a SELECT statement on the partitions of a table, in parallel,
+     * and print the merged result. with ORDER BY, the partitions are
+     * queried one after another in key order until LIMIT tuples are printed.
+     * @return error code. 0 if no error
+     */
+    static RC selectPartitions(int attr, const std::string& table, const Partitioning& parts,
+                               const std::vector<SelCond>& conds, const std::string& column,
+                               int order, int limit);
+
+    /**
+     * find the loaded partitions of a table that may have tuples in the
+     * key range of the conditions.
+     * @param found[OUT] the partitions, in key order
+     */
+    static void findPartitions(const std::string& table, const Partitioning& parts,
+                               const std::vector<SelCond>& conds, std::vector<int>& found);
+
+    /**
+     * run the tasks, up to one per core at a time.
+     * @param worker[IN] the function that runs a task
+     */
+    static void runPartitions(std::vector<PartitionTask>& tasks, void* (*worker)(void*));
+
+    /**
+     * the bodies of the threads that run SELECT and LOAD on a partition
+     */
+    static void* selectWorker(void* task);
+    static void* loadWorker(void* task);
+
+    /**
+     * load a table that is not partitioned from the lines of a load file.
+     * @return error code. 0 if no error
+     */
+    static RC loadTable(const std::string& table, std::istream& in, int options);
+
+    /**
+     * route the lines of a load file to the partitions of a table by
+     * their key, and load the partitions in parallel.
+     * @return error code. 0 if no error
+     */
+    static RC loadPartitions(const std::string& table, const Partitioning& parts,
+                             std::istream& in, int options);
+
+    /**
+     * load a memory table from the lines of a load file.
+     * @param schema[IN] the schema of a typed table. NULL for a key-value table
+     * @return error code. 0 if no error
+     */
+    static RC loadMemory(const std::string& table, std::istream& in, int options,
+                         const Schema* schema);
+
+    /**
+     * run a DELETE (assigns is NULL) or an UPDATE statement on a memory
+     * table, and write the snapshot of the table. the updated tuples whose
+     * new key is out of [keyMin, keyMax] are removed from the table and
+     * returned in moved.
+     * @return error code. 0 if no error
+     */
+    static RC changeMemory(const std::string& table, const std::vector<SelCond>* assigns,
+                           const std::vector<SelCond>& conds, int keyMin, int keyMax,
+                           std::vector<std::pair<int, std::string> >& moved);
+
+    /**
+     * run a prepared query on a memory table. the tuples are found by a
+     * binary search on the key range. the rid of a tuple is (its place
+     * in the table, 0).
+     * @return error code. 0 if no error
+     */
+    static RC scanMemory(Query& q, const MemTable& t);
+
+    /**
+     * run a prepared query on a frozen table. only the blocks that may
+     * have tuples in the key range are decoded. the rid of a tuple is
+     * (its place in the table, 0).
+     * @return error code. 0 if no error
+     */
+    static RC scanFrozen(Query& q, const FrozenTable& t);
+
+    /**
+     * run an UPDATE statement on a table that is not partitioned.
+     * the tuples whose new key is out of [keyMin, keyMax] are removed
+     * from the table and returned in moved.
+     * @return error code. 0 if no error
+     */
+    static RC updateTable(const std::string& table, const std::vector<SelCond>& assigns,
+                          const std::vector<SelCond>& conds, int keyMin, int keyMax,
+                          std::vector<std::pair<int, std::string> >& moved);
+
+    /**
+     * sort out the conditions of a SELECT on a table into a query.
+     * @param schema[IN] the schema of a typed table. NULL for a key-value table
+     * @param q[OUT] the prepared query
+     * @param empty[OUT] true if no tuple can meet the conditions
+     * @param order[IN] ORDER BY key, as in select()
+     * @param limit[IN] the most tuples printed
+     * @return error code. 0 if no error
+     */
+    static RC prepare(int attr, const std::string& column, const std::vector<SelCond>& conds,
+                      const RecordFile& rf, const Schema* schema, Query& q, bool& empty,
+                      int order = 0, int limit = INT_MAX);
+
+    /**
+     * run a prepared query on the table: read the index in key order for
+     * an ORDER BY with a small LIMIT, look up the value range in the
+     * value index if the key is not restricted, the key range in the
+     * index if there is one, otherwise scan the table.
+     * @param index[IN] the index of the table. NULL if there is none
+     * @param valueIndex[IN] the value index of the table. NULL if there is none
+     * @return error code. 0 if no error
+     */
+    static RC execute(Query& q, const RecordFile& rf, BTreeIndex* index,
+                      ValueIndex* valueIndex, const std::string& table);
+
+    /**
+     * scan the pages [beginPid, endPid) of the table for a prepared query.
+     * @return error code. 0 if no error
+     */
+    static RC scanPages(Query& q, const RecordFile& rf, PageId beginPid, PageId endPid,
+                        const std::string& table);
+
+    /**
+     * the body of a worker thread of a parallel scan. runs scanPages()
+     * on a ScanTask.
+     */
+    static void* scanWorker(void* task);
+
+    /**
+     * @return # threads to scan the given # pages with
+     */
+    static int scanThreads(PageId pages);
+
+    /**
+     * @return # cores to run threads on
+     */
+    static int coreCount();
+
+    /**
+     * run a prepared query through the index of the table. the tuples
+     * are read in key order, or in rid order if there are many of them.
+     * @return error code. 0 if no error
+     */
+    static RC indexScan(Query& q, const RecordFile& rf, BTreeIndex& index,
+                        const std::string& table);
+
+    /**
+     * run a prepared query with ORDER BY key through the index of the
+     * table: forward from the lowest key, or backward from the highest
+     * key with BTreeIndex::readBackward(). the tuples are printed as they
+     * come, and the scan stops after LIMIT of them.
+     * @return error code. 0 if no error
+     */
+    static RC orderScan(Query& q, const RecordFile& rf, BTreeIndex& index,
+                        const std::string& table);
+
+    /**
+     * sort the tuples that an ORDER BY query printed aside by key, and
+     * keep the first (or, descending, the last) LIMIT of them.
+     */
+    static void sortTuples(Query& q);
+
+    /**
+     * print the tuples that an ORDER BY query printed aside, in order.
+     */
+    static void printSorted(Query& q);
+
+    /**
+     * estimate # tuples with a value in the range of a prepared query:
+     * from the statistics of the table for a single value, otherwise by
+     * counting the entries of the value index, up to limit.
+     * @return the estimate
+     */
+    static int valueRows(const Query& q, ValueIndex& valueIndex, const RecordFile& rf,
+                         const std::string& table, int limit);
+
+    /**
+     * run a prepared query through the value index of the table. the
+     * rids in the value range are collected, and the tuples are read in
+     * rid order, as a table scan reads them.
+     * @return error code. 0 if no error
+     */
+    static RC valueScan(Query& q, const RecordFile& rf, ValueIndex& valueIndex,
+                        const std::string& table);
+
+    /**
+     * check the tuple at rid with the key against the conditions of the
+     * query not checked yet. count and print it if it meets them.
+     * the tuple is read in place from the page of rid, pinned by the
+     * caller, or with RecordFile::read() if page is NULL (the query
+     * needs only the key, or reads a few tuples through the row cache).
+     * @return error code. 0 if no error
+     */
+    static RC emitTuple(Query& q, const RecordFile& rf, const char* page, const RecordId& rid, int key);
+
+    /**
+     * @return true if the tuple meets the conditions of the query on the
+     *         columns of a typed table
+     */
+    static bool meetColumnCond(const Query& q, int key, const char* value);
+
+    /**
+     * count a tuple that met the conditions of the query, and print it
+     * or collect it.
+     * @return error code. 0 if no error
+     */
+    static RC countTuple(Query& q, const RecordId& rid, int key, const char* value, int len);
+
+    /**
+     * @return true if the query can be answered from the keys alone
+     */
+    static bool keyOnly(const Query& q);
+
+    /**
+     * @return true if the tuple is a better MIN/MAX than the one in the query
+     */
+    static bool isBetter(const Query& q, int key, const char* value, int len);
+
+    /**
+     * collect the tuples of a table that meet the conditions for DELETE
+     * and UPDATE. the table is opened in 'w' mode, together with its
+     * index and its value index if it has them.
+     * @param indexed[OUT] whether the index of the table is open
+     * @param valueIndexed[OUT] whether the value index of the table is open
+     * @return error code. 0 if no error
+     */
+    static RC collect(const std::string& table, const std::vector<SelCond>& conds,
+                      RecordFile& rf, BTreeIndex& index, bool& indexed,
+                      ValueIndex& valueIndex, bool& valueIndexed,
+                      Schema& schema, bool& typed, Query& q);
+
+    static bool meetCond(const std::vector<SelCond>& conds, const int key, const char* value, int len);
+
+    /**
+     * collect the conditions on key into the range [keyMin, keyMax].
+     * the <> conditions on key are returned in NElist and the conditions
+     * on value in valueCond.
+     * @return false if no key can satisfy the conditions
+     */
+    static bool keyRange(const std::vector<SelCond>& conds, int& keyMin, int& keyMax,
+                         std::vector<int>& NElist, std::vector<SelCond>& valueCond);
+
+    /**
+     * collect the conditions on the key of a table (the first column of
+     * a typed table) into the range [keyMin, keyMax].
+     * @return false if no key can satisfy the conditions
+     */
+    static bool keyBounds(const std::string& table, const std::vector<SelCond>& conds,
+                          int& keyMin, int& keyMax);
+
+    /**
+     * turn the conditions on value, except <>, into the range of codes
+     * [codeMin, codeMax] of an order-preserving dictionary. 
+     * the <> conditions are left in valueCond.
+     * @return false if no value can satisfy the conditions
+     */
+    static bool codeRange(const Dictionary& dict, std::vector<SelCond>& valueCond,
+                          int& codeMin, int& codeMax);
+
+    /**
+     * print a tuple in the format of the SELECT clause attribute
+     * to a buffer, or to stdout if out is NULL.
+     */
+    static void printTuple(std::string* out, int attr, int key, const char* value, int len);
 };
 
 #endif /* SQLENGINE_H */
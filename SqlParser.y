@@ -4,28 +4,124 @@
 #include <sys/times.h>
 #include <unistd.h>
 #include <climits>
+#include <cstdlib>
 #include <string>
 #include "Bruinbase.h"
 #include "SqlEngine.h" 
 #include "PageFile.h"
+#include "RowCache.h"
+#include "FrozenTable.h"
 
 int  sqllex(void);  
 void sqlerror(const char *str) { fprintf(stderr, "Error: %s\n", str); }
 extern "C" { int  sqlwrap() { return 1; } }
 
-static void runSelect(int attr, const char* table, const std::vector<SelCond>& conds)
+static void runSelect(const char* agg, const char* attrs, const char* table, const std::vector<SelCond>& conds,
+                      int order = 0, int limit = INT_MAX)
 {
   struct tms tmsbuf;
   clock_t btime, etime;
   int     bpagecnt, epagecnt;
+  int     bhits, ehits, bmisses, emisses;
+  int     bblocks, eblocks;
+  int     bdirs[PageFile::MAX_DATA_DIRS];
+  int     dirs = PageFile::getDataDirCount();
+  int     attr;
+
+  if (strcmp(attrs, "*") == 0) attr = 3;
+  else if (strcmp(attrs, "count(*)") == 0) attr = 4;
+  else if (strcasecmp(attrs, "key") == 0) attr = 1;
+  else if (strcasecmp(attrs, "value") == 0) attr = 2;
+  else attr = 5;
+
+  // MIN and MAX are written before the attribute, as in "SELECT MIN key"
+  if (agg != NULL) {
+    if (strcasecmp(agg, "min") == 0) attr = 6;
+    else if (strcasecmp(agg, "max") == 0) attr = 7;
+    else {
+      sqlerror("unknown aggregate function");
+      return;
+    }
+  }
 
   btime = times(&tmsbuf);
   bpagecnt = PageFile::getPageReadCount();
-  SqlEngine::select(attr, table, conds);
+  bhits = RowCache::getHitCount();
+  bmisses = RowCache::getMissCount();
+  bblocks = FrozenTable::getBlockReadCount();
+  for (int i = 0; i < dirs; i++) bdirs[i] = PageFile::getDirReadCount(i);
+  SqlEngine::select(attr, table, conds, attrs, order, limit);
   etime = times(&tmsbuf);
   epagecnt = PageFile::getPageReadCount();
+  ehits = RowCache::getHitCount();
+  emisses = RowCache::getMissCount();
+  eblocks = FrozenTable::getBlockReadCount();
 
   fprintf(stderr, "  -- %.3f seconds to run the select command. Read %d pages\n", ((float)(etime - btime))/sysconf(_SC_CLK_TCK), epagecnt - bpagecnt);
+  if (ehits + emisses > bhits + bmisses) {
+    fprintf(stderr, "  -- row cache: %d hits, %d misses\n", ehits - bhits, emisses - bmisses);
+  }
+  if (eblocks > bblocks) {
+    fprintf(stderr, "  -- frozen blocks read: %d\n", eblocks - bblocks);
+  }
+
+  // with several data directories, the reads are broken down by directory
+  if (dirs > 1) {
+    fprintf(stderr, "  -- pages read per data directory:");
+    for (int i = 0; i < dirs; i++) {
+      fprintf(stderr, " %s %d", PageFile::getDataDir(i).c_str(), PageFile::getDirReadCount(i) - bdirs[i]);
+    }
+    fprintf(stderr, "\n");
+  }
+}
+
+/*
+ * read the clauses behind the WHERE clause of a SELECT:
+ * [ORDER BY key [ASC|DESC]] [LIMIT n]. order is 1 for ascending and -1
+ * for descending key order, 0 without ORDER BY.
+ * the words are lower case, as the lexer returns an ID.
+ */
+static bool parseOrder(const std::vector<char*>& words, int& order, int& limit)
+{
+  unsigned i = 0;
+
+  order = 0;
+  limit = INT_MAX;
+  if (i < words.size() && strcmp(words[i], "order") == 0){
+    if (i + 2 >= words.size() || strcmp(words[i+1], "by") != 0 || strcmp(words[i+2], "key") != 0) return false;
+    order = 1;
+    i += 3;
+    if (i < words.size() && strcmp(words[i], "asc") == 0) i++;
+    else if (i < words.size() && strcmp(words[i], "desc") == 0){
+      order = -1;
+      i++;
+    }
+  }
+  if (i < words.size() && strcmp(words[i], "limit") == 0){
+    // LIMIT takes the first tuples of an order
+    if (order == 0 || i + 1 >= words.size()) return false;
+    char* end;
+    long n = strtol(words[i+1], &end, 10);
+    if (*end != 0 || n < 0) return false;
+    limit = (n > INT_MAX) ? INT_MAX : (int)n;
+    i += 2;
+  }
+  return i == words.size();
+}
+
+static void freeWords(std::vector<char*>* words)
+{
+  for (unsigned i = 0; i < words->size(); i++) free((*words)[i]);
+  delete words;
+}
+
+static void freeConds(std::vector<SelCond>* conds)
+{
+  for (unsigned i = 0; i < conds->size(); i++) {
+    free((*conds)[i].value);
+    free((*conds)[i].name);
+  }
+  delete conds;
 }
 
 %}
@@ -35,6 +131,10 @@ static void runSelect(int attr, const char* table, const std::vector<SelCond>& c
   char* string;
   SelCond* cond;
   std::vector<SelCond>* conds;
+  ColumnDef* column;
+  std::vector<ColumnDef>* columns;
+  std::vector<int>* integers;
+  std::vector<char*>* words;
 }
 
 %token SELECT FROM WHERE LOAD WITH INDEX QUIT COUNT AND OR 
@@ -42,10 +142,15 @@ static void runSelect(int attr, const char* table, const std::vector<SelCond>& c
 %token <string> INTEGER STRING ID
 %token EQUAL NEQUAL LESS LESSEQUAL GREATER GREATEREQUAL 
 
-%type <integer> attributes attribute comparator
-%type <string> table value
+%type <integer> comparator load_options load_option
+%type <string> table value attributes attribute
 %type <cond> condition
-%type <conds> conditions
+%type <conds> conditions assignments
+%type <cond> assignment
+%type <column> column_def
+%type <columns> column_defs
+%type <integers> bounds
+%type <words> order_clause
 %%
 
 commands:
@@ -56,6 +161,11 @@ commands:
 command:
         load_command { fprintf(stdout, "Bruinbase> "); }
 	| select_command { fprintf(stdout, "Bruinbase> "); }
+	| create_command { fprintf(stdout, "Bruinbase> "); }
+	| delete_command { fprintf(stdout, "Bruinbase> "); }
+	| update_command { fprintf(stdout, "Bruinbase> "); }
+	| table_command { fprintf(stdout, "Bruinbase> "); }
+	| partition_command { fprintf(stdout, "Bruinbase> "); }
 	| quit_command
 	| error LF { fprintf(stdout, "Bruinbase> "); }
 	| LF { fprintf(stdout, "Bruinbase> "); }
@@ -67,33 +177,261 @@ quit_command:
 
 load_command:
 	LOAD table FROM STRING LF { 
-	  SqlEngine::load(std::string($2), std::string($4), false); 
+	  SqlEngine::load(std::string($2), std::string($4), 0); 
+	  free($2);
+	  free($4);
+	}
+	| LOAD table FROM STRING WITH load_options LF { 
+	  SqlEngine::load(std::string($2), std::string($4), $6); 
 	  free($2);
 	  free($4);
 	}
-	| LOAD table FROM STRING WITH INDEX LF { 
-	  SqlEngine::load(std::string($2), std::string($4), true); 
+	;
+
+load_options:
+	load_option { $$ = $1; }
+	| load_options COMMA load_option { $$ = $1 | $3; }
+	;
+
+load_option:
+	INDEX { $$ = SqlEngine::LOAD_INDEX; }
+	| ID {
+		if (strcasecmp($1, "pax") == 0) $$ = SqlEngine::LOAD_PAX;
+		else if (strcasecmp($1, "dictionary") == 0) $$ = SqlEngine::LOAD_DICTIONARY;
+		else if (strcasecmp($1, "clustered") == 0) $$ = SqlEngine::LOAD_CLUSTERED;
+		else if (strcasecmp($1, "bloom") == 0) $$ = SqlEngine::LOAD_BLOOM;
+		else if (strcasecmp($1, "memory") == 0) $$ = SqlEngine::LOAD_MEMORY;
+		else { sqlerror("unknown load option"); free($1); YYERROR; }
+		free($1);
+	}
+	;
+
+/*
+ * CREATE, DELETE, UPDATE, VACUUM, ANALYZE, PARTITION and FREEZE are not keywords of the lexer,
+ * so the commands start with an ID that is checked here. the table
+ * name is taken as an ID, too, to keep the commands apart.
+ */
+create_command:
+	ID ID ID column_defs LF {
+	  if (strcasecmp($1, "create") == 0 && strcasecmp($2, "table") == 0) {
+	    SqlEngine::create(std::string($3), *$4);
+	  } else {
+	    sqlerror("syntax error");
+	  }
+	  free($1);
 	  free($2);
+	  free($3);
+	  for (unsigned i = 0; i < $4->size(); i++) {
+	    free((*$4)[i].name);
+	    free((*$4)[i].type);
+	  }
+	  delete $4;
+	}
+	| ID INDEX ID ID ID LF {
+	  if (strcasecmp($1, "create") == 0 && strcasecmp($3, "on") == 0) {
+	    SqlEngine::createIndex(std::string($4), std::string($5));
+	  } else {
+	    sqlerror("syntax error");
+	  }
+	  free($1);
+	  free($3);
 	  free($4);
+	  free($5);
+	}
+	;
+
+column_defs:
+	column_def {
+	  std::vector<ColumnDef>* v = new std::vector<ColumnDef>;
+	  v->push_back(*$1);
+	  $$ = v;
+	  delete $1;
+	}
+	| column_defs COMMA column_def {
+	  $1->push_back(*$3);
+	  $$ = $1;
+	  delete $3;
+	}
+	;
+
+column_def:
+	ID ID {
+	  ColumnDef* c = new ColumnDef;
+	  c->name = $1;
+	  c->type = $2;
+	  c->length = 0;
+	  $$ = c;
+	}
+	| ID ID INTEGER {
+	  ColumnDef* c = new ColumnDef;
+	  c->name = $1;
+	  c->type = $2;
+	  c->length = atoi($3);
+	  free($3);
+	  $$ = c;
+	}
+	;
+
+delete_command:
+	ID FROM table LF {
+	  std::vector<SelCond> conds;
+	  if (strcasecmp($1, "delete") == 0) SqlEngine::remove(std::string($3), conds);
+	  else sqlerror("syntax error");
+	  free($1);
+	  free($3);
+	}
+	| ID FROM table WHERE conditions LF {
+	  if (strcasecmp($1, "delete") == 0) SqlEngine::remove(std::string($3), *$5);
+	  else sqlerror("syntax error");
+	  free($1);
+	  free($3);
+	  freeConds($5);
+	}
+	;
+
+update_command:
+	ID ID ID assignments LF {
+	  std::vector<SelCond> conds;
+	  if (strcasecmp($1, "update") == 0 && strcasecmp($3, "set") == 0) {
+	    SqlEngine::update(std::string($2), *$4, conds);
+	  } else {
+	    sqlerror("syntax error");
+	  }
+	  free($1);
+	  free($2);
+	  free($3);
+	  freeConds($4);
+	}
+	| ID ID ID assignments WHERE conditions LF {
+	  if (strcasecmp($1, "update") == 0 && strcasecmp($3, "set") == 0) {
+	    SqlEngine::update(std::string($2), *$4, *$6);
+	  } else {
+	    sqlerror("syntax error");
+	  }
+	  free($1);
+	  free($2);
+	  free($3);
+	  freeConds($4);
+	  freeConds($6);
+	}
+	;
+
+assignments:
+	assignment {
+	  std::vector<SelCond>* v = new std::vector<SelCond>;
+	  v->push_back(*$1);
+	  $$ = v;
+	  delete $1;
+	}
+	| assignments COMMA assignment {
+	  $1->push_back(*$3);
+	  $$ = $1;
+	  delete $3;
+	}
+	;
+
+assignment:
+	attribute EQUAL value {
+	  SelCond* c = new SelCond;
+	  if (strcasecmp($1, "key") == 0) c->attr = 1;
+	  else if (strcasecmp($1, "value") == 0) c->attr = 2;
+	  else c->attr = 0;
+	  c->comp = SelCond::EQ;
+	  c->value = $3;
+	  c->name = $1;
+	  $$ = c;
+	}
+	;
+
+table_command:
+	ID ID LF {
+	  if (strcasecmp($1, "vacuum") == 0) SqlEngine::vacuum(std::string($2));
+	  else if (strcasecmp($1, "analyze") == 0) SqlEngine::analyze(std::string($2));
+	  else if (strcasecmp($1, "freeze") == 0) SqlEngine::freeze(std::string($2), 0);
+	  else sqlerror("syntax error");
+	  free($1);
+	  free($2);
+	}
+	| ID ID WITH load_options LF {
+	  if (strcasecmp($1, "freeze") == 0) SqlEngine::freeze(std::string($2), $4);
+	  else sqlerror("syntax error");
+	  free($1);
+	  free($2);
+	}
+	;
+
+partition_command:
+	ID ID ID bounds LF {
+	  if (strcasecmp($1, "partition") == 0 && strcasecmp($3, "at") == 0) {
+	    SqlEngine::partition(std::string($2), *$4);
+	  } else {
+	    sqlerror("syntax error");
+	  }
+	  free($1);
+	  free($2);
+	  free($3);
+	  delete $4;
+	}
+	;
+
+bounds:
+	INTEGER {
+	  $$ = new std::vector<int>;
+	  $$->push_back(atoi($1));
+	  free($1);
+	}
+	| bounds COMMA INTEGER {
+	  $1->push_back(atoi($3));
+	  $$ = $1;
+	  free($3);
 	}
 	;
 
 select_command:
-	SELECT attributes FROM table LF {
+	SELECT attributes FROM table order_clause LF {
    	        std::vector<SelCond> conds;
-		runSelect($2, $4, conds);
+		int order, limit;
+		if (parseOrder(*$5, order, limit)) runSelect(NULL, $2, $4, conds, order, limit);
+		else sqlerror("ORDER BY key [ASC|DESC] [LIMIT n] expected");
+		free($2);
 		free($4);
+		freeWords($5);
 	}
-	| SELECT attributes FROM table WHERE conditions LF {
-	        runSelect($2, $4, *$6);
+	| SELECT attributes FROM table WHERE conditions order_clause LF {
+		int order, limit;
+		if (parseOrder(*$7, order, limit)) runSelect(NULL, $2, $4, *$6, order, limit);
+		else sqlerror("ORDER BY key [ASC|DESC] [LIMIT n] expected");
+		free($2);
 	  	free($4);
-	  	for (unsigned i = 0; i < $6->size(); i++) {
-		    free((*$6)[i].value);
-		}
-	  	delete $6;
+	  	freeConds($6);
+		freeWords($7);
+	}
+	| SELECT ID attribute FROM table LF {
+   	        std::vector<SelCond> conds;
+		runSelect($2, $3, $5, conds);
+		free($2);
+		free($3);
+		free($5);
+	}
+	| SELECT ID attribute FROM table WHERE conditions LF {
+	        runSelect($2, $3, $5, *$7);
+		free($2);
+		free($3);
+	  	free($5);
+	  	freeConds($7);
 	}
 	;
 
+/*
+ * ORDER BY and LIMIT are not keywords of the lexer either. the words
+ * behind a SELECT are collected here and read by parseOrder()
+ */
+order_clause:
+	/* empty */ { $$ = new std::vector<char*>; }
+	| order_clause ID { $1->push_back($2); $$ = $1; }
+	| order_clause INTEGER { $1->push_back($2); $$ = $1; }
+	;
+
 conditions:
 	condition {
 	  std::vector<SelCond>* v = new std::vector<SelCond>;
@@ -111,26 +449,24 @@ conditions:
 condition:
 	attribute comparator value { 
 	  SelCond* c = new SelCond;
-	  c->attr = $1;
+	  if (strcasecmp($1, "key") == 0) c->attr = 1;
+	  else if (strcasecmp($1, "value") == 0) c->attr = 2;
+	  else c->attr = 0;
 	  c->comp = static_cast<SelCond::Comparator>($2);
 	  c->value = $3;
+	  c->name = $1;
 	  $$ = c;
         }
 	;
 
 attributes:
 	attribute { $$ = $1; }
-	| STAR  { $$ = 3; }
-	| COUNT { $$ = 4; }
+	| STAR  { $$ = strdup("*"); }
+	| COUNT { $$ = strdup("count(*)"); }
 	;
 
 attribute:
-	ID { 
-		if (strcasecmp($1, "key") == 0) $$=1;
-		else if (strcasecmp($1, "value") == 0) $$=2;
-		else sqlerror("wrong attribute name. neither key or value");
-		free($1);
-	}
+	ID { $$ = $1; }
 
 value:
 	INTEGER  { $$ = $1; }
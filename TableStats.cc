@@ -0,0 +1,159 @@
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include "Bruinbase.h"
+#include "TableStats.h"
+
+using std::string;
+using std::vector;
+
+// the FNV-1a hash of a value, mixed so that its bits are evenly spread
+static unsigned hashValue(const char* value, int len);
+
+TableStats::TableStats()
+{
+  clear();
+}
+
+void TableStats::clear()
+{
+  rows = 0;
+  pages = 0;
+  endPid = 0;
+  endSid = 0;
+  keyMin = keyMax = 0;
+  distinctKeys = 0;
+  distinctValues = 0;
+  avgValueLength = 0;
+  maxValueLength = 0;
+  histogram.clear();
+
+  indexed = false;
+  indexHeight = 0;
+  indexPages = 0;
+  indexLeaves = 0;
+  indexFill = 0;
+
+  keys.clear();
+  sketch.clear();
+  totalLength = 0;
+}
+
+void TableStats::add(int key, const char* value, int len)
+{
+  rows++;
+  keys.push_back(key);
+  totalLength += len;
+  if (len > maxValueLength) maxValueLength = len;
+
+  // keep the SKETCH_SIZE smallest distinct hashes, in order
+  unsigned h = hashValue(value, len);
+  if ((int)sketch.size() == SKETCH_SIZE && h >= sketch.back()) return;
+  vector<unsigned>::iterator it = std::lower_bound(sketch.begin(), sketch.end(), h);
+  if (it != sketch.end() && *it == h) return;
+  sketch.insert(it, h);
+  if ((int)sketch.size() > SKETCH_SIZE) sketch.pop_back();
+}
+
+void TableStats::finish()
+{
+  int n = keys.size();
+
+  std::sort(keys.begin(), keys.end());
+  keyMin = (n > 0) ? keys[0] : 0;
+  keyMax = (n > 0) ? keys[n - 1] : 0;
+  distinctKeys = 0;
+  for (int i = 0; i < n; i++) {
+    if (i == 0 || keys[i] != keys[i - 1]) distinctKeys++;
+  }
+
+  // the buckets of the histogram have the same # keys (with duplicates).
+  // with fewer keys than buckets, the first buckets end at the first key
+  histogram.clear();
+  for (int i = 1; i <= HISTOGRAM_BUCKETS && n > 0; i++) {
+    long long last = (long long)n * i / HISTOGRAM_BUCKETS - 1;
+    histogram.push_back(keys[last > 0 ? last : 0]);
+  }
+
+  // with SKETCH_SIZE hashes, the largest of them tells how densely
+  // the distinct hashes fill the hash space
+  if ((int)sketch.size() < SKETCH_SIZE) {
+    distinctValues = sketch.size();
+  } else {
+    distinctValues = (int)((SKETCH_SIZE - 1) * 4294967296.0 / ((double)sketch.back() + 1));
+  }
+  avgValueLength = (rows > 0) ? totalLength / rows : 0;
+
+  keys.clear();
+  sketch.clear();
+}
+
+RC TableStats::load(const string& filename)
+{
+  std::ifstream in(filename.c_str());
+  string        line;
+
+  if (!in.is_open()) return RC_FILE_OPEN_FAILED;
+
+  clear();
+  while (getline(in, line)) {
+    std::istringstream stat(line);
+    string name;
+
+    if (!(stat >> name)) continue;
+    if (name == "rows") stat >> rows;
+    else if (name == "pages") stat >> pages;
+    else if (name == "end") stat >> endPid >> endSid;
+    else if (name == "keys") stat >> keyMin >> keyMax >> distinctKeys;
+    else if (name == "values") stat >> distinctValues >> avgValueLength >> maxValueLength;
+    else if (name == "histogram") {
+      int bound;
+      while (stat >> bound) histogram.push_back(bound);
+    }
+    else if (name == "index") {
+      indexed = true;
+      stat >> indexHeight >> indexPages >> indexLeaves >> indexFill;
+    }
+    if (stat.fail() && !stat.eof()) return RC_INVALID_FILE_FORMAT;
+  }
+
+  return 0;
+}
+
+RC TableStats::save(const string& filename) const
+{
+  FILE* fp = fopen(filename.c_str(), "w");
+  if (fp == NULL) return RC_FILE_OPEN_FAILED;
+
+  fprintf(fp, "rows %d\n", rows);
+  fprintf(fp, "pages %d\n", pages);
+  fprintf(fp, "end %d %d\n", endPid, endSid);
+  fprintf(fp, "keys %d %d %d\n", keyMin, keyMax, distinctKeys);
+  fprintf(fp, "values %d %.2f %d\n", distinctValues, avgValueLength, maxValueLength);
+  fprintf(fp, "histogram");
+  for (unsigned i = 0; i < histogram.size(); i++) fprintf(fp, " %d", histogram[i]);
+  fprintf(fp, "\n");
+  if (indexed) {
+    fprintf(fp, "index %d %d %d %.3f\n", indexHeight, indexPages, indexLeaves, indexFill);
+  }
+
+  return (fclose(fp) == 0) ? 0 : RC_FILE_WRITE_FAILED;
+}
+
+static unsigned hashValue(const char* value, int len)
+{
+  unsigned h = 2166136261u;
+  for (int i = 0; i < len; i++) {
+    h ^= (unsigned char) value[i];
+    h *= 16777619u;
+  }
+
+  // the sketch compares whole hashes, so every bit has to be random
+  h ^= h >> 16;
+  h *= 0x85ebca6bU;
+  h ^= h >> 13;
+  h *= 0xc2b2ae35U;
+  h ^= h >> 16;
+  return h;
+}
@@ -0,0 +1,91 @@
+#ifndef TABLESTATS_H
+#define TABLESTATS_H
+
+#include <string>
+#include <vector>
+#include "Bruinbase.h"
+#include "PageFile.h"
+
+/**
+ * The statistics of a table and of its index, collected by ANALYZE and
+ * by LOAD. They are stored in the statistics file of the table
+ * (table + ".stats") with one "name values..." line per statistic.
+ *
+ * The statistics describe the table as it was when its end record id was
+ * (endPid, endSid). The commands that change the table keep the row count
+ * and the end record id right, so the row count can be trusted as long
+ * as the end record id matches the table. The other statistics are
+ * estimates that are brought up to date by the next ANALYZE.
+ */
+class TableStats {
+ public:
+
+  // # buckets of the equi-depth histogram of the keys
+  static const int HISTOGRAM_BUCKETS = 16;
+
+  // # hashes kept to estimate the # distinct values (a K minimum values
+  // sketch). up to this many distinct values are counted exactly
+  static const int SKETCH_SIZE = 1024;
+
+  //
+  // the statistics
+  //
+  int    rows;            // # live tuples
+  int    pages;           // # pages of the table
+  PageId endPid;          // the end record id of the table
+  int    endSid;
+  int    keyMin, keyMax;  // the smallest and the largest key
+  int    distinctKeys;    // # distinct keys
+  int    distinctValues;  // estimated # distinct values
+  double avgValueLength;  // the average length of a value
+  int    maxValueLength;  // the length of the longest value
+  std::vector<int> histogram; // the largest key of every bucket
+
+  bool   indexed;         // does the table have an index?
+  int    indexHeight;     // the height of the B+tree
+  int    indexPages;      // # pages of the index file
+  int    indexLeaves;     // # leaf nodes
+  double indexFill;       // # entries / # entries that fit in the leaf nodes
+
+  TableStats();
+
+  /**
+   * start collecting the statistics of a table again.
+   */
+  void clear();
+
+  /**
+   * collect a tuple of the table.
+   * @param key[IN] the key of the tuple
+   * @param value[IN] the first byte of the value
+   * @param len[IN] # bytes of the value
+   */
+  void add(int key, const char* value, int len);
+
+  /**
+   * compute the statistics of the keys and the values from the
+   * collected tuples.
+   */
+  void finish();
+
+  /**
+   * read the statistics from a statistics file.
+   * @param filename[IN] the name of the statistics file
+   * @return error code. 0 if no error
+   */
+  RC load(const std::string& filename);
+
+  /**
+   * write the statistics to a statistics file.
+   * @param filename[IN] the name of the statistics file
+   * @return error code. 0 if no error
+   */
+  RC save(const std::string& filename) const;
+
+ private:
+  std::vector<int> keys;        // the collected keys
+  std::vector<unsigned> sketch; // the smallest distinct hashes of the values
+  double totalLength;           // the total length of the collected values
+};
+
+#endif // TABLESTATS_H
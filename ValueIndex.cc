@@ -0,0 +1,465 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include "Bruinbase.h"
+#include "ValueIndex.h"
+
+using std::string;
+using std::vector;
+
+// # bytes of the header of a node: # entries and the next leaf node
+// (in a leaf node) or the first child (in a nonleaf node)
+static const int HEADER_SIZE = sizeof(int) + sizeof(PageId);
+
+// # bytes of a leaf entry besides the rest of its value: the prefix
+// length, the length of the rest, the pid and the sid (which is smaller
+// than RecordFile::MAX_RECORDS_PER_PAGE, so one byte)
+static const int LEAF_ENTRY_SIZE = 2 + sizeof(PageId) + 1;
+
+// # bytes of a nonleaf entry besides its separator: the length and the pid
+static const int NONLEAF_ENTRY_SIZE = 1 + sizeof(PageId);
+
+// # leading bytes two values share
+static int sharedPrefix(const string& v1, const string& v2)
+{
+  int n = std::min(v1.size(), v2.size());
+  int i = 0;
+  while (i < n && v1[i] == v2[i]) i++;
+  return i;
+}
+
+// the shortest prefix of right that is larger than left (left < right),
+// or right itself if the two are equal
+static string separatorOf(const string& left, const string& right)
+{
+  int shared = sharedPrefix(left, right);
+  if (shared == (int)right.size()) return right;
+  return right.substr(0, shared + 1);
+}
+
+/*
+ * a leaf node, decoded:
+ *   [# entries][next pid][entry 0 ... entry n-1]
+ * where an entry is [prefix length][rest length][rest][pid][sid]
+ */
+struct ValueIndex::Leaf {
+  vector<string>   values;
+  vector<RecordId> rids;
+  PageId           next;
+
+  Leaf() : next(-1) { }
+
+  // # bytes of entry i when entry begin is the first of the node
+  int entryBytes(int i, int begin) const
+  {
+    int shared = (i > begin) ? sharedPrefix(values[i - 1], values[i]) : 0;
+    return LEAF_ENTRY_SIZE + values[i].size() - shared;
+  }
+
+  int bytes() const
+  {
+    int n = HEADER_SIZE;
+    for (unsigned i = 0; i < values.size(); i++) n += entryBytes(i, 0);
+    return n;
+  }
+
+  // the first entry with a value >= value
+  int lowerBound(const string& value) const
+  {
+    return std::lower_bound(values.begin(), values.end(), value) - values.begin();
+  }
+
+  RC read(PageId pid, const PageFile& pf)
+  {
+    char page[PageFile::PAGE_SIZE];
+    int  n;
+
+    if (pf.read(pid, page) < 0) return RC_FILE_READ_FAILED;
+    memcpy(&n, page, sizeof(int));
+    memcpy(&next, page + sizeof(int), sizeof(PageId));
+    values.resize(n);
+    rids.resize(n);
+
+    const unsigned char* p = (const unsigned char*) page + HEADER_SIZE;
+    for (int i = 0; i < n; i++) {
+      int shared = p[0], rest = p[1];
+      values[i].assign(values[i > 0 ? i - 1 : 0], 0, shared);
+      values[i].append((const char*) p + 2, rest);
+      p += 2 + rest;
+      memcpy(&rids[i].pid, p, sizeof(PageId));
+      rids[i].sid = p[sizeof(PageId)];
+      p += sizeof(PageId) + 1;
+    }
+    return 0;
+  }
+
+  RC write(PageId pid, PageFile& pf) const
+  {
+    char page[PageFile::PAGE_SIZE];
+    int  n = values.size();
+
+    memset(page, 0, sizeof(page));
+    memcpy(page, &n, sizeof(int));
+    memcpy(page + sizeof(int), &next, sizeof(PageId));
+
+    unsigned char* p = (unsigned char*) page + HEADER_SIZE;
+    for (int i = 0; i < n; i++) {
+      int shared = (i > 0) ? sharedPrefix(values[i - 1], values[i]) : 0;
+      int rest = values[i].size() - shared;
+      p[0] = shared;
+      p[1] = rest;
+      memcpy(p + 2, values[i].data() + shared, rest);
+      p += 2 + rest;
+      memcpy(p, &rids[i].pid, sizeof(PageId));
+      p[sizeof(PageId)] = rids[i].sid;
+      p += sizeof(PageId) + 1;
+    }
+    return (pf.write(pid, page) < 0) ? RC_FILE_WRITE_FAILED : 0;
+  }
+};
+
+/*
+ * a nonleaf node, decoded:
+ *   [# separators][pid 0][separator 0][pid 1] ... [separator n-1][pid n]
+ * where a separator is [length][bytes]. pid i points to the values in
+ * (separator i-1, separator i]
+ */
+struct ValueIndex::NonLeaf {
+  vector<string> keys;
+  vector<PageId> pids;
+
+  int bytes() const
+  {
+    int n = HEADER_SIZE;
+    for (unsigned i = 0; i < keys.size(); i++) n += NONLEAF_ENTRY_SIZE + keys[i].size();
+    return n;
+  }
+
+  // the child to follow for value: a value equal to a separator goes
+  // to the left of it, where the values equal to it may start
+  int childIndex(const string& value) const
+  {
+    return std::lower_bound(keys.begin(), keys.end(), value) - keys.begin();
+  }
+
+  RC read(PageId pid, const PageFile& pf)
+  {
+    char page[PageFile::PAGE_SIZE];
+    int  n;
+
+    if (pf.read(pid, page) < 0) return RC_FILE_READ_FAILED;
+    memcpy(&n, page, sizeof(int));
+    keys.resize(n);
+    pids.resize(n + 1);
+    memcpy(&pids[0], page + sizeof(int), sizeof(PageId));
+
+    const unsigned char* p = (const unsigned char*) page + HEADER_SIZE;
+    for (int i = 0; i < n; i++) {
+      keys[i].assign((const char*) p + 1, p[0]);
+      p += 1 + p[0];
+      memcpy(&pids[i + 1], p, sizeof(PageId));
+      p += sizeof(PageId);
+    }
+    return 0;
+  }
+
+  RC write(PageId pid, PageFile& pf) const
+  {
+    char page[PageFile::PAGE_SIZE];
+    int  n = keys.size();
+
+    memset(page, 0, sizeof(page));
+    memcpy(page, &n, sizeof(int));
+    memcpy(page + sizeof(int), &pids[0], sizeof(PageId));
+
+    unsigned char* p = (unsigned char*) page + HEADER_SIZE;
+    for (int i = 0; i < n; i++) {
+      p[0] = keys[i].size();
+      memcpy(p + 1, keys[i].data(), keys[i].size());
+      p += 1 + keys[i].size();
+      memcpy(p, &pids[i + 1], sizeof(PageId));
+      p += sizeof(PageId);
+    }
+    return (pf.write(pid, page) < 0) ? RC_FILE_WRITE_FAILED : 0;
+  }
+};
+
+ValueIndex::ValueIndex()
+{
+  rootPid = -1;
+  treeHeight = 0;
+  writable = false;
+  cachedPid = -1;
+  cached = new Leaf;
+}
+
+ValueIndex::~ValueIndex()
+{
+  delete cached;
+}
+
+RC ValueIndex::open(const string& indexname, char mode)
+{
+  char buffer[PageFile::PAGE_SIZE];
+
+  if (pf.open(indexname, mode) < 0) return RC_FILE_OPEN_FAILED;
+  writable = (mode == 'w' || mode == 'W');
+  cachedPid = -1;
+  if (pf.endPid() == 0) {
+    rootPid = -1;
+    treeHeight = 0;
+    return writeHeader();
+  }
+  if (pf.read(0, buffer) < 0) {
+    pf.close();
+    return RC_FILE_READ_FAILED;
+  }
+  memcpy(&treeHeight, buffer, sizeof(int));
+  memcpy(&rootPid, buffer + sizeof(int), sizeof(PageId));
+  return 0;
+}
+
+RC ValueIndex::close()
+{
+  RC rc = writable ? writeHeader() : 0;
+  if (pf.close() < 0) return RC_FILE_CLOSE_FAILED;
+  return rc;
+}
+
+RC ValueIndex::writeHeader()
+{
+  char buffer[PageFile::PAGE_SIZE];
+
+  memset(buffer, 0, sizeof(buffer));
+  memcpy(buffer, &treeHeight, sizeof(int));
+  memcpy(buffer + sizeof(int), &rootPid, sizeof(PageId));
+  return (pf.write(0, buffer) < 0) ? RC_FILE_WRITE_FAILED : 0;
+}
+
+RC ValueIndex::readLeaf(PageId pid, const Leaf*& leaf)
+{
+  RC rc;
+
+  if (pid != cachedPid) {
+    cachedPid = -1;
+    if ((rc = cached->read(pid, pf)) < 0) return rc;
+    cachedPid = pid;
+  }
+  leaf = cached;
+  return 0;
+}
+
+RC ValueIndex::insert(const string& value, const RecordId& rid)
+{
+  RC rc;
+
+  if ((int)value.size() > MAX_VALUE_LENGTH) return RC_INVALID_ATTRIBUTE;
+  cachedPid = -1;
+
+  if (rootPid == -1) {
+    Leaf leaf;
+    leaf.values.push_back(value);
+    leaf.rids.push_back(rid);
+    rootPid = pf.endPid();
+    treeHeight = 1;
+    return leaf.write(rootPid, pf);
+  }
+
+  bool   split;
+  string separator;
+  PageId newPid;
+  if ((rc = insertAt(rootPid, 1, value, rid, split, separator, newPid)) < 0) return rc;
+  if (split) {
+    NonLeaf root;
+    root.keys.push_back(separator);
+    root.pids.push_back(rootPid);
+    root.pids.push_back(newPid);
+    rootPid = pf.endPid();
+    treeHeight++;
+    return root.write(rootPid, pf);
+  }
+  return 0;
+}
+
+RC ValueIndex::insertAt(PageId pid, int level, const string& value, const RecordId& rid,
+                        bool& split, string& separator, PageId& newPid)
+{
+  RC rc;
+
+  split = false;
+  if (level < treeHeight) {
+    NonLeaf node;
+    if ((rc = node.read(pid, pf)) < 0) return rc;
+    int child = node.childIndex(value);
+    if ((rc = insertAt(node.pids[child], level + 1, value, rid, split, separator, newPid)) < 0 || !split) {
+      return rc;
+    }
+
+    // the child split: its new sibling goes right behind it
+    node.keys.insert(node.keys.begin() + child, separator);
+    node.pids.insert(node.pids.begin() + child + 1, newPid);
+    split = (node.bytes() > PageFile::PAGE_SIZE);
+    if (!split) return node.write(pid, pf);
+
+    // the middle separator, by bytes, moves up to the parent
+    int n = node.keys.size();
+    int total = node.bytes() - HEADER_SIZE, left = 0, mid = 0;
+    while (mid < n - 1 && left + NONLEAF_ENTRY_SIZE + (int)node.keys[mid].size() <= total / 2) {
+      left += NONLEAF_ENTRY_SIZE + node.keys[mid].size();
+      mid++;
+    }
+    if (mid == 0) mid = 1;
+
+    NonLeaf sibling;
+    sibling.keys.assign(node.keys.begin() + mid + 1, node.keys.end());
+    sibling.pids.assign(node.pids.begin() + mid + 1, node.pids.end());
+    separator = node.keys[mid];
+    node.keys.resize(mid);
+    node.pids.resize(mid + 1);
+    newPid = pf.endPid();
+    if ((rc = sibling.write(newPid, pf)) < 0) return rc;
+    return node.write(pid, pf);
+  }
+
+  Leaf leaf;
+  if ((rc = leaf.read(pid, pf)) < 0) return rc;
+  int eid = leaf.lowerBound(value);
+  leaf.values.insert(leaf.values.begin() + eid, value);
+  leaf.rids.insert(leaf.rids.begin() + eid, rid);
+  split = (leaf.bytes() > PageFile::PAGE_SIZE);
+  if (!split) return leaf.write(pid, pf);
+
+  // split where the two halves are closest in bytes. the first entry of
+  // the right half is stored in full there
+  int n = leaf.values.size();
+  vector<int> sizes(n);
+  int total = 0;
+  for (int i = 0; i < n; i++) total += (sizes[i] = leaf.entryBytes(i, 0));
+  int best = 1, bestBytes = -1, before = 0;
+  for (int s = 1; s < n; s++) {
+    before += sizes[s - 1];
+    int leftBytes = HEADER_SIZE + before;
+    int rightBytes = HEADER_SIZE + total - before - sizes[s] + leaf.entryBytes(s, s);
+    int larger = std::max(leftBytes, rightBytes);
+    if (bestBytes < 0 || larger < bestBytes) {
+      best = s;
+      bestBytes = larger;
+    }
+  }
+
+  Leaf sibling;
+  sibling.values.assign(leaf.values.begin() + best, leaf.values.end());
+  sibling.rids.assign(leaf.rids.begin() + best, leaf.rids.end());
+  sibling.next = leaf.next;
+  separator = separatorOf(leaf.values[best - 1], leaf.values[best]);
+  leaf.values.resize(best);
+  leaf.rids.resize(best);
+  newPid = pf.endPid();
+  leaf.next = newPid;
+  if ((rc = sibling.write(newPid, pf)) < 0) return rc;
+  return leaf.write(pid, pf);
+}
+
+RC ValueIndex::locate(const string& searchValue, IndexCursor& cursor)
+{
+  PageId pid = rootPid;
+  RC     rc;
+
+  cursor.pid = -1;
+  cursor.eid = 0;
+  if (rootPid == -1) return RC_NO_SUCH_RECORD;
+  for (int level = 1; level < treeHeight; level++) {
+    NonLeaf node;
+    if ((rc = node.read(pid, pf)) < 0) return rc;
+    pid = node.pids[node.childIndex(searchValue)];
+  }
+
+  // the values >= searchValue may start in the next leaf node
+  const Leaf* leaf;
+  if ((rc = readLeaf(pid, leaf)) < 0) return rc;
+  while ((cursor.eid = leaf->lowerBound(searchValue)) == (int)leaf->values.size()) {
+    if ((pid = leaf->next) == -1) return RC_NO_SUCH_RECORD;
+    if ((rc = readLeaf(pid, leaf)) < 0) return rc;
+  }
+  cursor.pid = pid;
+  return (leaf->values[cursor.eid] == searchValue) ? 0 : RC_NO_SUCH_RECORD;
+}
+
+RC ValueIndex::readForward(IndexCursor& cursor, string& value, RecordId& rid)
+{
+  const Leaf* leaf;
+  RC          rc;
+
+  if (cursor.pid == -1) return RC_END_OF_TREE;
+  if ((rc = readLeaf(cursor.pid, leaf)) < 0) return rc;
+
+  // a leaf node may run out of entries after remove()
+  while (cursor.eid >= (int)leaf->values.size()) {
+    cursor.pid = leaf->next;
+    cursor.eid = 0;
+    if (cursor.pid == -1) return RC_END_OF_TREE;
+    if ((rc = readLeaf(cursor.pid, leaf)) < 0) return rc;
+  }
+  value = leaf->values[cursor.eid];
+  rid = leaf->rids[cursor.eid];
+  cursor.eid++;
+  return 0;
+}
+
+RC ValueIndex::remove(const string& value, const RecordId& rid)
+{
+  IndexCursor cursor;
+  RC          rc;
+
+  if (locate(value, cursor) < 0) return RC_NO_SUCH_RECORD;
+  cachedPid = -1;
+
+  // the entries with the value are looked at in order, across leaf nodes
+  while (cursor.pid != -1) {
+    Leaf leaf;
+    if ((rc = leaf.read(cursor.pid, pf)) < 0) return rc;
+    for (; cursor.eid < (int)leaf.values.size(); cursor.eid++) {
+      if (leaf.values[cursor.eid] != value) return RC_NO_SUCH_RECORD;
+      if (leaf.rids[cursor.eid] == rid) {
+        leaf.values.erase(leaf.values.begin() + cursor.eid);
+        leaf.rids.erase(leaf.rids.begin() + cursor.eid);
+        return leaf.write(cursor.pid, pf);
+      }
+    }
+    cursor.pid = leaf.next;
+    cursor.eid = 0;
+  }
+  return RC_NO_SUCH_RECORD;
+}
+
+RC ValueIndex::remapRids(const RecordIdMap& moved)
+{
+  PageId pid = rootPid;
+  RC     rc;
+
+  if (moved.empty() || rootPid == -1) return 0;
+  cachedPid = -1;
+
+  // walk the leaf nodes from the leftmost one. a RecordId takes the
+  // same # bytes wherever it points, so a leaf node keeps its size
+  for (int level = 1; level < treeHeight; level++) {
+    NonLeaf node;
+    if ((rc = node.read(pid, pf)) < 0) return rc;
+    pid = node.pids[0];
+  }
+  while (pid != -1) {
+    Leaf leaf;
+    bool changed = false;
+    if ((rc = leaf.read(pid, pf)) < 0) return rc;
+    for (unsigned i = 0; i < leaf.rids.size(); i++) {
+      RecordIdMap::const_iterator it = std::lower_bound(moved.begin(), moved.end(), leaf.rids[i], lessOldRid);
+      if (it != moved.end() && it->first == leaf.rids[i]) {
+        leaf.rids[i] = it->second;
+        changed = true;
+      }
+    }
+    if (changed && (rc = leaf.write(pid, pf)) < 0) return rc;
+    pid = leaf.next;
+  }
+  return 0;
+}
@@ -0,0 +1,132 @@
+#ifndef VALUEINDEX_H
+#define VALUEINDEX_H
+
+#include <string>
+#include <vector>
+#include "Bruinbase.h"
+#include "PageFile.h"
+#include "RecordFile.h"
+#include "BTreeIndex.h"
+
+/**
+ * A secondary B+tree index on the value column of a table, built by
+ * CREATE INDEX. The keys are the values, ordered like strcmp(), and an
+ * entry points to its tuple by the RecordId.
+ *
+ * The nodes are compressed to keep the fan-out high:
+ *
+ *   - a leaf node stores a value as the length of the prefix it shares
+ *     with the value before it, and the rest of it
+ *   - a separator of a nonleaf node is the shortest prefix of the first
+ *     value of the right node that is larger than the last value of the
+ *     left node (suffix truncation), so it is often a few bytes long
+ *
+ * Nodes split by bytes, not by # entries. A value equal to a separator
+ * goes to the left of it, and a run of equal values may span leaf nodes,
+ * so locate() moves on to the next leaf node when a node has no value
+ * large enough. Like BTreeIndex, nodes are not merged: remove() may
+ * leave a leaf node empty, and readForward() skips empty leaf nodes.
+ *
+ * The index file is table + ".vidx". Page 0 holds the height of the
+ * tree and its root.
+ */
+class ValueIndex {
+ public:
+
+  // # bytes of the longest value in the index
+  static const int MAX_VALUE_LENGTH = 255;
+
+  ValueIndex();
+  ~ValueIndex();
+
+  /**
+   * Open the index file in read or write mode.
+   * Under 'w' mode, the index file is created if it does not exist.
+   * @param indexname[IN] the name of the index file
+   * @param mode[IN] 'r' for read, 'w' for write
+   * @return error code. 0 if no error
+   */
+  RC open(const std::string& indexname, char mode);
+
+  /**
+   * Close the index file.
+   * @return error code. 0 if no error
+   */
+  RC close();
+
+  /**
+   * Insert the (value, rid) pair to the index.
+   * @param value[IN] the value of the tuple (at most MAX_VALUE_LENGTH bytes)
+   * @param rid[IN] the RecordId of the tuple
+   * @return error code. 0 if no error
+   */
+  RC insert(const std::string& value, const RecordId& rid);
+
+  /**
+   * Remove the (value, rid) pair from the index.
+   * @return error code. RC_NO_SUCH_RECORD if the pair is not in the index
+   */
+  RC remove(const std::string& value, const RecordId& rid);
+
+  /**
+   * Set cursor to the first entry whose value is not smaller than
+   * searchValue.
+   * @param searchValue[IN] the value to look for
+   * @param cursor[OUT] the first entry with a value >= searchValue.
+   *                    cursor.pid is -1 if every value is smaller
+   * @return 0 if the entry has searchValue. RC_NO_SUCH_RECORD otherwise
+   */
+  RC locate(const std::string& searchValue, IndexCursor& cursor);
+
+  /**
+   * Read the entry at cursor and move cursor to the next entry.
+   * @param cursor[IN/OUT] the cursor
+   * @param value[OUT] the value of the entry
+   * @param rid[OUT] the RecordId of the entry
+   * @return error code. RC_END_OF_TREE after the last entry
+   */
+  RC readForward(IndexCursor& cursor, std::string& value, RecordId& rid);
+
+  /**
+   * Replace the RecordIds of the records moved by RecordFile::vacuum().
+   * @param moved[IN] the old and new RecordIds, sorted by the old RecordId
+   * @return error code. 0 if no error
+   */
+  RC remapRids(const RecordIdMap& moved);
+
+  /**
+   * @return the height of the tree. 0 if it is empty
+   */
+  int getHeight() const { return treeHeight; }
+
+ private:
+  struct Leaf;
+  struct NonLeaf;
+
+  PageFile pf;          // the index file
+  PageId   rootPid;     // the root node. -1 if the tree is empty
+  int      treeHeight;  // the height of the tree
+  bool     writable;    // opened in 'w' mode?
+
+  // the leaf node last read by readForward(), which reads the entries
+  // of a leaf node one by one. any write drops it
+  PageId   cachedPid;
+  Leaf*    cached;
+
+  // insert the pair into the subtree of node pid at level. if the node
+  // splits, the new node newPid goes behind separator in the parent
+  RC insertAt(PageId pid, int level, const std::string& value, const RecordId& rid,
+              bool& split, std::string& separator, PageId& newPid);
+
+  // read the leaf node pid through the cache
+  RC readLeaf(PageId pid, const Leaf*& leaf);
+
+  // write page 0
+  RC writeHeader();
+
+  // not copied: the cache is owned
+  ValueIndex(const ValueIndex&);
+  ValueIndex& operator=(const ValueIndex&);
+};
+
+#endif // VALUEINDEX_H
@@ -1,10 +1,51 @@
 #!/bin/sh
 
-rm -f xsmall.tbl xsmall.idx
-rm -f small.tbl small.idx
-rm -f medium.tbl medium.idx
-rm -f large.tbl large.idx
-rm -f xlarge.tbl xlarge.idx
+clean()
+{
+  rm -f xsmall.tbl xsmall.idx xsmall.stats
+  rm -f small.tbl small.idx small.stats
+  rm -f medium.tbl medium.idx medium.stats
+  rm -f large.tbl large.idx large.stats
+  rm -f xlarge.tbl xlarge.idx xlarge.stats
+  rm -f largepax.tbl largepax.stats
+  rm -f largedict.tbl largedict.tbl.dict largedict.stats
+  rm -f largedel.tbl largedel.idx largedel.stats
+  rm -f xlargeclu.tbl xlargeclu.tbl.clustered xlargeclu.stats
+  rm -f xlargebloom.tbl xlargebloom.tbl.bloom xlargebloom.stats
+  rm -f xlargepart.parts xlargepart.p*.tbl xlargepart.p*.idx xlargepart.p*.stats
+  rm -f largemem.mem largemem.stats
+  rm -f xlargefrz.frz xlargefrz.stats
+  rm -f largeval.tbl largeval.vidx largeval.stats
+  rm -f xlargedup.tbl xlargedup.idx xlargedup.stats
+  rm -f largetyp.cat largetyp.tbl largetyp.idx largetyp.stats
+  rm -f largeasc.tbl largeasc.idx largeasc.stats
+}
 
-./bruinbase < test.sql
+# large.del in key order, for appends to the rightmost leaf node
+sort -n large.del > largeasc.del
 
+clean
+dirs=`mktemp -d`
+./bruinbase < test.sql | tee $dirs/test.out
+
+# the same run with the page files striped across two data directories
+# prints the same
+clean
+mkdir $dirs/0 $dirs/1
+BRUINBASE_DATA_DIRS=$dirs/0:$dirs/1 ./bruinbase < test.sql > $dirs/striped.out 2> /dev/null
+if cmp -s $dirs/test.out $dirs/striped.out; then
+  echo "striped run: same output"
+else
+  echo "striped run: different output"
+  diff $dirs/test.out $dirs/striped.out
+fi
+
+# the B+tree checks of btreebench, with few lookups. keys appended in
+# ascending order leave the leaf nodes about APPEND_SPLIT percent full
+if make -s btreebench && ./btreebench 64 1000 20000 > $dirs/bench.out; then
+  grep ascending $dirs/bench.out
+else
+  echo "btreebench: failed"
+  cat $dirs/bench.out
+fi
+rm -rf $dirs largeasc.del
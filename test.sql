@@ -20,3 +20,103 @@ SELECT COUNT(*) FROM xlarge
 SELECT * FROM xlarge WHERE key = 4240
 SELECT * FROM xlarge WHERE key > 400 AND key < 500 AND key > 100 AND key < 4000000
 
+
+LOAD largepax FROM 'large.del' WITH PAX
+SELECT COUNT(*) FROM largepax
+SELECT * FROM largepax WHERE key > 4500 AND key < 4600
+
+LOAD largedict FROM 'large.del' WITH DICTIONARY
+SELECT * FROM largedict WHERE value = 'Waterworld'
+SELECT COUNT(*) FROM largedict WHERE value >= 'W'
+
+LOAD largedel FROM 'large.del' WITH INDEX
+DELETE FROM largedel WHERE key < 2000
+UPDATE largedel SET value = 'Updated' WHERE key = 2244
+VACUUM largedel
+SELECT COUNT(*) FROM largedel
+SELECT * FROM largedel WHERE key > 2200 AND key < 2250
+
+LOAD xlargeclu FROM 'xlarge.del' WITH CLUSTERED
+SELECT COUNT(*) FROM xlargeclu WHERE key > 100 AND key < 5000
+SELECT * FROM xlargeclu WHERE key > 400 AND key < 500
+
+SELECT MIN key FROM xlarge
+SELECT MAX value FROM large WHERE key < 3000
+
+LOAD xlargebloom FROM 'xlarge.del' WITH BLOOM
+SELECT * FROM xlargebloom WHERE value = 'Waterworld'
+SELECT COUNT(*) FROM xlargebloom WHERE value = 'No Such Movie'
+
+ANALYZE largedel
+SELECT COUNT(*) FROM largedel
+
+SELECT * FROM largedel WHERE key = 2244
+UPDATE largedel SET value = 'Updated Again' WHERE key = 2244
+SELECT * FROM largedel WHERE key = 2244
+
+PARTITION xlargepart AT 1000, 2500, 4000
+LOAD xlargepart FROM 'xlarge.del' WITH INDEX
+SELECT COUNT(*) FROM xlargepart WHERE key > 2000 AND key < 3000
+UPDATE xlargepart SET key = 10 WHERE key = 4240
+SELECT * FROM xlargepart WHERE key < 20
+
+LOAD largemem FROM 'large.del' WITH MEMORY
+SELECT COUNT(*) FROM largemem WHERE key > 1000 AND key < 3000
+UPDATE largemem SET value = 'In Memory' WHERE key = 2244
+DELETE FROM largemem WHERE key > 4000
+SELECT * FROM largemem WHERE key > 2200 AND key < 2250
+SELECT COUNT(*) FROM largemem
+
+LOAD xlargefrz FROM 'xlarge.del' WITH INDEX
+FREEZE xlargefrz WITH BLOOM
+SELECT COUNT(*) FROM xlargefrz
+SELECT COUNT(*) FROM xlargefrz WHERE key > 2000 AND key < 3000
+SELECT * FROM xlargefrz WHERE key = 2244
+SELECT * FROM xlargefrz WHERE value = 'Waterworld'
+DELETE FROM xlargefrz WHERE key = 2244
+
+LOAD largeval FROM 'large.del'
+CREATE INDEX ON largeval value
+SELECT * FROM largeval WHERE value = 'Matter of Life and Death, A'
+SELECT COUNT(*) FROM largeval WHERE value > 'M' AND value < 'N'
+UPDATE largeval SET value = 'Renamed' WHERE value = 'King Creole'
+SELECT * FROM largeval WHERE value = 'Renamed'
+DELETE FROM largeval WHERE value < 'B'
+SELECT COUNT(*) FROM largeval WHERE value < 'C'
+SELECT COUNT(*) FROM largeval WHERE value >= 'C'
+CREATE INDEX ON largeval key
+
+LOAD xlargedup FROM 'xlarge.del' WITH INDEX
+UPDATE xlargedup SET key = 2000 WHERE key > 1000 AND key < 3000
+SELECT COUNT(*) FROM xlargedup WHERE key = 2000
+SELECT COUNT(*) FROM xlargedup WHERE key >= 2000 AND key < 3100
+DELETE FROM xlargedup WHERE key = 2000 AND value > 'M'
+SELECT COUNT(*) FROM xlargedup WHERE key = 2000
+SELECT COUNT(*) FROM xlargedup WHERE value > 'M'
+
+SELECT * FROM xlarge ORDER BY key DESC LIMIT 3
+SELECT * FROM xlargedup WHERE key <= 2000 ORDER BY key DESC LIMIT 3
+SELECT * FROM xlargepart WHERE key < 3000 ORDER BY key DESC LIMIT 3
+SELECT key FROM largemem ORDER BY key LIMIT 3
+
+LOAD xlargedup FROM 'large.del' WITH INDEX
+SELECT COUNT(*) FROM xlargedup WHERE key >= 2000 AND key < 3100
+SELECT COUNT(*) FROM xlargedup WHERE key = 2000
+
+CREATE TABLE largetyp id int, title varchar, rating double
+LOAD largetyp FROM 'large.del' WITH INDEX
+SELECT * FROM largetyp WHERE id > 4700
+SELECT title FROM largetyp WHERE id > 4500 AND title < 'C'
+UPDATE largetyp SET rating = '4.5' WHERE id > 4700
+SELECT * FROM largetyp WHERE rating > 4
+SELECT COUNT(*) FROM largetyp WHERE rating < 1
+LOAD largeasc FROM 'largeasc.del' WITH INDEX
+DELETE FROM largeasc WHERE key < 4000
+SELECT COUNT(*) FROM largeasc WHERE key < 4000
+SELECT COUNT(*) FROM largeasc WHERE key >= 4000
+SELECT * FROM largeasc WHERE key > 3990 ORDER BY key LIMIT 3
+SELECT * FROM largeasc WHERE key < 4010 ORDER BY key DESC LIMIT 3
+LOAD largeasc FROM 'largeasc.del' WITH INDEX
+SELECT COUNT(*) FROM largeasc WHERE key < 4000
+SELECT COUNT(*) FROM largeasc WHERE key >= 4000
+SELECT * FROM largeasc WHERE key > 3990 AND key < 4010